@@ -0,0 +1,218 @@
+/**
+ * IK of many target poses at once on a pool of worker threads.
+ *
+ * Each worker owns a RobotModel (and thus its own kinematics plugin instance, which is not
+ * thread-safe) and a RobotState. The poses of a batch are claimed one by one from a shared
+ * cursor, as the octree workers of reachable_ws_ik claim their seeds.
+ * With an analytic solver (workspace/analytic_ik.hpp) the plugin is not used at all: the
+ * closed form gives every solution or proves there is none, without a timeout.
+ */
+#ifndef KINEMATICS_DEMO_BATCH_IK_HPP
+#define KINEMATICS_DEMO_BATCH_IK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <moveit/robot_state/robot_state.h>
+#include "kinematics_demo/ik_cache.hpp"
+#include "workspace/analytic_ik.hpp"
+
+namespace kinematics
+{
+    class BatchIK
+    {
+    public:
+        /**
+         * One worker per model. `analytic` replaces the kinematics plugin when it is initialized
+         * (getKind() != NONE); it must solve for the tip link of the plugin (see verifyAnalyticIK).
+         */
+        BatchIK(
+            const std::vector<robot_model::RobotModelPtr> &models,
+            const std::string &planning_group,
+            const workspace::AnalyticIK &analytic,
+            std::size_t cache_size)
+            : analytic_(analytic), cache_(cache_size), next_(0), num_hits_(0), stop_(false), generation_(0), num_idle_(0)
+        {
+            for (const robot_model::RobotModelPtr &model : models)
+            {
+                workers_.emplace_back(new Worker(model, planning_group));
+            }
+            const robot_model::JointModelGroup *jmg = workers_.front()->jmg;
+            variable_names_ = jmg->getVariableNames();
+            workers_.front()->state.copyJointGroupPositions(jmg, default_seed_);
+            for (std::size_t w = 0; w < workers_.size(); w++)
+            {
+                threads_.emplace_back(&BatchIK::work, this, w);
+            }
+        }
+
+        ~BatchIK()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (std::thread &thread : threads_) { thread.join(); }
+        }
+
+        const std::vector<std::string> &getVariableNames() const { return variable_names_; }
+        std::size_t getNumThreads() const { return workers_.size(); }
+        bool isAnalytic() const { return analytic_.getKind() != workspace::AnalyticIK::NONE; }
+        IKCache &getCache() { return cache_; }
+
+        /**
+         * Solve every target (model frame) from `seed` (empty: the default positions).
+         * `solutions` is row-major, one row of getVariableNames().size() values per target;
+         * the rows of the failed targets are the seed. `success` is a uint8 mask, as ROS bool[].
+         * `timeout` (s) bounds each plugin call. Returns the number of cache hits.
+         */
+        std::size_t solve(
+            const std::vector<Eigen::Isometry3d> &targets,
+            const std::vector<double> &seed,
+            double timeout,
+            std::vector<double> &solutions,
+            std::vector<uint8_t> &success)
+        {
+            std::lock_guard<std::mutex> call_lock(call_mutex_);
+            const std::vector<double> &batch_seed = seed.empty() ? default_seed_ : seed;
+            solutions.resize(targets.size() * variable_names_.size());
+            success.resize(targets.size());
+            batch_ = Batch{&targets, &batch_seed, timeout, solutions.data(), success.data()};
+            next_ = 0;
+            num_hits_ = 0;
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            num_idle_ = 0;
+            generation_++;
+            wake_.notify_all();
+            done_.wait(lock, [this]() { return num_idle_ == workers_.size(); });
+            return num_hits_;
+        }
+
+    private:
+        struct Worker
+        {
+            Worker(const robot_model::RobotModelPtr &model, const std::string &planning_group)
+                : model(model), state(model), jmg(model->getJointModelGroup(planning_group))
+            {
+                state.setToDefaultValues();
+            }
+
+            robot_model::RobotModelPtr model;
+            robot_state::RobotState state;
+            const robot_model::JointModelGroup *jmg;
+            std::vector<double> solution;
+            workspace::AnalyticIK::Solutions analytic_solutions;
+        };
+
+        struct Batch
+        {
+            const std::vector<Eigen::Isometry3d> *targets;
+            const std::vector<double> *seed;
+            double timeout;
+            double *solutions;
+            uint8_t *success;
+        };
+
+        void work(std::size_t w)
+        {
+            Worker &worker = *workers_[w];
+            std::size_t generation = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+                    if (stop_) { return; }
+                    generation = generation_;
+                }
+                const std::size_t n = batch_.targets->size();
+                for (std::size_t i = next_++; i < n; i = next_++)
+                {
+                    batch_.success[i] = solveOne(worker, (*batch_.targets)[i]);
+                    std::copy(worker.solution.begin(), worker.solution.end(),
+                              batch_.solutions + i * variable_names_.size());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (++num_idle_ == workers_.size()) { done_.notify_one(); }
+                }
+            }
+        }
+
+        // Leaves the solution, or the seed on failure, in worker.solution
+        bool solveOne(Worker &worker, const Eigen::Isometry3d &target)
+        {
+            const std::vector<double> &seed = *batch_.seed;
+            // The closed form does not depend on the timeout
+            const double timeout = isAnalytic() ? 0.0 : batch_.timeout;
+            bool found;
+            if (cache_.lookup(target, seed, timeout, found, worker.solution))
+            {
+                num_hits_++;
+                if (!found) { worker.solution = seed; }
+                return found;
+            }
+
+            if (isAnalytic())
+            {
+                // The closest branch to the seed
+                const std::size_t num_solutions = analytic_.solve(target, worker.analytic_solutions);
+                found = num_solutions > 0;
+                worker.solution = seed;
+                double best = std::numeric_limits<double>::infinity();
+                for (std::size_t s = 0; s < num_solutions; s++)
+                {
+                    const workspace::AnalyticIK::Solution &q = worker.analytic_solutions[s];
+                    double distance = 0.0;
+                    for (std::size_t j = 0; j < seed.size(); j++) { distance = std::max(distance, std::abs(q[j] - seed[j])); }
+                    if (distance < best)
+                    {
+                        best = distance;
+                        worker.solution.assign(q.begin(), q.begin() + seed.size());
+                    }
+                }
+            }
+            else
+            {
+                worker.state.setJointGroupPositions(worker.jmg, seed);
+                found = worker.state.setFromIK(worker.jmg, target, 1, batch_.timeout);
+                if (found) { worker.state.copyJointGroupPositions(worker.jmg, worker.solution); }
+                else { worker.solution = seed; }
+            }
+            cache_.store(target, seed, timeout, found, worker.solution);
+            return found;
+        }
+
+        const workspace::AnalyticIK analytic_;
+        IKCache cache_;
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::vector<std::thread> threads_;
+        std::vector<std::string> variable_names_;
+        std::vector<double> default_seed_;
+
+        // The batch in flight, read by the workers between wake_ and done_
+        std::mutex call_mutex_;
+        Batch batch_;
+        std::atomic<std::size_t> next_;
+        std::atomic<std::size_t> num_hits_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        bool stop_;
+        std::size_t generation_;
+        std::size_t num_idle_;
+    };
+}
+
+#endif // KINEMATICS_DEMO_BATCH_IK_HPP
@@ -0,0 +1,321 @@
+/**
+ * Fixed-size damped least squares (damped pseudo-inverse) for an N-joint arm.
+ *
+ * http://www.cs.cmu.edu/~15464-s13/lectures/lecture6/iksurvey.pdf
+ * Every matrix has a compile-time size, so solving never touches the heap.
+ */
+#ifndef KINEMATICS_DEMO_DLS_HPP
+#define KINEMATICS_DEMO_DLS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <eigen3/Eigen/Dense>
+
+namespace kinematics
+{
+    /**
+     * How the damping follows the arm configuration, s being the smallest singular value of J
+     * and w = sqrt(det(J J^T)) the manipulability:
+     *  CONSTANT:       lambda everywhere
+     *  SINGULAR_VALUE: lambda^2 (1 - (s/eps)^2) for s < eps, undamped above
+     *  MANIPULABILITY: lambda^2 (1 - w/w0)^2 for w < w0, undamped above
+     *  FILTERED:       SINGULAR_VALUE applied along the singular direction only, so the
+     *                  well-conditioned directions keep full speed
+     */
+    enum DampingMode
+    {
+        CONSTANT,
+        SINGULAR_VALUE,
+        MANIPULABILITY,
+        FILTERED
+    };
+
+    inline bool toDampingMode(const std::string &name, DampingMode &mode)
+    {
+        if (name == "constant") { mode = CONSTANT; }
+        else if (name == "singular_value") { mode = SINGULAR_VALUE; }
+        else if (name == "manipulability") { mode = MANIPULABILITY; }
+        else if (name == "filtered") { mode = FILTERED; }
+        else { return false; }
+        return true;
+    }
+
+    template <int N>
+    class DampedLeastSquares
+    {
+    public:
+        // Size of the damped system: J J^T (6x6) for N >= 6, J^T J (NxN) for N < 6
+        enum { K = N < 6 ? N : 6 };
+
+        typedef Eigen::Matrix<double, 6, N> Jacobian;
+        typedef Eigen::Matrix<double, N, 6> PseudoInverse;
+        typedef Eigen::Matrix<double, 6, 1> Twist;
+        typedef Eigen::Matrix<double, N, 1> Joints;
+        typedef Eigen::Matrix<double, K, K> System;
+        typedef Eigen::Matrix<double, K, 1> Direction;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        DampedLeastSquares()
+            : mode_(CONSTANT), lambda_max_(0), threshold_(0), lambda_(0), sigma_min_(0), manipulability_(0),
+              has_direction_(false)
+        {
+        }
+
+        /**
+         * Damping of solve(jacb, twist, d_theta): lambda_max for CONSTANT, at most lambda_max otherwise.
+         * `threshold` is eps for SINGULAR_VALUE and FILTERED, w0 for MANIPULABILITY.
+         */
+        void setDamping(DampingMode mode, double lambda_max, double threshold)
+        {
+            mode_ = mode;
+            lambda_max_ = lambda_max;
+            threshold_ = threshold;
+        }
+
+        /**
+         * d_theta = J^T (J J^T + lambda^2 I)^-1 twist   (fat or square J, eq. 11)
+         *         = (J^T J + lambda^2 I)^-1 J^T twist   (tall J, eq. 10)
+         * Solved with an LDLT factorization of the damped system instead of an explicit inverse.
+         */
+        void solve(const Jacobian &jacb, const Twist &twist, double lambda, Joints &d_theta)
+        {
+            lambda_ = lambda;
+            solve(jacb, twist, lambda, d_theta, IsFat());
+        }
+
+        // Same, damped as configured by setDamping
+        void solve(const Jacobian &jacb, const Twist &twist, Joints &d_theta)
+        {
+            gram(jacb, IsFat());
+            system_ = gram_;
+            damp();
+            ldlt_.compute(system_);
+            backSolve(jacb, twist, d_theta, IsFat());
+        }
+
+        // Explicit J+ for callers that need the matrix itself
+        void pseudoInverse(const Jacobian &jacb, double lambda, PseudoInverse &jacb_pseudo_inv)
+        {
+            lambda_ = lambda;
+            pseudoInverse(jacb, lambda, jacb_pseudo_inv, IsFat());
+        }
+
+        // Damping of the last solve
+        double getLambda() const { return lambda_; }
+        // Smallest singular value of the last J (SINGULAR_VALUE and FILTERED)
+        double getMinSingularValue() const { return sigma_min_; }
+        // Manipulability of the last J (MANIPULABILITY)
+        double getManipulability() const { return manipulability_; }
+
+    private:
+        typedef std::integral_constant<bool, (N >= 6)> IsFat;
+
+        // Keeps an exactly singular Gram matrix definite where the damping vanishes
+        static double regularization() { return 1e-12; }
+
+        void solve(const Jacobian &jacb, const Twist &twist, double lambda, Joints &d_theta, std::true_type)
+        {
+            system_.noalias() = jacb * jacb.transpose();
+            factorize(lambda);
+            backSolve(jacb, twist, d_theta, std::true_type());
+        }
+
+        void solve(const Jacobian &jacb, const Twist &twist, double lambda, Joints &d_theta, std::false_type)
+        {
+            system_.noalias() = jacb.transpose() * jacb;
+            factorize(lambda);
+            backSolve(jacb, twist, d_theta, std::false_type());
+        }
+
+        void backSolve(const Jacobian &jacb, const Twist &twist, Joints &d_theta, std::true_type)
+        {
+            rhs_ = twist;
+            ldlt_.solveInPlace(rhs_);
+            d_theta.noalias() = jacb.transpose() * rhs_;
+        }
+
+        void backSolve(const Jacobian &jacb, const Twist &twist, Joints &d_theta, std::false_type)
+        {
+            d_theta.noalias() = jacb.transpose() * twist;
+            ldlt_.solveInPlace(d_theta);
+        }
+
+        void gram(const Jacobian &jacb, std::true_type) { gram_.noalias() = jacb * jacb.transpose(); }
+        void gram(const Jacobian &jacb, std::false_type) { gram_.noalias() = jacb.transpose() * jacb; }
+
+        /**
+         * Smallest eigenpair of the Gram matrix (s^2, u) by inverse iteration, warm-started from the
+         * previous cycle's u. J barely moves between cycles, and near a singularity the iteration
+         * contracts by s_min^2 / s_next^2 per step, so one step tracks the SVD for one K x K
+         * factorization instead of a full decomposition. Rayleigh quotient for s^2.
+         */
+        void estimateMinSingularValue()
+        {
+            estimate_system_ = gram_;
+            estimate_system_.diagonal().array() += regularization();
+            estimate_ldlt_.compute(estimate_system_);
+            if (!has_direction_)
+            {
+                // Cold start: any vector that is not orthogonal to u
+                direction_.setOnes();
+                for (int i = 0; i < 7; i++)
+                {
+                    estimate_ldlt_.solveInPlace(direction_);
+                    direction_.normalize();
+                }
+                has_direction_ = true;
+            }
+            estimate_ldlt_.solveInPlace(direction_);
+            direction_.normalize();
+            sigma_min_ = std::sqrt(std::max(direction_.dot(gram_ * direction_), 0.0));
+        }
+
+        // Adds the damping of mode_ to system_ (= the Gram matrix)
+        void damp()
+        {
+            double lambda_sq = 0.0;
+            switch (mode_)
+            {
+            case CONSTANT:
+                lambda_sq = lambda_max_ * lambda_max_;
+                break;
+            case SINGULAR_VALUE:
+            case FILTERED:
+                estimateMinSingularValue();
+                if (sigma_min_ < threshold_)
+                {
+                    const double ratio = sigma_min_ / threshold_;
+                    lambda_sq = lambda_max_ * lambda_max_ * (1.0 - ratio * ratio);
+                }
+                break;
+            case MANIPULABILITY:
+                manipulability_ = std::sqrt(std::max(gram_.determinant(), 0.0));
+                if (manipulability_ < threshold_)
+                {
+                    const double ratio = 1.0 - manipulability_ / threshold_;
+                    lambda_sq = lambda_max_ * lambda_max_ * ratio * ratio;
+                }
+                break;
+            }
+            lambda_ = std::sqrt(lambda_sq);
+
+            if (mode_ == FILTERED)
+            {
+                // J J^T + lambda^2 u u^T: only the singular direction u is damped
+                system_.noalias() += lambda_sq * direction_ * direction_.transpose();
+                system_.diagonal().array() += regularization();
+            }
+            else
+            {
+                system_.diagonal().array() += lambda_sq + regularization();
+            }
+        }
+
+        void pseudoInverse(const Jacobian &jacb, double lambda, PseudoInverse &jacb_pseudo_inv, std::true_type)
+        {
+            system_.noalias() = jacb * jacb.transpose();
+            factorize(lambda);
+            // J+ = (A^-1 J)^T with A symmetric
+            jacb_copy_ = jacb;
+            ldlt_.solveInPlace(jacb_copy_);
+            jacb_pseudo_inv = jacb_copy_.transpose();
+        }
+
+        void pseudoInverse(const Jacobian &jacb, double lambda, PseudoInverse &jacb_pseudo_inv, std::false_type)
+        {
+            system_.noalias() = jacb.transpose() * jacb;
+            factorize(lambda);
+            jacb_pseudo_inv = jacb.transpose();
+            ldlt_.solveInPlace(jacb_pseudo_inv);
+        }
+
+        void factorize(double lambda)
+        {
+            system_.diagonal().array() += lambda * lambda;
+            ldlt_.compute(system_);
+        }
+
+        DampingMode mode_;
+        double lambda_max_;
+        double threshold_;
+        double lambda_;
+        double sigma_min_;
+        double manipulability_;
+        bool has_direction_;
+
+        System gram_;
+        System system_;
+        Eigen::LDLT<System> ldlt_;
+        System estimate_system_;
+        Eigen::LDLT<System> estimate_ldlt_;
+        Direction direction_;
+        Twist rhs_;
+        Jacobian jacb_copy_;
+    };
+
+    /**
+     * Dynamic-size damped pseudo-inverses of any J, kept as the reference for DampedLeastSquares.
+     * Without SVD: constant damping, eq. 10 or 11 above. With SVD: damping of the singular values below `eps` only.
+     */
+    inline void calculateDampedPseudoInverse_without_SVD(
+        const Eigen::MatrixXd &jacb, Eigen::MatrixXd &jacb_pseudo_inv, double /*eps*/, double lambda)
+    {
+        // http://www.cs.cmu.edu/~15464-s13/lectures/lecture6/iksurvey.pdf
+        Eigen::MatrixXd jacb_transpose = jacb.transpose();
+        if (jacb.rows() >= jacb.cols())  // J is tall. left inverse.
+        {
+            // eq(10)
+            Eigen::MatrixXd lhs = (
+                jacb_transpose * jacb +
+                lambda * lambda * Eigen::MatrixXd::Identity(jacb.cols(), jacb.cols()));
+            jacb_pseudo_inv = lhs.ldlt().solve(jacb_transpose);
+        }
+        else  // J is fat.right inverse.
+        {
+            // eq(11)
+            Eigen::MatrixXd rhs = (
+                jacb * jacb_transpose +
+                lambda * lambda * Eigen::MatrixXd::Identity(jacb.rows(), jacb.rows()));
+            // J^T A^-1 = (A^-1 J)^T, A symmetric
+            jacb_pseudo_inv = rhs.ldlt().solve(jacb).transpose();
+        }
+    }
+
+    /** This method is also called damped least squares method.
+     * Copied from STOMP
+     * http://docs.ros.org/en/kinetic/api/stomp_moveit/html/namespacestomp__moveit_1_1utils_1_1kinematics.html#a1a46c199beea4b6d10f18f9c709ebdef
+     */
+    inline void calculateDampedPseudoInverse_with_SVD(
+        const Eigen::MatrixXd &jacb, Eigen::MatrixXd &jacb_pseudo_inv, double eps, double lambda)
+    {
+        using namespace Eigen;
+        //Calculate A+ (pseudoinverse of A) = V S+ U*, where U* is Hermition of U (just transpose if all values of U are real)
+        //in order to solve Ax=b -> x*=A+ b
+        Eigen::JacobiSVD<MatrixXd> svd(jacb, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        const MatrixXd &U = svd.matrixU();
+        const VectorXd &Sv = svd.singularValues();
+        const MatrixXd &V = svd.matrixV();
+
+        // calculate the reciprocal of Singular-Values
+        // damp inverse with lambda so that inverse doesn't oscillate near solution
+        size_t nSv = Sv.size();
+        VectorXd inv_Sv(nSv);
+        for(size_t i=0; i< nSv; ++i)
+        {
+            if (fabs(Sv(i)) > eps)
+            {
+                inv_Sv(i) = 1/Sv(i);
+            }
+            else
+            {
+                inv_Sv(i) = Sv(i) / (Sv(i)*Sv(i) + lambda*lambda);
+            }
+        }
+        jacb_pseudo_inv = V * inv_Sv.asDiagonal() * U.transpose();
+    }
+}
+
+#endif // KINEMATICS_DEMO_DLS_HPP
@@ -0,0 +1,119 @@
+/**
+ * Memoized IK results of repeated target poses.
+ *
+ * Grasp screening asks for the same candidate poses over and over, so both the solutions and
+ * the failures (the expensive part: a failing numerical IK runs for its whole timeout) are kept.
+ * Poses are compared after rounding to `resolution`, which should stay well below the IK
+ * tolerance: a hit returns the solution of the first pose, not a new solve.
+ * The seed and the timeout are part of the key: the seed picks the IK branch, and a numerical
+ * failure only holds for the timeout it was given.
+ */
+#ifndef KINEMATICS_DEMO_IK_CACHE_HPP
+#define KINEMATICS_DEMO_IK_CACHE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <eigen3/Eigen/Geometry>
+
+namespace kinematics
+{
+    class IKCache
+    {
+    public:
+        /**
+         * At most `max_entries` poses, the cache starts over when full.
+         * `resolution` is in m for the position and unitless for the quaternion.
+         */
+        explicit IKCache(std::size_t max_entries = 1 << 16, double resolution = 1e-6)
+            : max_entries_(max_entries), resolution_(resolution)
+        {
+        }
+
+        /** True if the pose is known for this seed and timeout: then `success`, and on success `solution`, are its result */
+        bool lookup(
+            const Eigen::Isometry3d &pose,
+            const std::vector<double> &seed,
+            double timeout,
+            bool &success,
+            std::vector<double> &solution) const
+        {
+            const Key k = key(pose, seed, timeout);
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = map_.find(k);
+            if (it == map_.end()) { return false; }
+            success = it->second.success;
+            if (success) { solution = it->second.solution; }
+            return true;
+        }
+
+        void store(
+            const Eigen::Isometry3d &pose,
+            const std::vector<double> &seed,
+            double timeout,
+            bool success,
+            const std::vector<double> &solution)
+        {
+            const Key k = key(pose, seed, timeout);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (map_.size() >= max_entries_) { map_.clear(); }
+            Entry &entry = map_[k];
+            entry.success = success;
+            if (success) { entry.solution = solution; }
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            map_.clear();
+        }
+
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return map_.size();
+        }
+
+    private:
+        // Rounded position and quaternion (w >= 0, q and -q are the same rotation), timeout and seed
+        typedef std::vector<int64_t> Key;
+
+        struct KeyHash
+        {
+            std::size_t operator()(const Key &k) const
+            {
+                uint64_t h = 1469598103934665603ULL;  // FNV-1a over the words
+                for (int64_t v : k) { h = (h ^ static_cast<uint64_t>(v)) * 1099511628211ULL; }
+                return static_cast<std::size_t>(h);
+            }
+        };
+
+        struct Entry
+        {
+            bool success;
+            std::vector<double> solution;
+        };
+
+        // The seed is rounded to `resolution` rad, the timeout to 1 us
+        Key key(const Eigen::Isometry3d &pose, const std::vector<double> &seed, double timeout) const
+        {
+            Eigen::Quaterniond q(pose.linear());
+            if (q.w() < 0.0) { q.coeffs() = -q.coeffs(); }
+            const Eigen::Vector3d &p = pose.translation();
+            auto round = [this](double x) { return static_cast<int64_t>(std::llround(x / resolution_)); };
+            Key k{round(p.x()), round(p.y()), round(p.z()), round(q.w()), round(q.x()), round(q.y()), round(q.z()),
+                  static_cast<int64_t>(std::llround(timeout * 1e6))};
+            for (double v : seed) { k.push_back(round(v)); }
+            return k;
+        }
+
+        const std::size_t max_entries_;
+        const double resolution_;
+        mutable std::mutex mutex_;
+        std::unordered_map<Key, Entry, KeyHash> map_;
+    };
+}
+
+#endif // KINEMATICS_DEMO_IK_CACHE_HPP
@@ -0,0 +1,226 @@
+/**
+ * Warm-started sequential IK along a dense Cartesian path.
+ *
+ * Consecutive targets of a path are a few millimetres apart, so the solution of the
+ * previous target is a good seed: a couple of damped Newton steps on the MoveIt Jacobian
+ * converge where a cold solve from a random seed takes a full search. Random restarts
+ * through the kinematics plugin of the group (setFromIK) happen only when Newton fails.
+ * A solution that moves a joint further than jump_threshold from the previous one is
+ * reported as a branch jump (elbow / wrist flip), which a caller should not execute.
+ */
+#ifndef KINEMATICS_DEMO_PATH_IK_HPP
+#define KINEMATICS_DEMO_PATH_IK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <moveit/robot_state/robot_state.h>
+#include "kinematics_demo/se3.hpp"
+
+namespace kinematics
+{
+    struct PathIKOptions
+    {
+        int max_iterations = 8;                // Newton steps per target before the restarts
+        double position_tolerance = 1e-5;      // m
+        double orientation_tolerance = 1e-4;   // rad
+        double lambda = 1e-3;                  // damping of the Newton steps
+        double max_step = 0.2;                 // largest joint change of one Newton step (rad or m)
+        double jump_threshold = 0.5;           // largest joint change between consecutive targets (rad or m)
+        unsigned int restarts = 10;            // setFromIK calls when Newton fails
+        double restart_timeout = 0.005;        // s, per setFromIK call
+        bool position_only = false;            // ignore the orientation of the targets
+    };
+
+    struct PathIKResult
+    {
+        int iterations = 0;           // Newton steps
+        unsigned int restarts = 0;    // setFromIK calls, 0 if the warm start converged
+        double max_joint_step = 0.0;  // largest joint change from the previous solution
+        bool branch_jump = false;     // max_joint_step over jump_threshold
+    };
+
+    class PathIK
+    {
+    public:
+        /**
+         * `state` is used for FK, Jacobians and the restarts, and is left at the last solution.
+         * Its current group positions are the seed of the first target.
+         */
+        PathIK(
+            const robot_state::RobotStatePtr &state,
+            const robot_model::JointModelGroup *joint_model_group,
+            const std::string &eef_link,
+            const PathIKOptions &options = PathIKOptions())
+            : state_(state), jmg_(joint_model_group), eef_link_(state->getLinkModel(eef_link)),
+              options_(options), rows_(options.position_only ? 3 : 6),
+              num_joints_(static_cast<int>(joint_model_group->getVariableCount())),
+              jacobian_(6, num_joints_), error_(6), d_theta_(num_joints_),
+              system_(std::min(rows_, num_joints_), std::min(rows_, num_joints_))
+        {
+            state_->copyJointGroupPositions(jmg_, seed_);
+            joint_values_ = seed_;
+        }
+
+        // Restart the path from `joint_values`
+        void setSeed(const std::vector<double> &joint_values)
+        {
+            seed_ = joint_values;
+        }
+
+        const std::vector<double> &getSeed() const { return seed_; }
+        const PathIKOptions &getOptions() const { return options_; }
+
+        /**
+         * Solve the next target of the path, seeded by the previous solution.
+         * On success `joint_values` is the solution and becomes the seed of the next target.
+         */
+        bool solve(const Eigen::Isometry3d &target, std::vector<double> &joint_values, PathIKResult &result)
+        {
+            result = PathIKResult();
+            joint_values_ = seed_;
+            bool found = refine(target, result.iterations);
+            while (!found && result.restarts < options_.restarts)
+            {
+                // The plugin starts from the state: the seed first, random positions afterwards
+                if (result.restarts == 0) { state_->setJointGroupPositions(jmg_, seed_); }
+                else { state_->setToRandomPositions(jmg_); }
+                result.restarts++;
+                if (state_->setFromIK(jmg_, target, 1, options_.restart_timeout))
+                {
+                    state_->copyJointGroupPositions(jmg_, joint_values_);
+                    // The plugin tolerances are looser than ours
+                    int iterations = 0;
+                    found = refine(target, iterations);
+                    result.iterations += iterations;
+                }
+            }
+            if (!found)
+            {
+                state_->setJointGroupPositions(jmg_, seed_);
+                return false;
+            }
+
+            for (int j = 0; j < num_joints_; j++)
+            {
+                result.max_joint_step = std::max(result.max_joint_step, std::abs(joint_values_[j] - seed_[j]));
+            }
+            result.branch_jump = result.max_joint_step > options_.jump_threshold;
+            seed_ = joint_values_;
+            joint_values = joint_values_;
+            return true;
+        }
+
+        /**
+         * Solve the targets in order. Stops at the first target without a solution and
+         * returns the number of solved targets: path[i] and results[i] belong to targets[i].
+         */
+        std::size_t solvePath(
+            const std::vector<Eigen::Isometry3d> &targets,
+            std::vector<std::vector<double>> &path,
+            std::vector<PathIKResult> &results)
+        {
+            path.resize(targets.size());
+            results.resize(targets.size());
+            std::size_t i = 0;
+            for (; i < targets.size(); i++)
+            {
+                if (!solve(targets[i], path[i], results[i])) { break; }
+            }
+            path.resize(i);
+            results.resize(i);
+            return i;
+        }
+
+    private:
+        /**
+         * Damped Newton steps from joint_values_ until the target is within tolerance.
+         * The error is the twist from the eef to the target in the base orientation, the frame
+         * of the MoveIt Jacobian at the eef origin, as in the singularity servo loop.
+         */
+        bool refine(const Eigen::Isometry3d &target, int &iterations)
+        {
+            Eigen::Isometry3d eef_pose;
+            Eigen::Isometry3d eef_rotation = Eigen::Isometry3d::Identity();
+            SE3::Vector6d twist_error;
+            for (iterations = 0;; iterations++)
+            {
+                state_->setJointGroupPositions(jmg_, joint_values_);
+                state_->updateLinkTransforms();
+                eef_pose.matrix() = state_->getGlobalLinkTransform(eef_link_).matrix();
+                if (options_.position_only)
+                {
+                    twist_error.head<3>() = target.translation() - eef_pose.translation();
+                    twist_error.tail<3>().setZero();
+                }
+                else
+                {
+                    eef_rotation.linear() = eef_pose.linear();
+                    SE3::logAdjoint(SE3::between(target, eef_pose), eef_rotation, twist_error);
+                }
+                if (twist_error.head<3>().norm() < options_.position_tolerance &&
+                    (options_.position_only || twist_error.tail<3>().norm() < options_.orientation_tolerance))
+                {
+                    return true;
+                }
+                if (iterations == options_.max_iterations) { return false; }
+
+                error_ = twist_error;
+                state_->getJacobian(jmg_, eef_link_, Eigen::Vector3d::Zero(), jacobian_);
+                newtonStep();
+                const double step = d_theta_.cwiseAbs().maxCoeff();
+                if (step > options_.max_step) { d_theta_ *= options_.max_step / step; }
+                for (int j = 0; j < num_joints_; j++)
+                {
+                    joint_values_[j] += d_theta_(j);
+                }
+                state_->setJointGroupPositions(jmg_, joint_values_);
+                state_->enforceBounds(jmg_);
+                state_->copyJointGroupPositions(jmg_, joint_values_);
+            }
+        }
+
+        // d_theta = DLS(J, error) on the first rows_ rows, as in kinematics_demo/dls.hpp
+        void newtonStep()
+        {
+            const auto jacb = jacobian_.topRows(rows_);
+            const auto twist = error_.head(rows_);
+            const double lambda_sq = options_.lambda * options_.lambda;
+            if (rows_ <= num_joints_)
+            {
+                // Fat or square J: J^T (J J^T + lambda^2 I)^-1 twist
+                system_.noalias() = jacb * jacb.transpose();
+                system_.diagonal().array() += lambda_sq;
+                ldlt_.compute(system_);
+                d_theta_.noalias() = jacb.transpose() * ldlt_.solve(twist);
+            }
+            else
+            {
+                // Tall J: (J^T J + lambda^2 I)^-1 J^T twist
+                system_.noalias() = jacb.transpose() * jacb;
+                system_.diagonal().array() += lambda_sq;
+                ldlt_.compute(system_);
+                d_theta_ = ldlt_.solve(jacb.transpose() * twist);
+            }
+        }
+
+        robot_state::RobotStatePtr state_;
+        const robot_model::JointModelGroup *jmg_;
+        const robot_model::LinkModel *eef_link_;
+        PathIKOptions options_;
+        const int rows_;
+        const int num_joints_;
+
+        std::vector<double> seed_;
+        std::vector<double> joint_values_;
+        Eigen::MatrixXd jacobian_;
+        Eigen::VectorXd error_;
+        Eigen::VectorXd d_theta_;
+        Eigen::MatrixXd system_;
+        Eigen::LDLT<Eigen::MatrixXd> ldlt_;
+    };
+}
+
+#endif // KINEMATICS_DEMO_PATH_IK_HPP
@@ -0,0 +1,177 @@
+/**
+ * Results of the planner benchmark (planner_benchmark.cpp): one row per planning run,
+ * summarized per (scene, planner) into success rate and percentiles, written to CSV and
+ * compared against the summary of a previous run to flag latency regressions.
+ */
+#ifndef KINEMATICS_DEMO_PLANNER_BENCHMARK_HPP
+#define KINEMATICS_DEMO_PLANNER_BENCHMARK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace planning_benchmark
+{
+    struct RunResult
+    {
+        std::string scene;
+        std::string query;
+        std::string planner;
+        int run;
+        bool success;
+        double time;          // s, failed runs included
+        double joint_length;  // Sum of the joint space steps (rad / m), successful runs only
+        double eef_length;    // Length of the end effector path (m), successful runs only
+    };
+
+    struct Summary
+    {
+        std::string scene;
+        std::string planner;
+        std::size_t runs;
+        double success_rate;
+        double time_p50, time_p90, time_p99;
+        double joint_length_p50, joint_length_p90;
+        double eef_length_p50, eef_length_p90;
+    };
+
+    /** Linear interpolation between closest ranks, p in [0, 1]. 0 for no values */
+    inline double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) { return 0.0; }
+        std::sort(values.begin(), values.end());
+        const double rank = p * (values.size() - 1);
+        const std::size_t lo = static_cast<std::size_t>(std::floor(rank));
+        const std::size_t hi = std::min(lo + 1, values.size() - 1);
+        return values[lo] + (rank - lo) * (values[hi] - values[lo]);
+    }
+
+    /** One summary per (scene, planner), sorted by scene then planner */
+    inline std::vector<Summary> summarize(const std::vector<RunResult> &results)
+    {
+        struct Samples { std::size_t runs = 0, successes = 0; std::vector<double> time, joint_length, eef_length; };
+        std::map<std::pair<std::string, std::string>, Samples> groups;
+        for (const RunResult &r : results)
+        {
+            Samples &s = groups[std::make_pair(r.scene, r.planner)];
+            s.runs++;
+            s.time.push_back(r.time);
+            if (!r.success) { continue; }
+            s.successes++;
+            s.joint_length.push_back(r.joint_length);
+            s.eef_length.push_back(r.eef_length);
+        }
+        std::vector<Summary> summaries;
+        for (const auto &group : groups)
+        {
+            const Samples &s = group.second;
+            summaries.push_back(Summary{
+                group.first.first, group.first.second, s.runs, static_cast<double>(s.successes) / s.runs,
+                percentile(s.time, 0.5), percentile(s.time, 0.9), percentile(s.time, 0.99),
+                percentile(s.joint_length, 0.5), percentile(s.joint_length, 0.9),
+                percentile(s.eef_length, 0.5), percentile(s.eef_length, 0.9)});
+        }
+        return summaries;
+    }
+
+    inline bool writeRuns(const std::string &file, const std::vector<RunResult> &results)
+    {
+        std::ofstream out(file);
+        if (!out) { return false; }
+        out << "scene,query,planner,run,success,time,joint_length,eef_length\n";
+        for (const RunResult &r : results)
+        {
+            out << r.scene << ',' << r.query << ',' << r.planner << ',' << r.run << ',' << r.success << ','
+                << r.time << ',' << r.joint_length << ',' << r.eef_length << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    inline bool writeSummary(const std::string &file, const std::vector<Summary> &summaries)
+    {
+        std::ofstream out(file);
+        if (!out) { return false; }
+        out << "scene,planner,runs,success_rate,time_p50,time_p90,time_p99,"
+               "joint_length_p50,joint_length_p90,eef_length_p50,eef_length_p90\n";
+        for (const Summary &s : summaries)
+        {
+            out << s.scene << ',' << s.planner << ',' << s.runs << ',' << s.success_rate << ','
+                << s.time_p50 << ',' << s.time_p90 << ',' << s.time_p99 << ','
+                << s.joint_length_p50 << ',' << s.joint_length_p90 << ','
+                << s.eef_length_p50 << ',' << s.eef_length_p90 << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+
+    /** Read a file of writeSummary, false if it cannot be opened or a row is malformed */
+    inline bool readSummary(const std::string &file, std::vector<Summary> &summaries)
+    {
+        std::ifstream in(file);
+        if (!in) { return false; }
+        summaries.clear();
+        std::string line;
+        std::getline(in, line);  // header
+        while (std::getline(in, line))
+        {
+            if (line.empty()) { continue; }
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream row(line);
+            Summary s;
+            if (!(row >> s.scene >> s.planner >> s.runs >> s.success_rate >> s.time_p50 >> s.time_p90 >> s.time_p99
+                      >> s.joint_length_p50 >> s.joint_length_p90 >> s.eef_length_p50 >> s.eef_length_p90))
+            {
+                return false;
+            }
+            summaries.push_back(s);
+        }
+        return true;
+    }
+
+    /**
+     * Regressions of `current` against `baseline`, one message each: a median or p90 planning time
+     * more than `time_tolerance` (relative) above the baseline, or a success rate more than
+     * `success_tolerance` (absolute) below it. Entries missing from either side are skipped.
+     */
+    inline std::vector<std::string> compare(
+        const std::vector<Summary> &baseline,
+        const std::vector<Summary> &current,
+        double time_tolerance,
+        double success_tolerance)
+    {
+        std::vector<std::string> regressions;
+        for (const Summary &c : current)
+        {
+            const auto b = std::find_if(baseline.begin(), baseline.end(), [&](const Summary &s)
+            {
+                return s.scene == c.scene && s.planner == c.planner;
+            });
+            if (b == baseline.end()) { continue; }
+            const std::string where = c.scene + " / " + c.planner + ": ";
+            auto checkTime = [&](const char *name, double base, double now)
+            {
+                if (base > 0.0 && now > base * (1.0 + time_tolerance))
+                {
+                    std::ostringstream msg;
+                    msg << where << name << " " << base << " s -> " << now << " s";
+                    regressions.push_back(msg.str());
+                }
+            };
+            checkTime("time_p50", b->time_p50, c.time_p50);
+            checkTime("time_p90", b->time_p90, c.time_p90);
+            if (c.success_rate < b->success_rate - success_tolerance)
+            {
+                std::ostringstream msg;
+                msg << where << "success_rate " << b->success_rate << " -> " << c.success_rate;
+                regressions.push_back(msg.str());
+            }
+        }
+        return regressions;
+    }
+}
+
+#endif // KINEMATICS_DEMO_PLANNER_BENCHMARK_HPP
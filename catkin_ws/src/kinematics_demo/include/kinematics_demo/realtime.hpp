@@ -0,0 +1,168 @@
+/**
+ * Lock-free hand-off between a real-time control thread and ROS threads.
+ */
+#ifndef KINEMATICS_DEMO_REALTIME_HPP
+#define KINEMATICS_DEMO_REALTIME_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace realtime
+{
+    /**
+     * Triple buffer holding the latest value of T: one writer, one reader, neither ever blocks.
+     * The reader keeps seeing the previous value until a newer one is written.
+     */
+    template <typename T>
+    class LatestValue
+    {
+    public:
+        LatestValue() : middle_(1), front_(0), back_(2) {}
+
+        // Writer side
+        void write(const T &value)
+        {
+            buffers_[back_] = value;
+            back_ = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Reader side, returns true if `value` changed since the last read
+        bool read(T &value)
+        {
+            const bool updated = middle_.load(std::memory_order_relaxed) & DIRTY;
+            if (updated)
+            {
+                front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+            }
+            value = buffers_[front_];
+            return updated;
+        }
+
+    private:
+        enum { INDEX = 0x3, DIRTY = 0x4 };
+
+        T buffers_[3];
+        std::atomic<unsigned char> middle_;
+        unsigned char front_;
+        unsigned char back_;
+    };
+
+    /**
+     * Bounded single-producer single-consumer queue. A full queue rejects the push
+     * instead of blocking the producer.
+     */
+    template <typename T, std::size_t Capacity>
+    class SpscRing
+    {
+    public:
+        SpscRing() : head_(0), tail_(0) {}
+
+        bool push(const T &value)
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            const std::size_t next = (head + 1) % Capacity;
+            if (next == tail_.load(std::memory_order_acquire)) { return false; }
+            buffer_[head] = value;
+            head_.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T &value)
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire)) { return false; }
+            value = buffer_[tail];
+            tail_.store((tail + 1) % Capacity, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<T, Capacity> buffer_;
+        std::atomic<std::size_t> head_;
+        std::atomic<std::size_t> tail_;
+    };
+
+    /**
+     * Loop period statistics over a window: mean, standard deviation (Welford), extrema,
+     * worst deviation from the nominal period, and overruns (period > 1.5 nominal).
+     */
+    class PeriodStats
+    {
+    public:
+        explicit PeriodStats(double nominal = 0.0) : nominal_(nominal) { reset(); }
+
+        void reset()
+        {
+            count_ = 0;
+            mean_ = 0;
+            m2_ = 0;
+            min_ = std::numeric_limits<double>::max();
+            max_ = 0;
+            jitter_ = 0;
+            overruns_ = 0;
+        }
+
+        void add(double period)
+        {
+            count_++;
+            const double delta = period - mean_;
+            mean_ += delta / count_;
+            m2_ += delta * (period - mean_);
+            min_ = std::min(min_, period);
+            max_ = std::max(max_, period);
+            jitter_ = std::max(jitter_, std::abs(period - nominal_));
+            if (period > 1.5 * nominal_) { overruns_++; }
+        }
+
+        std::size_t count() const { return count_; }
+        double mean() const { return mean_; }
+        double stddev() const { return count_ > 1 ? std::sqrt(m2_ / (count_ - 1)) : 0.0; }
+        double min() const { return count_ > 0 ? min_ : 0.0; }
+        double max() const { return max_; }
+        double jitter() const { return jitter_; }
+        std::size_t overruns() const { return overruns_; }
+
+    private:
+        double nominal_;
+        std::size_t count_;
+        double mean_;
+        double m2_;
+        double min_;
+        double max_;
+        double jitter_;
+        std::size_t overruns_;
+    };
+
+    // SCHED_FIFO at `priority` for `thread`. Needs CAP_SYS_NICE or an rtprio limit.
+    inline bool setFifoPriority(std::thread &thread, int priority, std::string &error)
+    {
+        sched_param param;
+        param.sched_priority = priority;
+        const int ret = pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+        if (ret != 0) { error = std::strerror(ret); }
+        return ret == 0;
+    }
+
+    // Lock current and future pages, so the control loop never page-faults. Needs a memlock limit.
+    inline bool lockMemory(std::string &error)
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        {
+            error = std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif // KINEMATICS_DEMO_REALTIME_HPP
@@ -6,115 +6,145 @@
 #define KINEMATICS_DEMO_SE3_HPP
 
 #include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
 #include "kinematics_demo/so3.hpp"
 
 // http://ingmec.ual.es/~jlblanco/papers/jlblanco2010geometry3D_techrep.pdf
+// Twists are (v, w): translation first, rotation last. Fixed-size, double precision.
 namespace SE3
 {
-void hat(const Eigen::VectorXd &se3, Eigen::Matrix4d &se3_hat)
-{
-    // Eigen::VectorXf t= se3.block(0,0,3,1);
-    // Eigen::VectorXf w= se3.block(3,0,3,1);
-
-    // make so3_hat
-    Eigen::Matrix3d so3_hat;
-    SO3::hat(se3.block(3, 0, 3, 1), so3_hat);
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
 
-    // set values
-    se3_hat = Eigen::Matrix4d::Zero();
-    se3_hat.block(0, 0, 3, 3) = so3_hat;
-    se3_hat.block(0, 3, 3, 1) = se3.block(0, 0, 3, 1);
+inline void hat(const Vector6d &se3, Eigen::Matrix4d &se3_hat)
+{
+    se3_hat.setZero();
+    se3_hat.block<3, 3>(0, 0) = SO3::hat(se3.tail<3>());
+    se3_hat.block<3, 1>(0, 3) = se3.head<3>();
 }
 
-void vee(const Eigen::Matrix4d &se3_hat, Eigen::VectorXd &se3)
+inline void vee(const Eigen::Matrix4d &se3_hat, Vector6d &se3)
 {
-    // set translation
-    se3.block(0, 0, 3, 1) = se3_hat.block(0, 3, 3, 1);
-
-    // make so3
     Eigen::Vector3d so3;
-    SO3::vee(se3_hat.block(0, 0, 3, 3), so3);
-
-    // set orientation
-    se3.block(0, 3, 3, 1) = so3;
+    SO3::vee(se3_hat.block<3, 3>(0, 0), so3);
+    se3.head<3>() = se3_hat.block<3, 1>(0, 3);
+    se3.tail<3>() = so3;
 }
 
-void exp(const Eigen::VectorXd &se3, Eigen::Matrix4d &SE3)
+// Analytic inverse: (R, p)^-1 = (R^T, -R^T p)
+inline Eigen::Isometry3d inverse(const Eigen::Isometry3d &T)
 {
-    // make so3_hat
-    Eigen::Matrix3d so3_hat;
-    SO3::hat(se3.block(3, 0, 3, 1), so3_hat);
+    Eigen::Isometry3d T_inv;
+    T_inv.linear() = T.linear().transpose();
+    T_inv.translation().noalias() = -(T_inv.linear() * T.translation());
+    T_inv.makeAffine();
+    return T_inv;
+}
 
-    float th = se3.norm();
+// target seen from ref: ref^-1 target, without forming the inverse
+inline Eigen::Isometry3d between(const Eigen::Isometry3d &target, const Eigen::Isometry3d &ref)
+{
+    Eigen::Isometry3d d;
+    d.linear().noalias() = ref.linear().transpose() * target.linear();
+    d.translation().noalias() = ref.linear().transpose() * (target.translation() - ref.translation());
+    d.makeAffine();
+    return d;
+}
 
-    // th == 0 , which means no motion. --> Identity.
-    if (FP_ZERO == std::fpclassify(th))
+inline void exp(const Vector6d &se3, Eigen::Isometry3d &SE3)
+{
+    const Eigen::Vector3d w = se3.tail<3>();
+    const double th_sq = w.squaredNorm();
+    const double th = std::sqrt(th_sq);
+    // V = I + (1 - cos(th))/th^2 w^ + (th - sin(th))/th^3 w^2
+    double b, c;
+    if (th < SO3::kSmallAngle)
+    {
+        b = 0.5 - th_sq / 24.0;
+        c = 1.0 / 6.0 - th_sq / 120.0;
+    }
+    else
     {
-        SE3 = Eigen::Matrix4d::Identity();
-        return;
+        b = (1.0 - std::cos(th)) / th_sq;
+        c = (th - std::sin(th)) / (th_sq * th);
     }
+    const Eigen::Matrix3d w_hat = SO3::hat(w);
+    const Eigen::Matrix3d w_hat_sq = w_hat * w_hat;
+    const Eigen::Matrix3d V = Eigen::Matrix3d::Identity() + b * w_hat + c * w_hat_sq;
+
+    Eigen::Matrix3d R;
+    SO3::exp(w, R);
+    SE3.linear() = R;
+    SE3.translation().noalias() = V * se3.head<3>();
+    SE3.makeAffine();
+}
 
-    // make V
-    const float &th_sq = th * th;
-    const float &th_cb = th_sq * th;
-    Eigen::Matrix3d V = Eigen::Matrix3d::Identity() +
-                        so3_hat * (1.0 - std::cos(th)) / (th_sq) +
-                        so3_hat * so3_hat * (th - std::sin(th)) / (th_cb);
-
-    // make SO3
-    Eigen::Matrix3d SO3;
-    SO3::exp(se3.block(3, 0, 3, 1), SO3);
-    SE3.block(0, 0, 3, 3) = SO3;
-    SE3.block(0, 3, 3, 1) = V * se3.block(0, 0, 3, 1);
+inline void exp(const Vector6d &se3, Eigen::Matrix4d &SE3)
+{
+    Eigen::Isometry3d T;
+    exp(se3, T);
+    SE3 = T.matrix();
 }
 
-void log(const Eigen::Matrix4d &SE3, Eigen::VectorXd &se3)
+// modern robotics. page 106, 3.3.3.2
+inline void log(const Eigen::Isometry3d &SE3, Vector6d &se3)
 {
-    // make so3
     Eigen::Vector3d so3;
-    SO3::log(SE3.block(0, 0, 3, 3), so3);
-    const float &th = so3.norm();
-
-    // ROS_INFO_STREAM("th: " << th);
+    SO3::log(SE3.linear(), so3);
+    const double th_sq = so3.squaredNorm();
+    const double th = std::sqrt(th_sq);
 
-    // th == 0 , which means no rotation
-    // modern robotics. page 106, 3.3.3.2, algorithm case (a)
-    if (FP_ZERO == std::fpclassify(th))
+    // V^-1 = I - w^/2 + (1 - th cos(th/2) / (2 sin(th/2))) / th^2 w^2
+    double c;
+    if (th < SO3::kSmallAngle)
     {
-        se3.block(0, 0, 3, 1) = SE3.block(0, 3, 3, 1).normalized();
-        se3.block(3, 0, 3, 1) = Eigen::Vector3d::Zero();
-        // ROS_INFO_STREAM("se3: " << se3.transpose());
-        return;
+        c = 1.0 / 12.0 + th_sq / 720.0;
     }
-    // ROS_INFO_STREAM("bvefore hasdktjakls");
-
-    // make so3_hat
-    Eigen::Matrix3d so3_hat;
-    SO3::hat(so3, so3_hat);
-    // ROS_INFO_STREAM("so3_hat: \n" << so3_hat);
-
-    //make V_inv
-    Eigen::MatrixXd V_inv = Eigen::Matrix3d::Identity() -
-                            so3_hat * 0.5 +
-                            so3_hat * so3_hat * (1.0 - (th * std::cos(0.5 * th) / (2.0 * std::sin(0.5 * th)))) / (th * th);
-    // ROS_INFO_STREAM("V_inv: \n" << V_inv);
-
-    //set se3
-    se3.block(0, 0, 3, 1) = V_inv * SE3.block(0, 3, 3, 1);
-    se3.block(3, 0, 3, 1) = so3;
-    // ROS_INFO_STREAM("__ se3: " << se3.transpose());
+    else
+    {
+        c = (1.0 - th * std::cos(0.5 * th) / (2.0 * std::sin(0.5 * th))) / th_sq;
+    }
+    const Eigen::Matrix3d w_hat = SO3::hat(so3);
+    const Eigen::Vector3d &p = SE3.translation();
+    se3.head<3>() = p - 0.5 * w_hat * p + c * (w_hat * (w_hat * p));
+    se3.tail<3>() = so3;
+}
+
+inline void log(const Eigen::Matrix4d &SE3, Vector6d &se3)
+{
+    log(Eigen::Isometry3d(SE3), se3);
+}
+
+// Ad_T = [R p^R; 0 R], maps a twist in the frame of T to the reference frame of T
+inline void adjoint(const Eigen::Isometry3d &SE3, Matrix6d &adj)
+{
+    const Eigen::Matrix3d &R = SE3.linear();
+    adj.block<3, 3>(0, 0) = R;
+    adj.block<3, 3>(0, 3).noalias() = SO3::hat(SE3.translation()) * R;
+    adj.block<3, 3>(3, 0).setZero();
+    adj.block<3, 3>(3, 3) = R;
+}
+
+inline void adjoint(const Eigen::Matrix4d &SE3, Matrix6d &adj)
+{
+    adjoint(Eigen::Isometry3d(SE3), adj);
+}
+
+// Ad_T twist, without forming Ad_T
+inline void adjoint(const Eigen::Isometry3d &SE3, const Vector6d &twist, Vector6d &out)
+{
+    const Eigen::Vector3d w = SE3.linear() * twist.tail<3>();
+    out.head<3>() = SE3.linear() * twist.head<3>() + SE3.translation().cross(w);
+    out.tail<3>() = w;
 }
 
-void adjoint(const Eigen::Matrix4d &SE3, Eigen::MatrixXd &adj)
+// Ad_frame log(SE3): the exponential coordinates of SE3, expressed in `frame`
+inline void logAdjoint(const Eigen::Isometry3d &SE3, const Eigen::Isometry3d &frame, Vector6d &out)
 {
-    adj.resize(6, 6);
-    Eigen::Matrix3d p_hat;
-    SO3::hat(SE3.block(0, 3, 3, 1), p_hat);
-    adj.block(0, 0, 3, 3) = SE3.block(0, 0, 3, 3);
-    adj.block(3, 0, 3, 3) = p_hat * SE3.block(0, 0, 3, 3);
-    adj.block(0, 3, 3, 3) = Eigen::MatrixXd::Zero(3, 3);
-    adj.block(3, 3, 3, 3) = SE3.block(0, 0, 3, 3);
+    Vector6d se3;
+    log(SE3, se3);
+    adjoint(frame, se3, out);
 }
 }
 
-#endif //KINEMATICS_DEMO_SE3_HPP
\ No newline at end of file
+#endif //KINEMATICS_DEMO_SE3_HPP
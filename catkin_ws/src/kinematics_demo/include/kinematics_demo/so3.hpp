@@ -5,76 +5,86 @@
 #ifndef KINEMATICS_DEMO_SO3_HPP
 #define KINEMATICS_DEMO_SO3_HPP
 
+#include <cmath>
 #include <eigen3/Eigen/Dense>
 
+// Fixed-size, double precision. Modern robotics, chapter 3.2
 namespace SO3
 {
+// Below this angle, exp and log use their Taylor expansions
+const double kSmallAngle = 1e-6;
+
 inline void hat(const Eigen::Vector3d &so3, Eigen::Matrix3d &so3_hat)
 {
-    // ROS_INFO_STREAM("Why you die.daskljfl;k");
-    so3_hat = Eigen::Matrix3d::Zero();
-    // ROS_INFO_STREAM("Why you die.daskljfl;k 0123012301230123");
-    so3_hat(0, 1) = -so3(2);
-    so3_hat(0, 2) = so3(1);
-    so3_hat(1, 2) = -so3(0);
-    so3_hat(1, 0) = so3(2);
-    so3_hat(2, 1) = -so3(1);
-    so3_hat(2, 2) = so3(0);
-    // ROS_INFO_STREAM("Are you kididngklm  lmek asdfjlksa.");
+    so3_hat <<       0.0, -so3(2),  so3(1),
+                  so3(2),     0.0, -so3(0),
+                 -so3(1),  so3(0),     0.0;
+}
+
+inline Eigen::Matrix3d hat(const Eigen::Vector3d &so3)
+{
+    Eigen::Matrix3d so3_hat;
+    hat(so3, so3_hat);
+    return so3_hat;
 }
 
 inline void vee(const Eigen::Matrix3d &so3_hat, Eigen::Vector3d &so3)
 {
-    // normalize matrix.
-    // this is property of skew symmetric matrix.
-    Eigen::Matrix3d n = (so3_hat - so3_hat.transpose()) / 2;
-    so3(0) = -so3_hat(1, 2);
-    so3(1) = so3_hat(0, 2);
-    so3(2) = -so3_hat(0, 1);
+    // skew-symmetric part, for matrices that are skew-symmetric up to round-off
+    so3(0) = 0.5 * (so3_hat(2, 1) - so3_hat(1, 2));
+    so3(1) = 0.5 * (so3_hat(0, 2) - so3_hat(2, 0));
+    so3(2) = 0.5 * (so3_hat(1, 0) - so3_hat(0, 1));
 }
 
 inline void exp(const Eigen::Vector3d &so3, Eigen::Matrix3d &SO3)
 {
-    // calculate theta
-    const float &th = so3.norm();
-    // check divide by zero
-    if (FP_ZERO == std::fpclassify(th))
+    const double th_sq = so3.squaredNorm();
+    const double th = std::sqrt(th_sq);
+    // Rodrigues: I + sin(th)/th w^ + (1 - cos(th))/th^2 w^2
+    double a, b;
+    if (th < kSmallAngle)
     {
-        SO3 = Eigen::Matrix3d::Identity();
-        return;
+        a = 1.0 - th_sq / 6.0;
+        b = 0.5 - th_sq / 24.0;
     }
-    // make so3_hat
-    Eigen::Matrix3d so3_hat;
-    hat(so3, so3_hat);
-    // do exp operation
-    SO3 = Eigen::Matrix3d::Identity()
-        + sin(th) * (so3_hat / th)
-        + (1.0 - cos(th)) * (so3_hat * so3_hat / (th * th));
+    else
+    {
+        a = std::sin(th) / th;
+        b = (1.0 - std::cos(th)) / th_sq;
+    }
+    const Eigen::Matrix3d so3_hat = hat(so3);
+    SO3 = Eigen::Matrix3d::Identity() + a * so3_hat + b * so3_hat * so3_hat;
 }
 
 inline void log(const Eigen::Matrix3d &SO3, Eigen::Vector3d &so3)
 {
-    const float &trace = SO3.trace();
-    const float &cos_th = (trace - 1.0) / 2.0;
-    // cos(th) == 1.0 --> th == 0 --> sin(th) == 0.0
-    if (FP_ZERO == std::fpclassify(cos_th - 1.0))
+    // atan2 instead of acos(cos_th), which loses half the digits near 0 and pi
+    const double cos_th = 0.5 * (SO3.trace() - 1.0);
+    Eigen::Vector3d skew;
+    vee(SO3, skew);  // sin(th) w
+    const double th = std::atan2(skew.norm(), cos_th);
+    if (th < kSmallAngle)
     {
-        so3 = Eigen::Vector3d::Zero();
+        // th / sin(th) ~ 1 + th^2 / 6
+        so3 = (1.0 + th * th / 6.0) * skew;
         return;
     }
-    // cos(th) == - 1.0 --> th == PI --> sin(th) == 0.0
     // modern robotics. page 87. eq 3.58
-    else if (FP_ZERO == std::fpclassify(cos_th + 1.0))
+    // Near pi sin(th) vanishes. The symmetric part of R is cos(th) I + (1 - cos(th)) w w^T,
+    // so the axis comes from its largest diagonal entry instead
+    if (M_PI - th < 1e-3)
     {
-        const float &a = 1.0 / std::sqrt(2.0 * (1 + SO3(2, 2)));
-        so3(0) = a * SO3(0, 2);
-        so3(1) = a * SO3(1, 2);
-        so3(2) = a * (SO3(2, 2) + 1.0);
+        const Eigen::Matrix3d w_w = (0.5 * (SO3 + SO3.transpose()) - cos_th * Eigen::Matrix3d::Identity()) / (1.0 - cos_th);
+        int i;
+        w_w.diagonal().maxCoeff(&i);
+        Eigen::Vector3d axis = w_w.col(i) / std::sqrt(w_w(i, i));
+        // keep the sign consistent with the (small) skew-symmetric part
+        if (axis.dot(skew) < 0.0) { axis = -axis; }
+        so3 = th * axis;
         return;
     }
-    const float &th = std::acos(cos_th);
-    vee((SO3 - SO3.transpose()) * th / (2.0 * std::sin(th)), so3);
+    so3 = (th / std::sin(th)) * skew;
 }
 }
 
-#endif /* KINEMATICS_DEMO_SO3_HPP */
\ No newline at end of file
+#endif /* KINEMATICS_DEMO_SO3_HPP */
@@ -0,0 +1,103 @@
+/**
+ * Batched conversion of a JointTrajectory to end effector poses (and Jacobians).
+ *
+ * The chain from the model root to the end effector is cached once: joints outside of the
+ * group and fixed joints are folded into constant transforms (from the reference state),
+ * so a point costs one rotation or translation per moving joint of the chain and nothing
+ * for the links that are not ancestors of the end effector, unlike
+ * RobotState::setJointGroupPositions + getGlobalLinkTransform which update every link.
+ *
+ * [ Usage ]
+ *     kinematics::TrajectoryFK fk;
+ *     fk.init(*kinematic_state, joint_model_group, eef_link, error);
+ *     fk.convert(plan.trajectory_.joint_trajectory, eef_path);
+ */
+#ifndef KINEMATICS_DEMO_TRAJECTORY_FK_HPP
+#define KINEMATICS_DEMO_TRAJECTORY_FK_HPP
+
+#include <string>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Geometry>
+#include <geometry_msgs/Pose.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <moveit/robot_state/robot_state.h>
+
+namespace kinematics
+{
+    class TrajectoryFK
+    {
+    public:
+        typedef Eigen::Matrix<double, 6, Eigen::Dynamic> Jacobian;
+
+        TrajectoryFK();
+
+        /**
+         * Cache the chain of `eef_link` (the last link of the group if empty).
+         * `state` gives the values of the joints outside of the group.
+         * Fails (and tells why in `error`) for a moving joint that is neither revolute nor prismatic.
+         */
+        bool init(
+            const robot_state::RobotState &state,
+            const robot_model::JointModelGroup *joint_model_group,
+            const std::string &eef_link,
+            std::string &error);
+
+        /** Points of a trajectory are split among up to `num_threads` threads (1: no thread) */
+        void setNumThreads(int num_threads) { num_threads_ = num_threads < 1 ? 1 : num_threads; }
+
+        const std::string &getEndEffectorLink() const { return eef_link_; }
+        // Moving joints of the chain
+        std::size_t getNumJoints() const { return segments_.size(); }
+
+        /**
+         * Pose (model frame) and, if not null, the Jacobian of the end effector origin for
+         * group values in the order of the group variables. Like RobotState::getJacobian,
+         * rows are (v, w) in the model frame and columns follow the group variables.
+         */
+        Eigen::Isometry3d computePose(const std::vector<double> &group_values, Jacobian *jacobian = nullptr) const;
+
+        /**
+         * Every point of `trajectory` at once. Points are matched to the joints by
+         * trajectory.joint_names (the group order if empty); `jacobians` may be null.
+         * Returns false if a point has fewer positions than joint names.
+         */
+        bool convert(
+            const trajectory_msgs::JointTrajectory &trajectory,
+            std::vector<geometry_msgs::Pose> &path,
+            std::vector<Jacobian> *jacobians = nullptr) const;
+
+        bool convert(
+            const trajectory_msgs::JointTrajectory &trajectory,
+            std::vector<Eigen::Isometry3d> &path,
+            std::vector<Jacobian> *jacobians = nullptr) const;
+
+    private:
+        // T(q) = fixed * origin * Rot(axis, q) or origin * Trans(axis * q)
+        struct Segment
+        {
+            Eigen::Isometry3d fixed;   // Constant part of the chain between the previous moving joint and this one
+            Eigen::Vector3d axis;
+            bool prismatic;
+            int variable;              // Index in the group variables
+        };
+
+        // `values` in group order, one per segment through Segment::variable
+        void compute(const double *values, Eigen::Isometry3d &pose, Jacobian *jacobian) const;
+
+        template <typename Pose>
+        bool convertPoints(
+            const trajectory_msgs::JointTrajectory &trajectory,
+            std::vector<Pose> &path,
+            std::vector<Jacobian> *jacobians) const;
+
+        std::string eef_link_;
+        std::vector<Segment> segments_;
+        Eigen::Isometry3d tool_;     // Last moving joint -> end effector
+        std::vector<std::string> variable_names_;
+        std::vector<double> reference_values_;  // Group values of the reference state
+        int num_threads_;
+    };
+}
+
+#endif // KINEMATICS_DEMO_TRAJECTORY_FK_HPP
@@ -0,0 +1,130 @@
+/**
+ * batch_ik_server.cpp
+ *
+ * Batched IK service (kinematics_demo/BatchIK) for the poses of one planning group,
+ * solved on a thread pool (kinematics_demo/batch_ik.hpp).
+ *
+ * [ Demo ]
+ * `roslaunch {ROBOT}_moveit_config demo.launch`
+ * `roslaunch kinematics_demo batch_ik_server.launch robot:={PLANNING_GROUP}`
+ */
+#include <algorithm>
+#include <memory>
+#include <ros/ros.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <tf2_eigen/tf2_eigen.h>
+#include "kinematics_demo/BatchIK.h"
+#include "kinematics_demo/batch_ik.hpp"
+#include "workspace/dh_chain.hpp"
+
+class BatchIKServer
+{
+public:
+    BatchIKServer(
+        ros::NodeHandle &nh,
+        const std::vector<robot_model_loader::RobotModelLoaderPtr> &loaders,
+        const std::string &planning_group,
+        const workspace::AnalyticIK &analytic,
+        std::size_t cache_size,
+        double timeout)
+        : timeout_(timeout)
+    {
+        std::vector<robot_model::RobotModelPtr> models;
+        for (const robot_model_loader::RobotModelLoaderPtr &loader : loaders)
+        {
+            models.push_back(loader->getModel());
+        }
+        ik_.reset(new kinematics::BatchIK(models, planning_group, analytic, cache_size));
+        service_ = nh.advertiseService("batch_ik", &BatchIKServer::solve, this);
+    }
+
+private:
+    bool solve(kinematics_demo::BatchIK::Request &req, kinematics_demo::BatchIK::Response &res)
+    {
+        const std::vector<std::string> &joint_names = ik_->getVariableNames();
+        if (!req.seed.empty() && req.seed.size() != joint_names.size())
+        {
+            ROS_ERROR_STREAM("Seed of " << req.seed.size() << " joints, the group has " << joint_names.size());
+            return false;
+        }
+        targets_.resize(req.poses.size());
+        for (std::size_t i = 0; i < req.poses.size(); i++)
+        {
+            Eigen::fromMsg(req.poses[i], targets_[i]);
+        }
+
+        const ros::WallTime start = ros::WallTime::now();
+        res.num_cached = ik_->solve(targets_, req.seed, req.timeout > 0 ? req.timeout : timeout_, res.solutions, res.success);
+        res.joint_names = joint_names;
+
+        const std::size_t num_solved = std::count(res.success.begin(), res.success.end(), 1);
+        ROS_DEBUG_STREAM("Batch IK: " << num_solved << " / " << req.poses.size() << " solved ("
+                         << res.num_cached << " cached) in " << (ros::WallTime::now() - start).toSec() * 1e3 << " ms");
+        return true;
+    }
+
+    std::unique_ptr<kinematics::BatchIK> ik_;
+    std::vector<Eigen::Isometry3d> targets_;
+    ros::ServiceServer service_;
+    double timeout_;
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "batch_ik_server");
+    ros::NodeHandle nh("~");
+
+    std::string planning_group;
+    int num_threads;
+    int cache_size;
+    double timeout;
+    // IK backend: "kdl" or "analytic"
+    std::string ik_backend;
+    nh.param<std::string>("robot", planning_group, "puma_560");
+    nh.param<int>("num_threads", num_threads, 4);
+    nh.param<int>("cache_size", cache_size, 65536);
+    nh.param<double>("timeout", timeout, 0.005);
+    nh.param<std::string>("ik_backend", ik_backend, "analytic");
+    num_threads = std::max(num_threads, 1);
+
+    std::vector<robot_model_loader::RobotModelLoaderPtr> loaders;
+    for (int t = 0; t < num_threads; t++)
+    {
+        // Sequential on purpose: plugin loading is not thread-safe.
+        loaders.emplace_back(new robot_model_loader::RobotModelLoader("robot_description"));
+    }
+    const robot_model::RobotModelPtr &model = loaders.front()->getModel();
+    const robot_model::JointModelGroup *joint_model_group = model->getJointModelGroup(planning_group);
+    if (joint_model_group == nullptr)
+    {
+        ROS_ERROR_STREAM("Unknown planning group: " << planning_group);
+        return 1;
+    }
+
+    // "analytic": closed-form IK on the DH chain of the group (workspace/analytic_ik.hpp), "kdl" if none
+    workspace::AnalyticIK analytic_ik;
+    if (ik_backend == "analytic")
+    {
+        std::string error;
+        const std::string &eef_link = joint_model_group->getLinkModelNames().back();
+        robot_state::RobotState state(model);
+        state.setToDefaultValues();
+        workspace::DHChain dh_chain;
+        std::vector<workspace::JointLimit> limits;
+        workspace::extractJointLimits(joint_model_group, limits);
+        if (!workspace::extractDHChain(state, joint_model_group, eef_link, dh_chain, error) ||
+            !analytic_ik.init(dh_chain, limits, error) ||
+            !workspace::verifyAnalyticIK(analytic_ik, limits, state, joint_model_group, eef_link, error))
+        {
+            ROS_WARN_STREAM("No analytic IK for [ " << planning_group << " ]: " << error);
+            analytic_ik = workspace::AnalyticIK();
+        }
+    }
+
+    BatchIKServer server(nh, loaders, planning_group, analytic_ik, cache_size, timeout);
+    ROS_INFO_STREAM("Batch IK for [ " << planning_group << " ]: " << num_threads << " threads, "
+                    << (analytic_ik.getKind() != workspace::AnalyticIK::NONE ? "analytic" : "kdl") << " backend");
+
+    ros::spin();
+    return 0;
+}
@@ -5,38 +5,24 @@
  * `roslaunch {ROBOT}_moveit_config demo.launch`
  * `rosrun kinematics_demo ik_linear _robot:={PLANNING_GROUP}`
  *
+ * `_path_ik:=warm_start` (default): one IK target every eef_step along the line, each seeded
+ *                                    by the previous solution (kinematics_demo/path_ik.hpp)
+ * `_path_ik:=cartesian`            : MoveGroupInterface::computeCartesianPath
  */
 #include <ros/ros.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
 #include <moveit_visual_tools/moveit_visual_tools.h>
 #include <trajectory_msgs/JointTrajectory.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_eigen/tf2_eigen.h>
+#include "kinematics_demo/path_ik.hpp"
+#include "kinematics_demo/trajectory_fk.hpp"
 
 namespace rvt = rviz_visual_tools;
 
-void convert_JointTraj_to_PoseTraj(
-    std::vector<geometry_msgs::Pose> &path,
-    const robot_state::RobotStatePtr &rs,
-    const std::string &planning_group,
-    const trajectory_msgs::JointTrajectory &joint_traj)
-{
-    path.clear();
-    const moveit::core::JointModelGroup *jmg = rs->getJointModelGroup(planning_group);
-    const std::string &eef_name = jmg->getLinkModelNames().back();
-    // Joint trajectory to Cartesian path (i == trajectory length)
-    for (int i = 0; i < joint_traj.points.size(); i++)
-    {
-        // Joint trajectory to robot state
-        rs->setJointGroupPositions(jmg, joint_traj.points[i].positions);
-        // Get the position of the end-effector from the RobotState
-        Eigen::Affine3d eef_transformation = rs->getGlobalLinkTransform(eef_name);
-        geometry_msgs::Pose eef_pose = Eigen::toMsg(eef_transformation);
-        path.push_back(eef_pose);
-    }
-}
-
 // Linear interpolation between two position of poses
 void linear_interpolation(
     std::vector<geometry_msgs::Pose> &path,
@@ -59,6 +45,72 @@ void linear_interpolation(
     path.push_back(pose2);
 }
 
+/**
+ * Straight line from `start` to `goal` with one IK target every `eef_step`, solved in order by
+ * the warm-started path IK from the current state. Like computeCartesianPath, returns the
+ * achieved fraction of the path: the trajectory stops before the first target without a
+ * solution or with a branch jump.
+ */
+double computeWarmStartPath(
+    moveit::planning_interface::MoveGroupInterface &move_group,
+    const robot_model::JointModelGroup *joint_model_group,
+    const geometry_msgs::Pose &start,
+    const geometry_msgs::Pose &goal,
+    double eef_step,
+    const kinematics::PathIKOptions &options,
+    moveit_msgs::RobotTrajectory &trajectory)
+{
+    robot_state::RobotStatePtr state = move_group.getCurrentState();
+    kinematics::PathIK path_ik(state, joint_model_group, joint_model_group->getLinkModelNames().back(), options);
+
+    const double distance = std::sqrt(
+        std::pow(goal.position.x - start.position.x, 2) +
+        std::pow(goal.position.y - start.position.y, 2) +
+        std::pow(goal.position.z - start.position.z, 2));
+    const int n_points = std::max(2, static_cast<int>(std::ceil(distance / eef_step)) + 1);
+    std::vector<geometry_msgs::Pose> poses;
+    linear_interpolation(poses, start, goal, n_points);
+    poses.pop_back();  // the goal, repeated by linear_interpolation
+    std::vector<Eigen::Isometry3d> targets(poses.size());
+    for (std::size_t i = 0; i < poses.size(); i++)
+    {
+        Eigen::fromMsg(poses[i], targets[i]);
+    }
+
+    std::vector<std::vector<double>> path;
+    std::vector<kinematics::PathIKResult> results;
+    path_ik.solvePath(targets, path, results);
+
+    robot_trajectory::RobotTrajectory robot_trajectory(state->getRobotModel(), joint_model_group->getName());
+    robot_state::RobotState waypoint(*state);
+    int iterations = 0;
+    unsigned int restarts = 0;
+    std::size_t n_solved = 0;
+    for (; n_solved < path.size(); n_solved++)
+    {
+        if (results[n_solved].branch_jump)
+        {
+            ROS_WARN("Branch jump at target %zu (%.3f joint step)", n_solved, results[n_solved].max_joint_step);
+            break;
+        }
+        iterations += results[n_solved].iterations;
+        restarts += results[n_solved].restarts;
+        waypoint.setJointGroupPositions(joint_model_group, path[n_solved]);
+        robot_trajectory.addSuffixWayPoint(waypoint, 0.0);
+    }
+    ROS_INFO("Path IK: %zu / %zu targets, %.2f Newton steps per target, %u restarts",
+        n_solved, targets.size(), n_solved ? static_cast<double>(iterations) / n_solved : 0.0, restarts);
+    if (n_solved < 2)
+    {
+        return 0.0;
+    }
+
+    trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+    time_parameterization.computeTimeStamps(robot_trajectory);
+    robot_trajectory.getRobotTrajectoryMsg(trajectory);
+    return static_cast<double>(n_solved) / targets.size();
+}
+
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "ik_linear");
@@ -78,6 +130,10 @@ int main(int argc, char **argv)
         ROS_ERROR_STREAM_NAMED(LOGNAME, "No planning group specified");
         return 1;
     }
+    std::string path_ik;
+    nh.param<std::string>("path_ik", path_ik, "warm_start");
+    kinematics::PathIKOptions path_ik_options;
+    nh.param<bool>("/robot_description_kinematics/" + planning_group + "/position_only_ik", path_ik_options.position_only, false);
 
     // Waypoints: Sqaure trajectory
     geometry_msgs::Pose target_pose1;
@@ -132,6 +188,15 @@ int main(int argc, char **argv)
     robot_state::RobotStatePtr kinematic_state(move_group.getCurrentState());
     const robot_state::JointModelGroup *joint_model_group = kinematic_state->getJointModelGroup(planning_group);
 
+    // End effector path of the planned trajectories
+    kinematics::TrajectoryFK trajectory_fk;
+    std::string fk_error;
+    if (!trajectory_fk.init(*kinematic_state, joint_model_group, "", fk_error))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Cannot convert trajectories of [ " << planning_group << " ]: " << fk_error);
+        return 1;
+    }
+
     // Placeholder for joint values
     std::vector<double> joint_values(joint_model_group->getVariableCount());
 
@@ -177,17 +242,26 @@ int main(int argc, char **argv)
         linear_interpolation(waypoints_lin, waypoints[i], waypoints[next_i], 10);
 
         // Motion planning
+        const double eef_step = 0.01;
         moveit_msgs::RobotTrajectory trajectory;
         double fraction = -1.0;  // -1.0 is error
-        for (std::size_t attempts_ = 10; attempts_ > 0; attempts_--)
+        if (path_ik == "warm_start")
+        {
+            fraction = computeWarmStartPath(
+                move_group, joint_model_group, waypoints[i], waypoints[next_i], eef_step, path_ik_options, trajectory);
+        }
+        else
         {
-            fraction = move_group.computeCartesianPath(
-                waypoints_lin,
-                0.01,  // eef_step
-                0.0,   // jump_threshold
-                trajectory
-            );
-            if (fraction > 0.0) {break;}
+            for (std::size_t attempts_ = 10; attempts_ > 0; attempts_--)
+            {
+                fraction = move_group.computeCartesianPath(
+                    waypoints_lin,
+                    eef_step,
+                    0.0,   // jump_threshold
+                    trajectory
+                );
+                if (fraction > 0.0) {break;}
+            }
         }
         ROS_INFO("Cartesian path (%.2f%% acheived)", fraction * 100.0);
 
@@ -196,11 +270,7 @@ int main(int argc, char **argv)
         {
             // Path visualization
             std::vector<geometry_msgs::Pose> eef_path;
-            convert_JointTraj_to_PoseTraj(
-                eef_path,
-                kinematic_state,
-                planning_group,
-                trajectory.joint_trajectory);
+            trajectory_fk.convert(trajectory.joint_trajectory, eef_path);
             visual_tools.publishPath(eef_path, rvt::LIME_GREEN, rvt::SMALL);
             for (std::size_t i = 0; i < num_waypoints; ++i)
             {
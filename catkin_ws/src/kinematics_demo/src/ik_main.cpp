@@ -13,30 +13,10 @@
 #include <trajectory_msgs/JointTrajectory.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_eigen/tf2_eigen.h>
+#include "kinematics_demo/trajectory_fk.hpp"
 
 namespace rvt = rviz_visual_tools;
 
-void convert_JointTraj_to_PoseTraj(
-    std::vector<geometry_msgs::Pose> &path,
-    const robot_state::RobotStatePtr &rs,
-    const std::string &planning_group,
-    const trajectory_msgs::JointTrajectory &joint_traj)
-{
-    path.clear();
-    const moveit::core::JointModelGroup *jmg = rs->getJointModelGroup(planning_group);
-    const std::string &eef_name = jmg->getLinkModelNames().back();
-    // Joint trajectory to Cartesian path (i == trajectory length)
-    for (int i = 0; i < joint_traj.points.size(); i++)
-    {
-        // Joint trajectory to robot state
-        rs->setJointGroupPositions(jmg, joint_traj.points[i].positions);
-        // Get the position of the end-effector from the RobotState
-        Eigen::Affine3d eef_transformation = rs->getGlobalLinkTransform(eef_name);
-        geometry_msgs::Pose eef_pose = Eigen::toMsg(eef_transformation);
-        path.push_back(eef_pose);
-    }
-}
-
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "ik_node");
@@ -111,6 +91,15 @@ int main(int argc, char **argv)
     robot_state::RobotStatePtr kinematic_state(move_group.getCurrentState());
     const robot_state::JointModelGroup *joint_model_group = kinematic_state->getJointModelGroup(planning_group);
 
+    // End effector path of the planned trajectories
+    kinematics::TrajectoryFK trajectory_fk;
+    std::string fk_error;
+    if (!trajectory_fk.init(*kinematic_state, joint_model_group, "", fk_error))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Cannot convert trajectories of [ " << planning_group << " ]: " << fk_error);
+        return 1;
+    }
+
     // Placeholder for joint values
     std::vector<double> target_joints(joint_model_group->getVariableCount());
 
@@ -154,11 +143,7 @@ int main(int argc, char **argv)
         {
             // Path visualization
             std::vector<geometry_msgs::Pose> eef_path;
-            convert_JointTraj_to_PoseTraj(
-                eef_path,
-                kinematic_state,
-                planning_group,
-                my_plan.trajectory_.joint_trajectory);
+            trajectory_fk.convert(my_plan.trajectory_.joint_trajectory, eef_path);
             visual_tools.publishPath(eef_path, rvt::LIME_GREEN, rvt::SMALL);
             for (std::size_t i = 0; i < num_waypoints; ++i)
             {
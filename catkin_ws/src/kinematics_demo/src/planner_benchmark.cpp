@@ -0,0 +1,319 @@
+/**
+ * planner_benchmark.cpp
+ *
+ * Canonical scenes and queries per planning group, planned `runs` times with every OMPL
+ * planner of `planners` and with computeCartesianPath ("cartesian").
+ *  - Queries go around the waypoint loops of ik_main (square) and pick_n_place, between
+ *    joint states solved once by IK, so every run of a query is the same planning problem.
+ *  - Results go to {results_dir}/{robot}_runs.csv and {robot}_summary.csv
+ *    (kinematics_demo/planner_benchmark.hpp). With `baseline` (a previous summary),
+ *    latency and success regressions are reported and the node exits with 2.
+ *
+ * [ Run ]
+ * `roslaunch kinematics_demo planner_benchmark.launch robot:={PLANNING_GROUP} moveit_config:={ROBOT}_moveit_config`
+ */
+#include <cmath>
+#include <ros/ros.h>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_scene_interface/planning_scene_interface.h>
+#include <moveit_msgs/CollisionObject.h>
+#include <shape_msgs/SolidPrimitive.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <tf2_eigen/tf2_eigen.h>
+#include "kinematics_demo/planner_benchmark.hpp"
+#include "kinematics_demo/trajectory_fk.hpp"
+
+struct Scene
+{
+    std::string name;
+    std::vector<moveit_msgs::CollisionObject> objects;
+};
+
+struct Query
+{
+    std::string name;
+    std::size_t start;  // Waypoint indices
+    std::size_t goal;
+};
+
+geometry_msgs::Pose makePose(double x, double y, double z, const geometry_msgs::Quaternion &orientation)
+{
+    geometry_msgs::Pose pose;
+    pose.position.x = x;
+    pose.position.y = y;
+    pose.position.z = z;
+    pose.orientation = orientation;
+    return pose;
+}
+
+moveit_msgs::CollisionObject makeBox(
+    const std::string &id, const std::string &frame,
+    double x, double y, double z, double size_x, double size_y, double size_z)
+{
+    moveit_msgs::CollisionObject object;
+    object.header.frame_id = frame;
+    object.id = id;
+    shape_msgs::SolidPrimitive box;
+    box.type = box.BOX;
+    box.dimensions = {size_x, size_y, size_z};
+    geometry_msgs::Pose pose;
+    pose.orientation.w = 1.0;
+    pose.position.x = x;
+    pose.position.y = y;
+    pose.position.z = z;
+    object.primitives.push_back(box);
+    object.primitive_poses.push_back(pose);
+    object.operation = object.ADD;
+    return object;
+}
+
+// Closed loop: query i goes from waypoint i to waypoint i + 1
+void addLoop(const std::string &name, const std::vector<geometry_msgs::Pose> &loop,
+             std::vector<geometry_msgs::Pose> &waypoints, std::vector<Query> &queries)
+{
+    const std::size_t first = waypoints.size();
+    waypoints.insert(waypoints.end(), loop.begin(), loop.end());
+    for (std::size_t i = 0; i < loop.size(); i++)
+    {
+        queries.push_back(Query{name + std::to_string(i), first + i, first + (i + 1) % loop.size()});
+    }
+}
+
+// Square of side (dx, dy) from `corner`, as in ik_main
+std::vector<geometry_msgs::Pose> makeSquare(const geometry_msgs::Pose &corner, double dx, double dy)
+{
+    std::vector<geometry_msgs::Pose> square(4, corner);
+    square[1].position.x += dx;
+    square[2].position.x += dx;
+    square[2].position.y += dy;
+    square[3].position.y += dy;
+    return square;
+}
+
+/**
+ * Scenes and waypoint loops of `planning_group`, false if the group has none.
+ * `zero_pose` is the end effector at the default state (for the scara, placed relative to it).
+ */
+bool makeBenchmark(
+    const std::string &planning_group,
+    const std::string &frame,
+    const geometry_msgs::Pose &zero_pose,
+    std::vector<Scene> &scenes,
+    std::vector<geometry_msgs::Pose> &waypoints,
+    std::vector<Query> &queries)
+{
+    scenes.push_back(Scene{"empty", {}});
+    if (planning_group == "puma_560")
+    {
+        const geometry_msgs::Quaternion down = tf2::toMsg(tf2::Quaternion(tf2::Vector3(1.0, 0.0, 0.0), M_PI));
+        addLoop("square", makeSquare(makePose(0.3, -0.2, 0.6, down), 0.4, 0.4), waypoints, queries);
+        addLoop("pick", {makePose(0.4, 0.25, 0.5, down), makePose(0.4, 0.25, 0.7, down),
+                         makePose(0.4, -0.25, 0.7, down), makePose(0.4, -0.25, 0.5, down)}, waypoints, queries);
+        // Below the plane of the square, inside of it
+        scenes.push_back(Scene{"pillar", {makeBox("pillar", frame, 0.5, 0.0, 0.2, 0.05, 0.05, 0.4)}});
+    }
+    else if (planning_group == "rrr")
+    {
+        geometry_msgs::Quaternion identity;
+        identity.w = 1.0;
+        addLoop("square", makeSquare(makePose(0.25, -0.1, 0.02, identity), 0.2, 0.2), waypoints, queries);
+        // In the plane of the arm, swept by the elbow
+        scenes.push_back(Scene{"post", {makeBox("post", frame, 0.0, 0.3, 0.02, 0.04, 0.04, 0.1)}});
+    }
+    else if (planning_group == "scara")
+    {
+        geometry_msgs::Pose corner = zero_pose;
+        corner.position.x -= 0.2;
+        corner.position.y -= 0.08;
+        addLoop("square", makeSquare(corner, 0.1, 0.16), waypoints, queries);
+        scenes.push_back(Scene{"post", {makeBox("post", frame, 0.0, 0.25, zero_pose.position.z, 0.04, 0.04, 0.2)}});
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+double jointPathLength(const trajectory_msgs::JointTrajectory &trajectory)
+{
+    double length = 0.0;
+    for (std::size_t i = 1; i < trajectory.points.size(); i++)
+    {
+        double step = 0.0;
+        for (std::size_t j = 0; j < trajectory.points[i].positions.size(); j++)
+        {
+            step += std::pow(trajectory.points[i].positions[j] - trajectory.points[i - 1].positions[j], 2);
+        }
+        length += std::sqrt(step);
+    }
+    return length;
+}
+
+double eefPathLength(const kinematics::TrajectoryFK &trajectory_fk, const trajectory_msgs::JointTrajectory &trajectory)
+{
+    std::vector<Eigen::Isometry3d> path;
+    trajectory_fk.convert(trajectory, path);
+    double length = 0.0;
+    for (std::size_t i = 1; i < path.size(); i++)
+    {
+        length += (path[i].translation() - path[i - 1].translation()).norm();
+    }
+    return length;
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "planner_benchmark");
+    ros::NodeHandle nh("~");
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    static const std::string LOGNAME = "planner_benchmark";
+
+    std::string planning_group;
+    std::vector<std::string> planners;
+    int runs;
+    double planning_time;
+    double eef_step;
+    std::string results_dir;
+    std::string baseline;
+    double time_tolerance;
+    double success_tolerance;
+    nh.param<std::string>("robot", planning_group, "puma_560");
+    nh.param<std::vector<std::string>>("planners", planners, {"RRTConnect", "RRT", "BiTRRT", "KPIECE", "PRM"});
+    nh.param<int>("runs", runs, 10);
+    nh.param<double>("planning_time", planning_time, 1.0);
+    nh.param<double>("eef_step", eef_step, 0.01);
+    nh.param<std::string>("results_dir", results_dir, ".");
+    nh.param<std::string>("baseline", baseline, "");
+    nh.param<double>("time_tolerance", time_tolerance, 0.2);
+    nh.param<double>("success_tolerance", success_tolerance, 0.1);
+
+    moveit::planning_interface::MoveGroupInterface move_group(planning_group);
+    moveit::planning_interface::PlanningSceneInterface planning_scene_interface;
+    move_group.setPlanningTime(planning_time);
+    robot_state::RobotStatePtr kinematic_state(move_group.getCurrentState());
+    const robot_state::JointModelGroup *joint_model_group = kinematic_state->getJointModelGroup(planning_group);
+    kinematics::TrajectoryFK trajectory_fk;
+    std::string fk_error;
+    if (!trajectory_fk.init(*kinematic_state, joint_model_group, "", fk_error))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Cannot convert trajectories of [ " << planning_group << " ]: " << fk_error);
+        return 1;
+    }
+
+    // Scenes and queries
+    kinematic_state->setToDefaultValues();
+    std::vector<double> zero_joints;
+    kinematic_state->copyJointGroupPositions(joint_model_group, zero_joints);
+    const geometry_msgs::Pose zero_pose = Eigen::toMsg(trajectory_fk.computePose(zero_joints));
+    std::vector<Scene> scenes;
+    std::vector<geometry_msgs::Pose> waypoints;
+    std::vector<Query> queries;
+    if (!makeBenchmark(planning_group, move_group.getPlanningFrame(), zero_pose, scenes, waypoints, queries))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Unsupported planning group: " << planning_group);
+        return 1;
+    }
+
+    // Waypoint joint states, each seeded by the previous one so a loop stays on one branch
+    std::vector<robot_state::RobotState> waypoint_states;
+    std::vector<bool> solved(waypoints.size(), false);
+    for (std::size_t w = 0; w < waypoints.size(); w++)
+    {
+        solved[w] = kinematic_state->setFromIK(joint_model_group, waypoints[w], 10, 0.1);
+        if (!solved[w])
+        {
+            ROS_WARN_STREAM_NAMED(LOGNAME, "No IK solution for waypoint " << w << ", its queries are skipped");
+        }
+        waypoint_states.push_back(*kinematic_state);
+    }
+
+    // ===== Benchmark =====
+    std::vector<planning_benchmark::RunResult> results;
+    std::vector<std::string> methods = planners;
+    methods.push_back("cartesian");
+    for (const Scene &scene : scenes)
+    {
+        planning_scene_interface.applyCollisionObjects(scene.objects);
+        for (const std::string &method : methods)
+        {
+            ROS_INFO_STREAM_NAMED(LOGNAME, "Scene [ " << scene.name << " ], " << method);
+            if (method != "cartesian") { move_group.setPlannerId(method); }
+            for (const Query &query : queries)
+            {
+                if (!solved[query.start] || !solved[query.goal]) { continue; }
+                const robot_state::RobotState &goal_state = waypoint_states[query.goal];
+                std::vector<double> goal_joints;
+                goal_state.copyJointGroupPositions(joint_model_group, goal_joints);
+                for (int run = 0; run < runs; run++)
+                {
+                    move_group.setStartState(waypoint_states[query.start]);
+                    planning_benchmark::RunResult result{scene.name, query.name, method, run, false, 0.0, 0.0, 0.0};
+                    moveit_msgs::RobotTrajectory trajectory;
+                    const ros::WallTime start = ros::WallTime::now();
+                    if (method == "cartesian")
+                    {
+                        // To the FK of the goal state: the same goal as the planners
+                        const std::vector<geometry_msgs::Pose> goal{Eigen::toMsg(trajectory_fk.computePose(goal_joints))};
+                        result.success = move_group.computeCartesianPath(goal, eef_step, 0.0, trajectory) >= 1.0 - 1e-9;
+                    }
+                    else
+                    {
+                        moveit::planning_interface::MoveGroupInterface::Plan plan;
+                        move_group.setJointValueTarget(goal_joints);
+                        result.success = move_group.plan(plan) == moveit::planning_interface::MoveItErrorCode::SUCCESS;
+                        trajectory = plan.trajectory_;
+                    }
+                    result.time = (ros::WallTime::now() - start).toSec();
+                    if (result.success)
+                    {
+                        result.joint_length = jointPathLength(trajectory.joint_trajectory);
+                        result.eef_length = eefPathLength(trajectory_fk, trajectory.joint_trajectory);
+                    }
+                    results.push_back(result);
+                    if (!ros::ok()) { return 1; }
+                }
+            }
+        }
+        std::vector<std::string> ids;
+        for (const moveit_msgs::CollisionObject &object : scene.objects) { ids.push_back(object.id); }
+        planning_scene_interface.removeCollisionObjects(ids);
+    }
+
+    // ===== Results =====
+    const std::vector<planning_benchmark::Summary> summaries = planning_benchmark::summarize(results);
+    const std::string prefix = results_dir + "/" + planning_group;
+    if (!planning_benchmark::writeRuns(prefix + "_runs.csv", results) ||
+        !planning_benchmark::writeSummary(prefix + "_summary.csv", summaries))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Cannot write the results to " << results_dir);
+        return 1;
+    }
+    for (const planning_benchmark::Summary &s : summaries)
+    {
+        ROS_INFO_STREAM_NAMED(LOGNAME, s.scene << " / " << s.planner << ": success " << s.success_rate * 100.0
+                              << " %, time p50 " << s.time_p50 << " p90 " << s.time_p90 << " p99 " << s.time_p99
+                              << " s, eef length p50 " << s.eef_length_p50 << " m");
+    }
+    ROS_INFO_STREAM_NAMED(LOGNAME, "Results: " << prefix << "_{runs,summary}.csv");
+
+    if (baseline.empty())
+    {
+        return 0;
+    }
+    std::vector<planning_benchmark::Summary> baseline_summaries;
+    if (!planning_benchmark::readSummary(baseline, baseline_summaries))
+    {
+        ROS_ERROR_STREAM_NAMED(LOGNAME, "Cannot read the baseline: " << baseline);
+        return 1;
+    }
+    const std::vector<std::string> regressions =
+        planning_benchmark::compare(baseline_summaries, summaries, time_tolerance, success_tolerance);
+    for (const std::string &regression : regressions)
+    {
+        ROS_WARN_STREAM_NAMED(LOGNAME, "Regression: " << regression);
+    }
+    ROS_INFO_STREAM_NAMED(LOGNAME, regressions.size() << " regressions against " << baseline);
+    return regressions.empty() ? 0 : 2;
+}
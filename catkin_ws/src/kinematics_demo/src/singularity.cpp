@@ -10,28 +10,35 @@
 #include <algorithm>
 #include <iomanip>
 #include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
 #include <ros/ros.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
 // #include <moveit_visual_tools/moveit_visual_tools.h>
 #include <geometry_msgs/Pose.h>
 #include <sensor_msgs/JointState.h>
+#include <std_msgs/Float64MultiArray.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/InteractiveMarkerControl.h>
 #include <interactive_markers/interactive_marker_server.h>
-#include <tf2_eigen/tf2_eigen.h>
-#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
-#include <tf/tf.h>
 #include <eigen3/Eigen/Dense>
 
 // https://github.com/ohilho/PoseRepresentationLibrary
 #include "kinematics_demo/so3.hpp"
 #include "kinematics_demo/se3.hpp"
+#include "kinematics_demo/dls.hpp"
+#include "kinematics_demo/realtime.hpp"
+#include "workspace/stats.hpp"
 
 // Global variables to make this code easier
+// The targets are written by the marker feedback (spinner thread) and read by the servo thread
 bool is_global_initialized = false;
-geometry_msgs::Pose eef_target1;
-geometry_msgs::Pose eef_target2;
+realtime::LatestValue<Eigen::Isometry3d> eef_target1;
+realtime::LatestValue<Eigen::Isometry3d> eef_target2;
 const std::string t1_name = "eef_target1";
 const std::string t2_name = "eef_target2";
 
@@ -41,6 +48,32 @@ void debugPause()
     std::cin.ignore();
 }
 
+namespace kinematics
+{
+    // geometry_msgs <-> Eigen, only at the ROS boundary (markers and publishers)
+    Eigen::Isometry3d toIsometry(const geometry_msgs::Pose &pose)
+    {
+        Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+        T.translate(Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z));
+        T.rotate(Eigen::Quaterniond(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z).normalized());
+        return T;
+    }
+
+    geometry_msgs::Pose toPose(const Eigen::Isometry3d &T)
+    {
+        const Eigen::Quaterniond q(T.linear());
+        geometry_msgs::Pose pose;
+        pose.position.x = T.translation().x();
+        pose.position.y = T.translation().y();
+        pose.position.z = T.translation().z();
+        pose.orientation.x = q.x();
+        pose.orientation.y = q.y();
+        pose.orientation.z = q.z();
+        pose.orientation.w = q.w();
+        return pose;
+    }
+}
+
 /***********************************
  * VISUALIZATION
  ***********************************/
@@ -69,11 +102,11 @@ namespace visualization
             << feedback->pose.orientation.z << ")");
         if (t1_name.compare(feedback->marker_name) == 0)
         {
-            eef_target1 = feedback->pose;
+            eef_target1.write(kinematics::toIsometry(feedback->pose));
         }
         else if (t2_name.compare(feedback->marker_name) == 0)
         {
-            eef_target2 = feedback->pose;
+            eef_target2.write(kinematics::toIsometry(feedback->pose));
         }
     }
 
@@ -231,11 +264,11 @@ namespace kinematics
         const robot_state::RobotStatePtr &kinematic_state,
         const robot_model::JointModelGroup *joint_model_group,
         const std::string &eef_link,
-        geometry_msgs::Pose &pose)
+        Eigen::Isometry3d &pose)
     {
         kinematic_state->setJointGroupPositions(joint_model_group, joint_values);
-        Eigen::Affine3d eef_transformation = kinematic_state->getGlobalLinkTransform(eef_link);
-        pose = Eigen::toMsg(eef_transformation);
+        // Affine3d or Isometry3d depending on the MoveIt version
+        pose.matrix() = kinematic_state->getGlobalLinkTransform(eef_link).matrix();
     }
 
     Eigen::Matrix3d getRotationMatrix(const geometry_msgs::Quaternion &q)
@@ -245,109 +278,6 @@ namespace kinematics
         return R;
     }
 
-    geometry_msgs::Pose dPose_geom(
-        const geometry_msgs::Pose &target,
-        const geometry_msgs::Pose &ref)
-    {
-        tf::Transform target_tf(
-            tf::Quaternion(target.orientation.x, target.orientation.y, target.orientation.z, target.orientation.w),
-            tf::Vector3(target.position.x, target.position.y, target.position.z));
-        tf::Transform ref_tf(
-            tf::Quaternion(ref.orientation.x, ref.orientation.y, ref.orientation.z, ref.orientation.w),
-            tf::Vector3(ref.position.x, ref.position.y, ref.position.z));
-        // target -> ref
-        tf::Transform d_tf = ref_tf.inverse() * target_tf;
-        geometry_msgs::Pose d_pose;
-        tf::poseTFToMsg(d_tf, d_pose);
-        return d_pose;
-    }
-
-    Eigen::Matrix4d dPose(
-        const geometry_msgs::Pose &target,
-        const geometry_msgs::Pose &ref)
-    {
-        tf::Transform target_tf(
-            tf::Quaternion(target.orientation.x, target.orientation.y, target.orientation.z, target.orientation.w),
-            tf::Vector3(target.position.x, target.position.y, target.position.z));
-        tf::Transform ref_tf(
-            tf::Quaternion(ref.orientation.x, ref.orientation.y, ref.orientation.z, ref.orientation.w),
-            tf::Vector3(ref.position.x, ref.position.y, ref.position.z));
-        // target -> ref
-        tf::Transform d_tf = ref_tf.inverse() * target_tf;
-        Eigen::Matrix4d d_pose;
-        d_pose << d_tf.getBasis().getRow(0).getX(), d_tf.getBasis().getRow(0).getY(), d_tf.getBasis().getRow(0).getZ(), d_tf.getOrigin().getX(),
-                  d_tf.getBasis().getRow(1).getX(), d_tf.getBasis().getRow(1).getY(), d_tf.getBasis().getRow(1).getZ(), d_tf.getOrigin().getY(),
-                  d_tf.getBasis().getRow(2).getX(), d_tf.getBasis().getRow(2).getY(), d_tf.getBasis().getRow(2).getZ(), d_tf.getOrigin().getZ(),
-                  0, 0, 0, 1;
-        // ROS_INFO_STREAM("d_pose mat:\n" << d_pose);
-        return d_pose;
-    }
-
-    void calculateDampedPseudoInverse_without_SVD(
-        const Eigen::MatrixXd &jacb, Eigen::MatrixXd &jacb_pseudo_inv, double eps, double lambda)
-    {
-        // http://www.cs.cmu.edu/~15464-s13/lectures/lecture6/iksurvey.pdf
-        Eigen::MatrixXd jacb_transpose = jacb.transpose();
-        // ROS_INFO_STREAM("jacb rows: " << jacb.rows());
-        if (jacb.rows() >= jacb.cols())  // J is tall. left inverse.
-        {
-            // eq(10)
-            Eigen::MatrixXd lhs = (
-                jacb_transpose * jacb +
-                lambda * lambda * Eigen::MatrixXd::Identity(jacb.cols(), jacb.cols()));
-            // ROS_WARN_STREAM("left-hand-side: \n" << lhs);
-            // ROS_WARN_STREAM("lhs.inverse: \n" << lhs.inverse());
-            jacb_pseudo_inv = lhs.inverse() * jacb_transpose;
-        }
-        else  // J is fat.right inverse.
-        {
-            // eq(11)
-            Eigen::MatrixXd rhs = (
-                jacb * jacb_transpose +
-                lambda * lambda * Eigen::MatrixXd::Identity(jacb.rows(), jacb.rows()));
-            // ROS_WARN_STREAM("right-hand-side: \n" << rhs);
-            // ROS_WARN_STREAM("rhs.inverse: \n" << rhs.inverse());
-            jacb_pseudo_inv = jacb_transpose * rhs.inverse();
-        }
-    }
-
-    /** This method is also called damped least squares method.
-     * Copied from STOMP
-     * http://docs.ros.org/en/kinetic/api/stomp_moveit/html/namespacestomp__moveit_1_1utils_1_1kinematics.html#a1a46c199beea4b6d10f18f9c709ebdef
-     */
-    void calculateDampedPseudoInverse_with_SVD(
-        const Eigen::MatrixXd &jacb, Eigen::MatrixXd &jacb_pseudo_inv, double eps, double lambda)
-    {
-        using namespace Eigen;
-        //Calculate A+ (pseudoinverse of A) = V S+ U*, where U* is Hermition of U (just transpose if all values of U are real)
-        //in order to solve Ax=b -> x*=A+ b
-        Eigen::JacobiSVD<MatrixXd> svd(jacb, Eigen::ComputeThinU | Eigen::ComputeThinV);
-        const MatrixXd &U = svd.matrixU();
-        const VectorXd &Sv = svd.singularValues();
-        const MatrixXd &V = svd.matrixV();
-
-        // calculate the reciprocal of Singular-Values
-        // damp inverse with lambda so that inverse doesn't oscillate near solution
-        size_t nSv = Sv.size();
-        VectorXd inv_Sv(nSv);
-        for(size_t i=0; i< nSv; ++i)
-        {
-            // ROS_WARN_STREAM("fabs(Sv(i)): " << fabs(Sv(i)) << " eps: " << eps);
-            // ROS_INFO_STREAM("1/Sv(i): " << 1.0/Sv(i));
-            // ROS_INFO_STREAM("Sv(i)/(Sv*Sv+lmb*lmb): " << Sv(i) / (Sv(i)*Sv(i) + lambda*lambda) << " lambda: " << lambda);
-            // debugPause();
-            if (fabs(Sv(i)) > eps)
-            {
-                inv_Sv(i) = 1/Sv(i);
-            }
-            else
-            {
-                inv_Sv(i) = Sv(i) / (Sv(i)*Sv(i) + lambda*lambda);
-            }
-        }
-        jacb_pseudo_inv = V * inv_Sv.asDiagonal() * U.transpose();
-    }
-
     /**
      * Copied from STOMP
      * http://docs.ros.org/en/indigo/api/stomp_moveit/html/namespacestomp__moveit_1_1utils_1_1kinematics.html#a14b644b93916381e79420d4e5ec4ea2c
@@ -416,7 +346,7 @@ namespace kinematics
 class LocalTarget
 {
 public:
-    LocalTarget(const geometry_msgs::Pose &pose, double linear_vel, double dquat_rot_vel):
+    LocalTarget(const Eigen::Isometry3d &pose, double linear_vel, double dquat_rot_vel):
         pose_(pose), linear_vel_(linear_vel), dquat_rot_vel_(dquat_rot_vel)
     {
         waitForGlobalInitialization_(); // Wait for the interactive markers
@@ -424,7 +354,7 @@ public:
     };
     ~LocalTarget() {};
 
-    geometry_msgs::Pose getPose() {return pose_;}
+    const Eigen::Isometry3d &getPose() const {return pose_;}
 
     void updatePose()
     {
@@ -435,14 +365,9 @@ public:
         double slerp_t = time_elapsed / expected_duration_;
         if (slerp_t > 1.0) {slerp_t = 1.0;}
         // Calculate the new position with linear interpolation
-        pose_.position.x = (to_.position.x - from_.position.x) * slerp_t + from_.position.x;
-        pose_.position.y = (to_.position.y - from_.position.y) * slerp_t + from_.position.y;
-        pose_.position.z = (to_.position.z - from_.position.z) * slerp_t + from_.position.z;
+        pose_.translation() = from_.translation() + (to_.translation() - from_.translation()) * slerp_t;
         // Calculate the new orientation with spherical linear interpolation (slerp)
-        tf2::Quaternion q1(from_.orientation.x, from_.orientation.y, from_.orientation.z, from_.orientation.w);
-        tf2::Quaternion q2(to_.orientation.x, to_.orientation.y, to_.orientation.z, to_.orientation.w);
-        tf2::Quaternion q_slerp = tf2::slerp(q1, q2, slerp_t);
-        pose_.orientation = tf2::toMsg(q_slerp);
+        pose_.linear() = from_quat_.slerp(slerp_t, to_quat_).toRotationMatrix();
     }
 
 private:
@@ -458,35 +383,29 @@ private:
     bool isClose_()
     {
         const double tolerance = 0.01;
-        return (fabs(pose_.position.x - to_.position.x) < tolerance &&
-                fabs(pose_.position.y - to_.position.y) < tolerance &&
-                fabs(pose_.position.z - to_.position.z) < tolerance &&
-                fabs(pose_.orientation.x - to_.orientation.x) < tolerance &&
-                fabs(pose_.orientation.y - to_.orientation.y) < tolerance &&
-                fabs(pose_.orientation.z - to_.orientation.z) < tolerance &&
-                fabs(pose_.orientation.w - to_.orientation.w) < tolerance);
+        const Eigen::Quaterniond quat(pose_.linear());
+        return ((pose_.translation() - to_.translation()).cwiseAbs().maxCoeff() < tolerance &&
+                (quat.coeffs() - to_quat_.coeffs()).cwiseAbs().maxCoeff() < tolerance);
     }
 
     void reset_(int global_target_id)
     {
         global_target_id_ = global_target_id;
         from_ = pose_;
-        if (global_target_id_ == 1) {to_ = eef_target1;}
-        else {to_ = eef_target2;}
+        if (global_target_id_ == 1) {eef_target1.read(to_);}
+        else {eef_target2.read(to_);}
+        from_quat_ = Eigen::Quaterniond(from_.linear());
+        to_quat_ = Eigen::Quaterniond(to_.linear());
         start_time_ = ros::Time::now();
         /**
          * Initialize slerp parameters
          */
-        geometry_msgs::Pose d_pose = kinematics::dPose_geom(to_, from_);
+        const Eigen::Isometry3d d_pose = SE3::between(to_, from_);
         // Estimate the required time due to position
-        double position_dist = sqrt(
-            d_pose.position.x*d_pose.position.x +
-            d_pose.position.y*d_pose.position.y +
-            d_pose.position.z*d_pose.position.z);
+        double position_dist = d_pose.translation().norm();
         double position_time = position_dist / linear_vel_;
         // Estimate the required time due to orientation
-        tf::Quaternion d_quat(d_pose.orientation.x, d_pose.orientation.y, d_pose.orientation.z, d_pose.orientation.w);
-        double quat_angle = d_quat.getAngleShortestPath();
+        double quat_angle = from_quat_.angularDistance(to_quat_);
         double quat_time = quat_angle / dquat_rot_vel_;
         // Maximal time
         double max_time = std::max(position_time, quat_time);
@@ -499,15 +418,249 @@ private:
 
     // Interpolation variables (position: linear, orientation: slerp)
     int global_target_id_;
-    geometry_msgs::Pose from_;
-    geometry_msgs::Pose to_;
+    Eigen::Isometry3d from_;
+    Eigen::Isometry3d to_;
+    Eigen::Quaterniond from_quat_;
+    Eigen::Quaterniond to_quat_;
     ros::Time start_time_;
     double expected_duration_;
 
     // Output
-    geometry_msgs::Pose pose_;
+    Eigen::Isometry3d pose_;
 };
 
+const int kMaxJoints = 7;
+
+// Servo statistics, published on /diagnostics
+workspace::stats::Registry servo_stats;
+const int CYCLES = servo_stats.addCounter("cycles");
+const int OVERRUNS = servo_stats.addCounter("overruns");
+const int DROPPED_SAMPLES = servo_stats.addCounter("dropped_samples");
+const int LOOP_PERIOD = servo_stats.addHistogram("loop_period");
+const int CYCLE_TIME = servo_stats.addHistogram("cycle_time");  // Compute part of the cycle, without the sleep
+
+// One servo cycle, handed from the servo thread to the publishing thread
+struct ServoSample
+{
+    ros::Time stamp;
+    double period;  // [sec] since the previous cycle
+    int num_joints;
+    std::array<double, kMaxJoints> joints;
+    std::array<double, kMaxJoints> d_theta;
+    double lambda;     // damping of the cycle
+    double sigma_min;  // smallest singular value estimate (singular_value and filtered damping)
+    Eigen::Isometry3d eef;
+    Eigen::Isometry3d target;
+};
+
+// Everything the servo thread owns after startup
+struct ServoContext
+{
+    robot_state::RobotStatePtr kinematic_state;
+    const robot_state::JointModelGroup *joint_model_group;
+    const robot_state::LinkModel *eef_link;
+    std::string eef_name;
+    LocalTarget *local_target;
+    std::vector<double> joints;
+    kinematics::DampingMode damping_mode;
+    double dls_lambda;
+    double damping_threshold;  // epsilon, or the manipulability threshold
+    bool debug;
+    double rate;  // [Hz]
+    std::atomic<bool> running;
+    std::atomic<std::size_t> dropped_samples;
+    realtime::SpscRing<ServoSample, 256> samples;
+};
+
+/**
+ * DLS servo loop for an N-joint planning group, run on its own thread at ctx.rate.
+ * The Jacobian, the damped solve and the twists are fixed-size and allocated once, before the loop.
+ * Nothing in the loop logs or publishes: each cycle is pushed to ctx.samples instead.
+ */
+template <int N>
+void servoLoop(ServoContext &ctx)
+{
+    typedef kinematics::DampedLeastSquares<N> DLS;
+    DLS dls;
+    dls.setDamping(ctx.damping_mode, ctx.dls_lambda, ctx.damping_threshold);
+    // MoveIt fills a dynamic matrix; sized once, it is overwritten in place
+    Eigen::MatrixXd jacobian(6, N);
+    typename DLS::Jacobian jacb;
+    typename DLS::Twist twist_error;  // position, rotation
+    typename DLS::Joints d_theta;
+    Eigen::Isometry3d eef_pose;
+    Eigen::Isometry3d eef_rotation = Eigen::Isometry3d::Identity();
+    ServoSample sample;
+    sample.num_joints = N;
+    workspace::stats::Recorder &recorder = servo_stats.makeRecorder();
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / ctx.rate));
+    Clock::time_point last_time = Clock::now();
+    Clock::time_point next_time = last_time + period;
+
+    while (ctx.running.load(std::memory_order_relaxed))
+    {
+        const Clock::time_point cycle_start = Clock::now();
+        const Eigen::Vector3d reference_point_position(0.0, 0.0, 0.0);
+        const bool use_quat_repr = false;
+        ctx.kinematic_state->getJacobian(
+            ctx.joint_model_group, ctx.eef_link, reference_point_position, jacobian, use_quat_repr);
+        jacb = jacobian;
+
+        // ref_pose from FK
+        kinematics::calcFK(
+            ctx.joints, ctx.kinematic_state, ctx.joint_model_group, ctx.eef_name, eef_pose);
+
+        // target_pose from LocalTarget
+        ctx.local_target->updatePose();
+        const Eigen::Isometry3d &target_pose = ctx.local_target->getPose();
+
+        // Body twist error: log of the target seen from the end-effector.
+        // The Jacobian above is the eef velocity in the planning frame, so the body twist is
+        // rotated into the planning frame (adjoint of the eef rotation, fused with the log)
+        eef_rotation.linear() = eef_pose.linear();
+        SE3::logAdjoint(SE3::between(target_pose, eef_pose), eef_rotation, twist_error);
+
+        // Damped least squares: d_theta = J+ twist_error
+        dls.solve(jacb, twist_error, d_theta);
+
+        if (ctx.debug) { debugPause(); }
+
+        // joint += d_theta
+        for (int i = 0; i < N; i++)
+        {
+            const double dmax = 1.0 * M_PI / 180.0;
+            if (d_theta[i] > dmax) {d_theta[i] = dmax;}
+            else if (d_theta[i] < -dmax) {d_theta[i] = -dmax;}
+
+            ctx.joints[i] += d_theta[i];
+        }
+        // Update the current joint state in the MoveIt
+        ctx.kinematic_state->setJointGroupPositions(ctx.joint_model_group, ctx.joints);
+
+        // Hand the cycle to the publishing thread
+        const Clock::time_point now = Clock::now();
+        sample.stamp = ros::Time::now();
+        sample.period = std::chrono::duration<double>(now - last_time).count();
+        recorder.record(LOOP_PERIOD, now - last_time);
+        recorder.count(CYCLES);
+        last_time = now;
+        for (int i = 0; i < N; i++)
+        {
+            sample.joints[i] = ctx.joints[i];
+            sample.d_theta[i] = d_theta[i];
+        }
+        sample.lambda = dls.getLambda();
+        sample.sigma_min = dls.getMinSingularValue();
+        sample.eef = eef_pose;
+        sample.target = target_pose;
+        if (!ctx.samples.push(sample))
+        {
+            ctx.dropped_samples.fetch_add(1, std::memory_order_relaxed);
+            recorder.count(DROPPED_SAMPLES);
+        }
+        recorder.record(CYCLE_TIME, Clock::now() - cycle_start);
+
+        // Absolute deadlines; after an overrun, restart from now instead of catching up
+        if (now > next_time)
+        {
+            next_time = now;
+            recorder.count(OVERRUNS);
+        }
+        std::this_thread::sleep_until(next_time);
+        next_time += period;
+    }
+}
+
+/**
+ * Lower-rate side of the servo: drains the servo samples, publishes the latest joint state and
+ * debug poses, logs the status and the loop period statistics.
+ */
+void publishLoop(
+    ServoContext &ctx,
+    sensor_msgs::JointState &current_joints,
+    const std::string &frame_id,
+    ros::Publisher &joint_state_pub,
+    ros::Publisher &eef_pub,
+    ros::Publisher &local_target_pub,
+    ros::Publisher &stats_pub,
+    double publish_rate)
+{
+    const double rad2deg = 180.0 / M_PI;
+    realtime::PeriodStats stats(1.0 / ctx.rate);
+    ros::WallTime stats_start = ros::WallTime::now();
+    geometry_msgs::PoseStamped ref_ps;
+    ref_ps.header.frame_id = frame_id;
+    geometry_msgs::PoseStamped target_ps;
+    target_ps.header.frame_id = frame_id;
+    std_msgs::Float64MultiArray stats_msg;
+    // [Hz], then [sec] except for the counts
+    stats_msg.layout.dim.resize(1);
+    stats_msg.layout.dim[0].label = "rate,period_mean,period_stddev,period_min,period_max,jitter_max,overruns,dropped";
+    stats_msg.layout.dim[0].size = 8;
+    stats_msg.layout.dim[0].stride = 8;
+    stats_msg.data.resize(8);
+
+    ServoSample sample;
+    bool has_sample = false;
+    ros::Rate rate(publish_rate);
+    while (ros::ok())
+    {
+        while (ctx.samples.pop(sample))
+        {
+            has_sample = true;
+            stats.add(sample.period);
+        }
+        if (has_sample)
+        {
+            // Set joint positions on the Rviz
+            current_joints.header.stamp = sample.stamp;
+            current_joints.position.assign(sample.joints.begin(), sample.joints.begin() + sample.num_joints);
+            joint_state_pub.publish(current_joints);
+            ref_ps.header.stamp = sample.stamp;
+            ref_ps.pose = kinematics::toPose(sample.eef);
+            eef_pub.publish(ref_ps);
+            target_ps.header.stamp = sample.stamp;
+            target_ps.pose = kinematics::toPose(sample.target);
+            local_target_pub.publish(target_ps);
+        }
+
+        // Status and statistics once per second
+        const ros::WallTime now = ros::WallTime::now();
+        if ((now - stats_start).toSec() >= 1.0 && stats.count() > 0)
+        {
+            const std::size_t dropped = ctx.dropped_samples.exchange(0);
+            stats_msg.data[0] = stats.count() / (now - stats_start).toSec();
+            stats_msg.data[1] = stats.mean();
+            stats_msg.data[2] = stats.stddev();
+            stats_msg.data[3] = stats.min();
+            stats_msg.data[4] = stats.max();
+            stats_msg.data[5] = stats.jitter();
+            stats_msg.data[6] = stats.overruns();
+            stats_msg.data[7] = dropped;
+            stats_pub.publish(stats_msg);
+
+            std::ostringstream d_theta_str;
+            std::ostringstream j_value_str;
+            for (int i = 0; i < sample.num_joints; i++)
+            {
+                d_theta_str << sample.d_theta[i] * rad2deg << "  ";
+                j_value_str << sample.joints[i] * rad2deg << "  ";
+            }
+            ROS_INFO_STREAM(" Loop is running at " << stats_msg.data[0] << " Hz"
+                << " (period " << stats.mean() * 1e3 << " +- " << stats.stddev() * 1e3
+                << " ms, jitter " << stats.jitter() * 1e3 << " ms, overruns " << stats.overruns() << ")\n" <<
+                "              lambda: " << sample.lambda << "  sigma_min: " << sample.sigma_min << "\n" <<
+                "       d_theta (deg): " << d_theta_str.str() << "\n" <<
+                "current joints (deg): " << j_value_str.str());
+            stats.reset();
+            stats_start = now;
+        }
+        rate.sleep();
+    }
+}
+
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "singularity");
@@ -520,13 +673,24 @@ int main(int argc, char **argv)
     double marker_scale;
     double dls_eps;
     double dls_lambda;
+    std::string damping_mode_name;
+    double manipulability_threshold;
     bool debug_;
     nh.param<std::string>("robot", planning_group, "puma_560");
     nh.param<double>("marker_scale", marker_scale, 0.1);
     nh.param<double>("epsilon", dls_eps, 1);
     nh.param<double>("lambda", dls_lambda, 20);
+    nh.param<std::string>("damping_mode", damping_mode_name, "constant");
+    nh.param<double>("manipulability_threshold", manipulability_threshold, 0.01);
     nh.param<bool>("debug", debug_, false);
 
+    kinematics::DampingMode damping_mode;
+    if (!kinematics::toDampingMode(damping_mode_name, damping_mode))
+    {
+        ROS_ERROR_STREAM("Unknown damping_mode " << damping_mode_name << ", use constant, singular_value, manipulability or filtered");
+        return 1;
+    }
+
     // Setup for MoveIt
     moveit::planning_interface::MoveGroupInterface move_group(planning_group);
     moveit::planning_interface::PlanningSceneInterface planning_scene_interface;
@@ -540,23 +704,21 @@ int main(int argc, char **argv)
     ROS_INFO_STREAM("Using frame_id: " << frame_id);
 
     // Initial end-effector(tool tip center) pose
-    geometry_msgs::Pose eef_pose;
+    Eigen::Isometry3d eef_transform;
     std::vector<double> initial_joints(joint_model_group->getVariableCount(), 0.0);
-    kinematics::calcFK(initial_joints, kinematic_state, joint_model_group, eef_name, eef_pose);
+    kinematics::calcFK(initial_joints, kinematic_state, joint_model_group, eef_name, eef_transform);
+    const geometry_msgs::Pose eef_pose = kinematics::toPose(eef_transform);
 
     // Round-trip pose target (rviz interactive markers)
     interactive_markers::InteractiveMarkerServer server("round_trip_targets");
     {
         // Interactive marker for the round-trip pose target
-        eef_target1 = eef_pose;
-        // eef_target1.position.x -= 0.1;
-        // eef_target1.position.y += 0.1;
+        eef_target1.write(eef_transform);
         visualization::makeRoundTripMarker(
-            server, t1_name, "Round-trip Pose Target 1", frame_id, eef_target1, marker_scale);
-        eef_target2 = eef_pose;
-        // eef_target2.position.x += 0.3;
+            server, t1_name, "Round-trip Pose Target 1", frame_id, eef_pose, marker_scale);
+        eef_target2.write(eef_transform);
         visualization::makeRoundTripMarker(
-            server, t2_name, "Round-trip Pose Target 2", frame_id, eef_target2, marker_scale);
+            server, t2_name, "Round-trip Pose Target 2", frame_id, eef_pose, marker_scale);
         is_global_initialized = true;
 
     }
@@ -580,114 +742,76 @@ int main(int argc, char **argv)
     nh.param<double>("max_linear_vel", max_linear_vel, 0.02);
     nh.param<double>("max_dquat_rot_degVel", dquat_rot_deg, 10.0);
     const double max_dquat_rot_vel = dquat_rot_deg * (M_PI / 180.0);
-    LocalTarget local_target(eef_pose, max_linear_vel, max_dquat_rot_vel);
+    LocalTarget local_target(eef_transform, max_linear_vel, max_dquat_rot_vel);
 
     ros::Publisher eef_pub =
         nh.advertise<geometry_msgs::PoseStamped>("/singularity/current_eef", 1);
     ros::Publisher local_target_pub =
         nh.advertise<geometry_msgs::PoseStamped>("/singularity/local_target", 1);
-
-    // Main Loop
-    const double rad2deg = 180.0 / M_PI;
-    ros::Time last_time = ros::Time::now();
-    double dt = 0.0;
-
-    ros::Rate rate(512);
-    while (ros::ok())
+    ros::Publisher stats_pub =
+        nh.advertise<std_msgs::Float64MultiArray>("/singularity/servo_stats", 1);
+    // [sec] between two /diagnostics messages of the servo statistics
+    double stats_period;
+    nh.param<double>("stats_period", stats_period, 1.0);
+    workspace::stats::DiagnosticsPublisher diagnostics(nh, servo_stats, "singularity servo", stats_period);
+
+    // Servo thread
+    double servo_rate;
+    int servo_priority;
+    bool lock_memory;
+    double publish_rate;
+    nh.param<double>("servo_rate", servo_rate, 512.0);
+    nh.param<int>("servo_priority", servo_priority, 80);
+    nh.param<bool>("lock_memory", lock_memory, true);
+    nh.param<double>("publish_rate", publish_rate, 30.0);
+
+    ServoContext ctx;
+    ctx.kinematic_state = kinematic_state;
+    ctx.joint_model_group = joint_model_group;
+    ctx.eef_link = eef_link;
+    ctx.eef_name = eef_name;
+    ctx.local_target = &local_target;
+    ctx.joints = initial_joints;
+    ctx.damping_mode = damping_mode;
+    ctx.dls_lambda = dls_lambda;
+    ctx.damping_threshold = damping_mode == kinematics::MANIPULABILITY ? manipulability_threshold : dls_eps;
+    ctx.debug = debug_;
+    ctx.rate = servo_rate;
+    ctx.running = true;
+    ctx.dropped_samples = 0;
+
+    // Every matrix of the loop is sized for the planning group at compile time
+    void (*servo_loop)(ServoContext &) = nullptr;
+    const int num_joints = joint_model_group->getVariableCount();
+    switch (num_joints)
     {
-        const Eigen::Vector3d reference_point_position(0.0, 0.0, 0.0);
-        const bool use_quat_repr = false;
-        Eigen::MatrixXd jacobian;
-        kinematic_state->getJacobian(
-            joint_model_group, eef_link, reference_point_position, jacobian, use_quat_repr);
-        // ROS_INFO_STREAM("Jacobian : \n" << jacobian);
-
-        // Damped pseudo-inverse
-        Eigen::MatrixXd jacb_pseudo_inv;
-        // kinematics::calculateDampedPseudoInverse_with_SVD(jacobian, jacb_pseudo_inv, dls_eps, dls_lambda);
-        kinematics::calculateDampedPseudoInverse_without_SVD(jacobian, jacb_pseudo_inv, dls_eps, dls_lambda);
-        // ROS_INFO_STREAM("Jacobian pseudo inversse : \n" << jacb_pseudo_inv);
-
-        // ref_pose from FK
-        kinematics::calcFK(
-            current_joints.position, kinematic_state, joint_model_group, eef_name, eef_pose);
-        geometry_msgs::PoseStamped ref_ps;
-        ref_ps.header.frame_id = frame_id;
-        ref_ps.header.stamp = ros::Time::now();
-        ref_ps.pose = eef_pose;
-        eef_pub.publish(ref_ps);
-
-        // target_pose from LocalTarget
-        local_target.updatePose();
-        geometry_msgs::PoseStamped target_ps;
-        target_ps.header.frame_id = frame_id;
-        target_ps.header.stamp = ros::Time::now();
-        target_ps.pose = local_target.getPose();
-        local_target_pub.publish(target_ps);
-        // ROS_INFO_STREAM("ref, target axes are published to rviz.");
-
-        // Body twist error
-        Eigen::Matrix4d error_pose = kinematics::dPose(target_ps.pose, eef_pose);
-        Eigen::VectorXd bTwist_error(6);  // position, quaternion
-        SE3::log(error_pose, bTwist_error);
-        // ROS_INFO_STREAM("Body twist error : " << bTwist_error.transpose());
-
-        // Body twist -> Spatial twist (Special thanks to @Seung Won Lee)
-        geometry_msgs::Pose origin;
-        origin.orientation.w = 1.0;
-        Eigen::Matrix4d eef_trans = kinematics::dPose(eef_pose, origin);
-        Eigen::MatrixXd adjoint;
-        SE3::adjoint(eef_trans, adjoint);
-        // ROS_INFO_STREAM("adjoint: \n" << adjoint);
-
-        // Spatial twist error
-        Eigen::VectorXd sTwist_error = adjoint * bTwist_error;
-        // ROS_INFO_STREAM("Spatial twist error : " << sTwist_error.transpose());
-
-        Eigen::VectorXd d_theta = jacb_pseudo_inv * sTwist_error;
-        // ROS_INFO_STREAM("d_theta : " << d_theta.transpose());
-
-        /////////////////////////////////
-        // Double-check
-        // Eigen::VectorXd _debug_d_error = jacobian * d_theta;
-        // ROS_WARN_STREAM("debug d_error : " << _debug_d_error.transpose());
-        if (debug_) { debugPause(); }
-        /////////////////////////////////
-
-        // joint += d_theta
-        for (int i = 0; i < current_joints.position.size(); i++)
-        {
-            const double dmax = 1.0 * M_PI / 180.0;
-            if (d_theta[i] > dmax) {d_theta[i] = dmax;}
-            else if (d_theta[i] < -dmax) {d_theta[i] = -dmax;}
-
-            current_joints.position[i] += d_theta[i];
-        }
+    case 2: servo_loop = &servoLoop<2>; break;
+    case 3: servo_loop = &servoLoop<3>; break;
+    case 4: servo_loop = &servoLoop<4>; break;
+    case 5: servo_loop = &servoLoop<5>; break;
+    case 6: servo_loop = &servoLoop<6>; break;
+    case 7: servo_loop = &servoLoop<7>; break;
+    default:
+        ROS_ERROR_STREAM("Planning group " << planning_group << " has " << num_joints << " joints, only 2 to " << kMaxJoints << " are supported");
+        return 1;
+    }
 
-        // Set joint positions on the Rviz
-        joint_state_pub.publish(current_joints);
-        // Update the current joint state in the MoveIt
-        kinematic_state->setJointGroupPositions(joint_model_group, current_joints.position);
+    std::string error;
+    if (lock_memory && !realtime::lockMemory(error))
+    {
+        ROS_WARN_STREAM("mlockall failed (" << error << "), the servo loop may page-fault. Raise `ulimit -l`.");
+    }
+    std::thread servo_thread(servo_loop, std::ref(ctx));
+    if (servo_priority > 0 && !realtime::setFifoPriority(servo_thread, servo_priority, error))
+    {
+        ROS_WARN_STREAM("SCHED_FIFO " << servo_priority << " failed (" << error << "), the servo runs at normal priority. Raise `ulimit -r`.");
+    }
 
-        ros::Time now = ros::Time::now();
-        dt = (now - last_time).toSec();
-        last_time = now;
+    // Logging and visualization on the main thread
+    publishLoop(ctx, current_joints, frame_id, joint_state_pub, eef_pub, local_target_pub, stats_pub, publish_rate);
 
-        // Print status
-        {
-            std::string j_value_str;
-            for (int i = 0; i < current_joints.position.size(); i++)
-            {
-                j_value_str += std::to_string(current_joints.position[i] * rad2deg) + "  ";
-            }
-            d_theta *= rad2deg;
-            ROS_INFO_STREAM(" Loop is running at " << 1.0 / dt << " Hz\n" <<
-                "       d_theta (deg): " << d_theta.transpose() << "\n" <<
-                "current joints (deg): " << j_value_str);
-        }
-        ros::spinOnce();
-        rate.sleep();
-    }
+    ctx.running = false;
+    servo_thread.join();
     ros::waitForShutdown();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "kinematics_demo/trajectory_fk.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <tf2_eigen/tf2_eigen.h>
+
+namespace kinematics
+{
+    namespace
+    {
+        // Fewer points than this per thread are not worth a thread
+        const std::size_t kMinPointsPerThread = 256;
+
+        void assignPose(const Eigen::Isometry3d &T, geometry_msgs::Pose &pose) { pose = Eigen::toMsg(T); }
+        void assignPose(const Eigen::Isometry3d &T, Eigen::Isometry3d &pose) { pose = T; }
+    }
+
+    TrajectoryFK::TrajectoryFK()
+        : tool_(Eigen::Isometry3d::Identity()), num_threads_(1)
+    {
+    }
+
+    bool TrajectoryFK::init(
+        const robot_state::RobotState &state,
+        const robot_model::JointModelGroup *joint_model_group,
+        const std::string &eef_link,
+        std::string &error)
+    {
+        segments_.clear();
+        eef_link_ = eef_link.empty() ? joint_model_group->getLinkModelNames().back() : eef_link;
+        variable_names_ = joint_model_group->getVariableNames();
+        state.copyJointGroupPositions(joint_model_group, reference_values_);
+
+        const robot_model::LinkModel *eef = state.getLinkModel(eef_link_);
+        if (eef == nullptr)
+        {
+            error = "end effector [ " + eef_link_ + " ] is not a link of the model";
+            return false;
+        }
+        std::vector<const robot_model::LinkModel *> chain;
+        for (const robot_model::LinkModel *link = eef; link != nullptr; link = link->getParentLinkModel())
+        {
+            chain.push_back(link);
+        }
+        std::reverse(chain.begin(), chain.end());
+
+        // From the root: fold everything but the moving joints of the group
+        Eigen::Isometry3d fixed = Eigen::Isometry3d::Identity();
+        for (const robot_model::LinkModel *link : chain)
+        {
+            const robot_model::JointModel *jm = link->getParentJointModel();
+            fixed = fixed * link->getJointOriginTransform();
+            if (!joint_model_group->hasJointModel(jm->getName()) || jm->getVariableCount() == 0)
+            {
+                Eigen::Isometry3d joint_transform;
+                jm->computeTransform(state.getJointPositions(jm), joint_transform);
+                fixed = fixed * joint_transform;
+                continue;
+            }
+
+            Segment segment;
+            if (jm->getMimic() != nullptr)
+            {
+                error = "joint [ " + jm->getName() + " ] is a mimic joint";
+                return false;
+            }
+            if (jm->getType() == robot_model::JointModel::REVOLUTE)
+            {
+                segment.axis = static_cast<const robot_model::RevoluteJointModel*>(jm)->getAxis();
+                segment.prismatic = false;
+            }
+            else if (jm->getType() == robot_model::JointModel::PRISMATIC)
+            {
+                segment.axis = static_cast<const robot_model::PrismaticJointModel*>(jm)->getAxis();
+                segment.prismatic = true;
+            }
+            else
+            {
+                error = "joint [ " + jm->getName() + " ] is neither revolute nor prismatic";
+                return false;
+            }
+            segment.fixed = fixed;
+            segment.variable = joint_model_group->getVariableGroupIndex(jm->getName());
+            segments_.push_back(segment);
+            fixed = Eigen::Isometry3d::Identity();
+        }
+        tool_ = fixed;
+        return true;
+    }
+
+    void TrajectoryFK::compute(const double *values, Eigen::Isometry3d &pose, Jacobian *jacobian) const
+    {
+        if (jacobian != nullptr)
+        {
+            jacobian->setZero(6, variable_names_.size());
+        }
+        Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+        for (const Segment &segment : segments_)
+        {
+            T = T * segment.fixed;
+            if (jacobian != nullptr)
+            {
+                // (joint origin, joint axis) for now, turned into (v, w) once the eef is known
+                jacobian->col(segment.variable).head<3>() = T.translation();
+                jacobian->col(segment.variable).tail<3>() = T.linear() * segment.axis;
+            }
+            const double q = values[segment.variable];
+            if (segment.prismatic)
+            {
+                T.translation() += T.linear() * (q * segment.axis);
+            }
+            else
+            {
+                T.linear() = T.linear() * Eigen::AngleAxisd(q, segment.axis).toRotationMatrix();
+            }
+        }
+        pose = T * tool_;
+
+        if (jacobian != nullptr)
+        {
+            for (const Segment &segment : segments_)
+            {
+                auto column = jacobian->col(segment.variable);
+                const Eigen::Vector3d axis = column.tail<3>();
+                if (segment.prismatic)
+                {
+                    column.head<3>() = axis;
+                    column.tail<3>().setZero();
+                }
+                else
+                {
+                    column.head<3>() = axis.cross(pose.translation() - column.head<3>());
+                }
+            }
+        }
+    }
+
+    Eigen::Isometry3d TrajectoryFK::computePose(const std::vector<double> &group_values, Jacobian *jacobian) const
+    {
+        Eigen::Isometry3d pose;
+        compute(group_values.data(), pose, jacobian);
+        return pose;
+    }
+
+    template <typename Pose>
+    bool TrajectoryFK::convertPoints(
+        const trajectory_msgs::JointTrajectory &trajectory,
+        std::vector<Pose> &path,
+        std::vector<Jacobian> *jacobians) const
+    {
+        // Trajectory column of every group variable, -1: keep the reference value
+        std::vector<int> columns(variable_names_.size(), -1);
+        std::size_t num_columns = variable_names_.size();
+        if (trajectory.joint_names.empty())
+        {
+            for (std::size_t v = 0; v < columns.size(); v++) { columns[v] = v; }
+        }
+        else
+        {
+            num_columns = trajectory.joint_names.size();
+            for (std::size_t v = 0; v < columns.size(); v++)
+            {
+                const auto it = std::find(trajectory.joint_names.begin(), trajectory.joint_names.end(), variable_names_[v]);
+                if (it != trajectory.joint_names.end()) { columns[v] = it - trajectory.joint_names.begin(); }
+            }
+        }
+        const std::size_t n = trajectory.points.size();
+        for (const trajectory_msgs::JointTrajectoryPoint &point : trajectory.points)
+        {
+            if (point.positions.size() < num_columns) { return false; }
+        }
+
+        path.resize(n);
+        if (jacobians != nullptr) { jacobians->resize(n); }
+        auto convertRange = [&](std::size_t begin, std::size_t end)
+        {
+            std::vector<double> values = reference_values_;
+            Eigen::Isometry3d pose;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                const std::vector<double> &positions = trajectory.points[i].positions;
+                for (std::size_t v = 0; v < columns.size(); v++)
+                {
+                    if (columns[v] >= 0) { values[v] = positions[columns[v]]; }
+                }
+                compute(values.data(), pose, jacobians != nullptr ? &(*jacobians)[i] : nullptr);
+                assignPose(pose, path[i]);
+            }
+        };
+
+        const std::size_t num_threads = std::min<std::size_t>(num_threads_, n / kMinPointsPerThread);
+        if (num_threads <= 1)
+        {
+            convertRange(0, n);
+            return true;
+        }
+        // Contiguous chunks, the last one on this thread
+        std::vector<std::thread> workers;
+        const std::size_t chunk = (n + num_threads - 1) / num_threads;
+        for (std::size_t t = 0; t + 1 < num_threads; t++)
+        {
+            workers.emplace_back(convertRange, t * chunk, (t + 1) * chunk);
+        }
+        convertRange((num_threads - 1) * chunk, n);
+        for (std::thread &worker : workers) { worker.join(); }
+        return true;
+    }
+
+    bool TrajectoryFK::convert(
+        const trajectory_msgs::JointTrajectory &trajectory,
+        std::vector<geometry_msgs::Pose> &path,
+        std::vector<Jacobian> *jacobians) const
+    {
+        return convertPoints(trajectory, path, jacobians);
+    }
+
+    bool TrajectoryFK::convert(
+        const trajectory_msgs::JointTrajectory &trajectory,
+        std::vector<Eigen::Isometry3d> &path,
+        std::vector<Jacobian> *jacobians) const
+    {
+        return convertPoints(trajectory, path, jacobians);
+    }
+}
@@ -0,0 +1,379 @@
+/**
+ * Microbenchmarks (Google Benchmark) of the kinematics math and the traj_plan interpolators.
+ *
+ * Besides the wall time of the library, every benchmark reports `cycles` per call, read
+ * from the TSC (steady_clock nanoseconds where there is no TSC).
+ *
+ * [ Run ]
+ * `rosrun kinematics_demo kinematics_benchmark --benchmark_format=json`
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <benchmark/benchmark.h>
+#include "kinematics_demo/so3.hpp"
+#include "kinematics_demo/se3.hpp"
+#include "kinematics_demo/dls.hpp"
+#include "traj_plan/interpolation.hpp"
+#include "workspace/octree.hpp"
+#include "workspace/reachability_cache.hpp"
+
+namespace
+{
+    inline uint64_t readTSC()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // Cycles of the timed loop (from `start`) averaged over its iterations
+    void reportCycles(benchmark::State &state, const uint64_t start)
+    {
+        state.counters["cycles"] = benchmark::Counter((double)(readTSC() - start), benchmark::Counter::kAvgIterations);
+    }
+
+    // Inputs are cycled through so the compiler cannot hoist a constant call out of the loop
+    const std::size_t kNumInputs = 256;
+
+    std::vector<SE3::Vector6d, Eigen::aligned_allocator<SE3::Vector6d>> randomTwists()
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        std::vector<SE3::Vector6d, Eigen::aligned_allocator<SE3::Vector6d>> twists(kNumInputs);
+        for (SE3::Vector6d &twist : twists)
+        {
+            for (int i = 0; i < 6; i++) { twist(i) = M_PI / 2 * uniform(rng); }
+        }
+        return twists;
+    }
+
+    std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d>> randomPoses()
+    {
+        std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d>> poses;
+        for (const SE3::Vector6d &twist : randomTwists())
+        {
+            Eigen::Isometry3d T;
+            SE3::exp(twist, T);
+            poses.push_back(T);
+        }
+        return poses;
+    }
+
+    Eigen::MatrixXd randomJacobian(int rows, int cols)
+    {
+        std::srand(42);
+        return Eigen::MatrixXd::Random(rows, cols);
+    }
+}
+
+// ===== SO3 / SE3 =====
+void BM_SO3_exp(benchmark::State &state)
+{
+    const auto twists = randomTwists();
+    Eigen::Matrix3d R;
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        SO3::exp(twists[i++ % kNumInputs].tail<3>(), R);
+        benchmark::DoNotOptimize(R);
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SO3_exp);
+
+void BM_SO3_log(benchmark::State &state)
+{
+    const auto poses = randomPoses();
+    Eigen::Vector3d w;
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        SO3::log(poses[i++ % kNumInputs].linear(), w);
+        benchmark::DoNotOptimize(w);
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SO3_log);
+
+void BM_SE3_exp(benchmark::State &state)
+{
+    const auto twists = randomTwists();
+    Eigen::Isometry3d T;
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        SE3::exp(twists[i++ % kNumInputs], T);
+        benchmark::DoNotOptimize(T);
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SE3_exp);
+
+void BM_SE3_log(benchmark::State &state)
+{
+    const auto poses = randomPoses();
+    SE3::Vector6d twist;
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        SE3::log(poses[i++ % kNumInputs], twist);
+        benchmark::DoNotOptimize(twist);
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SE3_log);
+
+void BM_SE3_adjoint(benchmark::State &state)
+{
+    const auto poses = randomPoses();
+    SE3::Matrix6d adj;
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        SE3::adjoint(poses[i++ % kNumInputs], adj);
+        benchmark::DoNotOptimize(adj);
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SE3_adjoint);
+
+// ===== Damped pseudo-inverse =====
+// Args: Jacobian rows, columns (joints)
+void BM_DampedPseudoInverse_without_SVD(benchmark::State &state)
+{
+    const Eigen::MatrixXd jacb = randomJacobian(state.range(0), state.range(1));
+    Eigen::MatrixXd jacb_pseudo_inv;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        kinematics::calculateDampedPseudoInverse_without_SVD(jacb, jacb_pseudo_inv, 0.01, 0.01);
+        benchmark::DoNotOptimize(jacb_pseudo_inv.data());
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_DampedPseudoInverse_without_SVD)->Args({6, 3})->Args({6, 6})->Args({6, 7});
+
+void BM_DampedPseudoInverse_with_SVD(benchmark::State &state)
+{
+    const Eigen::MatrixXd jacb = randomJacobian(state.range(0), state.range(1));
+    Eigen::MatrixXd jacb_pseudo_inv;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        kinematics::calculateDampedPseudoInverse_with_SVD(jacb, jacb_pseudo_inv, 0.01, 0.01);
+        benchmark::DoNotOptimize(jacb_pseudo_inv.data());
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_DampedPseudoInverse_with_SVD)->Args({6, 3})->Args({6, 6})->Args({6, 7});
+
+// The fixed-size solver of the singularity demo, for comparison
+void BM_DampedLeastSquares6(benchmark::State &state)
+{
+    typedef kinematics::DampedLeastSquares<6> DLS;
+    const DLS::Jacobian jacb = randomJacobian(6, 6);
+    DLS dls;
+    DLS::PseudoInverse jacb_pseudo_inv;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        dls.pseudoInverse(jacb, 0.01, jacb_pseudo_inv);
+        benchmark::DoNotOptimize(jacb_pseudo_inv.data());
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_DampedLeastSquares6);
+
+// ===== traj_plan interpolators =====
+namespace
+{
+    const int kNumChannels = 6;  // Joints of the PUMA 560
+
+    void makeWaypoints(int num_waypoints, std::vector<float> &x, traj_plan::Interpolater::Samples &y)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        x.resize(num_waypoints);
+        y.resize(kNumChannels, num_waypoints);
+        for (int i = 0; i < num_waypoints; i++)
+        {
+            x[i] = (float)i;
+            for (int c = 0; c < kNumChannels; c++) { y(c, i) = uniform(rng); }
+        }
+    }
+}
+
+// Arg: waypoints
+void BM_SplineInterpolater_Setup(benchmark::State &state)
+{
+    std::vector<float> x;
+    traj_plan::Interpolater::Samples y;
+    makeWaypoints(state.range(0), x, y);
+    traj_plan::SplineInterpolater spline;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        spline.Setup(x, y);
+        benchmark::ClobberMemory();
+    }
+    reportCycles(state, start);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SplineInterpolater_Setup)->RangeMultiplier(4)->Range(4, 4096)->Complexity(benchmark::oN);
+
+// Random access (binary search of the segment)
+void BM_SplineInterpolater_Interpolate(benchmark::State &state)
+{
+    std::vector<float> x;
+    traj_plan::Interpolater::Samples y;
+    makeWaypoints(state.range(0), x, y);
+    traj_plan::SplineInterpolater spline;
+    spline.Setup(x, y);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uniform(x.front(), x.back());
+    std::vector<float> queries(kNumInputs);
+    for (float &q : queries) { q = uniform(rng); }
+    traj_plan::Interpolater::Values out(kNumChannels);
+    std::size_t i = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        spline.Interpolate(queries[i++ % kNumInputs], out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SplineInterpolater_Interpolate)->RangeMultiplier(4)->Range(4, 4096);
+
+// Sequential access (cursor), as when a trajectory is resampled
+void BM_SplineInterpolater_InterpolateCursor(benchmark::State &state)
+{
+    std::vector<float> x;
+    traj_plan::Interpolater::Samples y;
+    makeWaypoints(state.range(0), x, y);
+    traj_plan::SplineInterpolater spline;
+    spline.Setup(x, y);
+    const int num_samples = 100 * (int)x.size();
+    const float step = (x.back() - x.front()) / num_samples;
+    traj_plan::Interpolater::Values out(kNumChannels);
+    std::size_t cursor = 0;
+    int s = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        if (s == num_samples) { s = 0; cursor = 0; }
+        spline.Interpolate(x.front() + step * s++, cursor, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    reportCycles(state, start);
+}
+BENCHMARK(BM_SplineInterpolater_InterpolateCursor)->RangeMultiplier(4)->Range(4, 4096);
+
+// ===== Octree::Cube::split =====
+namespace
+{
+    // Mocked IK: the spherical shell 0.2 m <= |p| <= 0.8 m is reachable
+    struct ShellIK
+    {
+        bool operator()(const Octree::Index &probe)
+        {
+            calls++;
+            const double r = resolution * std::sqrt((double)probe.i * probe.i + (double)probe.j * probe.j + (double)probe.k * probe.k);
+            return r >= 0.2 && r <= 0.8;
+        }
+
+        double resolution;
+        std::size_t calls;
+    };
+
+    const int kOctreeDepth = 4;
+    const double kDfsResolution = 0.08;
+
+    // A level-0 cube across the outer surface of the shell
+    Octree::Cube makeBoundaryCube(ShellIK &ik)
+    {
+        const int scale = 1 << kOctreeDepth;
+        Octree::Cube cube;
+        cube.init(Octree::Index{9 * scale, 0, 0}, 0, kOctreeDepth, ik);
+        return cube;
+    }
+}
+
+// Cold: every one of the 19 probes calls the mocked IK
+void BM_OctreeCube_split(benchmark::State &state)
+{
+    ShellIK ik{kDfsResolution / (1 << kOctreeDepth), 0};
+    const Octree::Cube parent = makeBoundaryCube(ik);
+    std::vector<Octree::Cube> openlist(Octree::openlistSize(kOctreeDepth));
+    ik.calls = 0;
+    const uint64_t start = readTSC();
+    for (auto _ : state)
+    {
+        int top = 0;
+        openlist[top] = parent;
+        top--;
+        openlist[0].split(openlist, top, kOctreeDepth, ik);
+        benchmark::DoNotOptimize(openlist.data());
+    }
+    reportCycles(state, start);
+    state.counters["ik_calls"] = benchmark::Counter((double)ik.calls, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_OctreeCube_split);
+
+// Through the ReachabilityCache, Arg(1): warm (every probe is a hit), Arg(0): cleared every call
+void BM_OctreeCube_split_cached(benchmark::State &state)
+{
+    const bool warm = state.range(0) != 0;
+    const double resolution = kDfsResolution / (1 << kOctreeDepth);
+    // Probes of the cube only
+    const int scale = 1 << kOctreeDepth;
+    geometry_msgs::Point origin;
+    const workspace::Lattice lattice(origin, resolution, Octree::Index{9 * scale, 0, 0},
+                                     Octree::Index{10 * scale, scale, scale});
+    std::unique_ptr<workspace::ReachabilityCache> cache(new workspace::ReachabilityCache(lattice));
+    ShellIK ik{resolution, 0};
+    auto check = [&](const Octree::Index &probe)
+    {
+        return cache->check(probe, [&]() { return ik(probe); });
+    };
+    const Octree::Cube parent = makeBoundaryCube(ik);
+    std::vector<Octree::Cube> openlist(Octree::openlistSize(kOctreeDepth));
+    ik.calls = 0;
+    uint64_t cycles = 0;
+    for (auto _ : state)
+    {
+        if (!warm)
+        {
+            state.PauseTiming();
+            cache.reset(new workspace::ReachabilityCache(lattice));
+            state.ResumeTiming();
+        }
+        const uint64_t start = readTSC();
+        int top = 0;
+        openlist[top] = parent;
+        top--;
+        openlist[0].split(openlist, top, kOctreeDepth, check);
+        benchmark::DoNotOptimize(openlist.data());
+        cycles += readTSC() - start;
+    }
+    state.counters["cycles"] = benchmark::Counter((double)cycles, benchmark::Counter::kAvgIterations);
+    state.counters["ik_calls"] = benchmark::Counter((double)ik.calls, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_OctreeCube_split_cached)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
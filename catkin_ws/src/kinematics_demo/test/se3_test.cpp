@@ -4,8 +4,6 @@
 // Bring in gtest
 #include <gtest/gtest.h>
 #include <cstdlib>
-#include <tf2_eigen/tf2_eigen.h>
-#include <tf/tf.h>
 
 double randRad()
 {
@@ -15,8 +13,6 @@ double randRad()
 // Declare a test
 TEST(TestSuite, testCase1)
 {
-    tf2::Quaternion q;
-
     // for (int i = 0; i < 100; i++)
     // {
     //     q.setRPY(randRad(), randRad(), randRad());
@@ -31,6 +27,58 @@ TEST(TestSuite, testCase1)
     // <test things here, calling EXPECT_* and/or ASSERT_* macros as needed>
 }
 
+Eigen::Isometry3d randomIsometry()
+{
+    Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+    T.rotate(Eigen::AngleAxisd(randRad(), Eigen::Vector3d::Random().normalized()));
+    T.pretranslate(Eigen::Vector3d::Random());
+    return T;
+}
+
+TEST(TestSuite, expLogRoundTrip)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        const Eigen::Isometry3d T = randomIsometry();
+        SE3::Vector6d se3;
+        SE3::log(T, se3);
+        Eigen::Isometry3d T_exp;
+        SE3::exp(se3, T_exp);
+        EXPECT_TRUE(T.isApprox(T_exp, 1e-9));
+    }
+}
+
+TEST(TestSuite, inverseAndBetween)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        const Eigen::Isometry3d T = randomIsometry();
+        const Eigen::Isometry3d U = randomIsometry();
+        EXPECT_TRUE(SE3::inverse(T).isApprox(T.inverse(), 1e-12));
+        EXPECT_TRUE(SE3::between(U, T).isApprox(T.inverse() * U, 1e-12));
+    }
+}
+
+// T exp(V) T^-1 == exp(Ad_T V)
+TEST(TestSuite, adjoint)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        const Eigen::Isometry3d T = randomIsometry();
+        const SE3::Vector6d V = 0.3 * SE3::Vector6d::Random();
+        SE3::Matrix6d adj;
+        SE3::adjoint(T, adj);
+        Eigen::Isometry3d lhs, rhs;
+        SE3::exp(V, lhs);
+        SE3::exp(adj * V, rhs);
+        EXPECT_TRUE((T * lhs * T.inverse()).isApprox(rhs, 1e-9));
+
+        SE3::Vector6d adj_V;
+        SE3::adjoint(T, V, adj_V);
+        EXPECT_TRUE(adj_V.isApprox(adj * V, 1e-12));
+    }
+}
+
 // Declare another test
 // TEST(TestSuite, testCase2)
 // {
@@ -40,7 +88,5 @@ TEST(TestSuite, testCase1)
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
-  ros::init(argc, argv, "tester");
-  ros::NodeHandle nh;
   return RUN_ALL_TESTS();
 }
\ No newline at end of file
@@ -4,12 +4,6 @@
 // Bring in gtest
 #include <gtest/gtest.h>
 #include <cstdlib>
-// #include <geometry_msgs/Pose.h>
-// #include <geometry_msgs/Quaternion.h>
-#include <tf2/convert.h>
-#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
-#include <tf2_eigen/tf2_eigen.h>
-#include <tf/tf.h>
 
 double randRad()
 {
@@ -19,13 +13,12 @@ double randRad()
 // Declare a test
 TEST(TestSuite, testCase1)
 {
-    tf2::Quaternion q;
-
     for (int i = 0; i < 100; i++)
     {
-        q.setRPY(randRad(), randRad(), randRad());
-        Eigen::Matrix3d R;
-        tf2::convert(q, R);
+        // Fixed-axis roll, pitch, yaw (as tf2::Quaternion::setRPY)
+        const Eigen::Matrix3d R = (Eigen::AngleAxisd(randRad(), Eigen::Vector3d::UnitZ()) *
+                                   Eigen::AngleAxisd(randRad(), Eigen::Vector3d::UnitY()) *
+                                   Eigen::AngleAxisd(randRad(), Eigen::Vector3d::UnitX())).toRotationMatrix();
         Eigen::Vector3d so3;
         SO3::log(R, so3);
         Eigen::Matrix3d R_exp;
@@ -35,16 +28,37 @@ TEST(TestSuite, testCase1)
     // <test things here, calling EXPECT_* and/or ASSERT_* macros as needed>
 }
 
-// Declare another test
-// TEST(TestSuite, testCase2)
-// {
-// <test things here, calling EXPECT_* and/or ASSERT_* macros as needed>
-// }
+// hat(w) v == w x v
+TEST(TestSuite, hatIsCrossProduct)
+{
+    const Eigen::Vector3d w(0.3, -1.2, 0.7);
+    const Eigen::Vector3d v(-0.5, 0.1, 2.0);
+    Eigen::Matrix3d w_hat;
+    SO3::hat(w, w_hat);
+    EXPECT_TRUE((w_hat * v).isApprox(w.cross(v), 1e-12));
+    Eigen::Vector3d w_vee;
+    SO3::vee(w_hat, w_vee);
+    EXPECT_TRUE(w_vee.isApprox(w, 1e-12));
+}
+
+// log inverts exp near the singular angles 0 and pi
+TEST(TestSuite, logNearZeroAndPi)
+{
+    const Eigen::Vector3d axis = Eigen::Vector3d(1.0, 2.0, -0.5).normalized();
+    const double angles[] = {1e-9, 1e-4, 1.0, M_PI - 1e-4, M_PI - 1e-9};
+    for (double th : angles)
+    {
+        Eigen::Matrix3d R;
+        SO3::exp(th * axis, R);
+        EXPECT_TRUE(R.isApprox(Eigen::AngleAxisd(th, axis).toRotationMatrix(), 1e-12));
+        Eigen::Vector3d so3;
+        SO3::log(R, so3);
+        EXPECT_NEAR((so3 - th * axis).norm(), 0.0, 1e-9);
+    }
+}
 
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
-  ros::init(argc, argv, "tester");
-  ros::NodeHandle nh;
   return RUN_ALL_TESTS();
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <moveit_msgs/CollisionObject.h>
 #include <moveit_visual_tools/moveit_visual_tools.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <workspace/reachability_query.hpp>
 
 namespace rvt = rviz_visual_tools;
 
@@ -84,16 +85,29 @@ waypoints.push_back(target_pose4);
 for (auto waypoint : waypoints) { visual_tools.publishAxis(waypoint.pose); }
 visual_tools.trigger();
 
+// Optional: reject waypoints outside a precomputed reachability map (workspace/reachable_ws_ik)
+// before asking the planner, which would otherwise spend its whole IK timeout on them.
+std::string reachability_map;
+nh.param<std::string>("reachability_map", reachability_map, "");
+workspace::ReachabilityQuery reachability;
+if (!reachability_map.empty() && !reachability.open(reachability_map)) {
+    ROS_WARN_NAMED("tutorial", "Cannot open the reachability map: %s", reachability_map.c_str());
+}
+
 int i = 0;
 int direction = -1;
 while (ros::ok()) {
     ROS_INFO_NAMED("tutorial", "Waypoint %d", i);
-    move_group.setPoseTarget(waypoints[i]);
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    bool success = (move_group.plan(my_plan) == moveit::planning_interface::MoveItErrorCode::SUCCESS);
-    ROS_INFO_NAMED("tutorial", "Visualizing plan (pose goal) %s", success ? "true" : "false");
-    ROS_INFO_NAMED("tutorial", "Planning time: %.2f sec", my_plan.planning_time_);
-    move_group.execute(my_plan);
+    if (reachability.isOpen() && !reachability.isReachable(waypoints[i].pose.position)) {
+        ROS_WARN_NAMED("tutorial", "Waypoint %d is outside the reachable workspace, skipped", i);
+    } else {
+        move_group.setPoseTarget(waypoints[i]);
+        moveit::planning_interface::MoveGroupInterface::Plan my_plan;
+        bool success = (move_group.plan(my_plan) == moveit::planning_interface::MoveItErrorCode::SUCCESS);
+        ROS_INFO_NAMED("tutorial", "Visualizing plan (pose goal) %s", success ? "true" : "false");
+        ROS_INFO_NAMED("tutorial", "Planning time: %.2f sec", my_plan.planning_time_);
+        move_group.execute(my_plan);
+    }
 
     if (i == 3 || i == 0) {
         direction *= -1;
@@ -0,0 +1,301 @@
+/**
+ * Multi-channel linear and natural cubic spline interpolation.
+ */
+#ifndef TRAJ_PLAN_INTERPOLATION_HPP
+#define TRAJ_PLAN_INTERPOLATION_HPP
+
+#include <vector>
+#include <algorithm>
+#include <Eigen/Core>
+
+namespace traj_plan
+{
+    /**
+     * Index i of the segment [knots[i], knots[i + 1]] that holds x, i.e. knots[i] < x <= knots[i + 1].
+     * Out-of-range x extrapolates the first or the last segment.
+     */
+    inline size_t findSegment(const std::vector<float> &knots, float x)
+    {
+        if (knots.size() < 3) return 0;
+        auto it = std::lower_bound(knots.begin() + 1, knots.end() - 1, x);
+        return (it - knots.begin()) - 1;
+    }
+
+    /**
+     * Same as findSegment, starting from the segment `hint` of the previous query.
+     * O(1) amortized when x does not decrease between calls, binary search otherwise.
+     */
+    inline size_t advanceSegment(const std::vector<float> &knots, float x, size_t hint)
+    {
+        if (hint + 1 >= knots.size() || (hint > 0 && !(knots[hint] < x))) return findSegment(knots, x);
+        while (hint + 2 < knots.size() && knots[hint + 1] < x) hint++;
+        return hint;
+    }
+
+    /**
+     * Multi-channel interpolation over a shared curve parameter.
+     * Samples are a channels x knots matrix (one column per knot, channels contiguous),
+     * so every operation on a knot runs over all channels at once.
+     */
+    class Interpolater
+    {
+    public:
+        typedef Eigen::Array<float, Eigen::Dynamic, Eigen::Dynamic> Samples;
+        typedef Eigen::Array<float, Eigen::Dynamic, 1> Values;
+
+        Interpolater() {}
+        virtual ~Interpolater() {}
+        // Random access, O(log n)
+        virtual void Interpolate(float x, Values &out) = 0;
+        // Sequential access: `cursor` keeps the segment between calls (start with 0)
+        virtual void Interpolate(float x, size_t &cursor, Values &out) = 0;
+        // Buffers are kept between calls, so a Setup of the same size does not allocate
+        virtual void Setup(const std::vector<float> &x, const Samples &y) = 0;
+    };
+
+    class LinearInterpolater : public Interpolater
+    {
+    public:
+        LinearInterpolater() : Interpolater() {}
+        ~LinearInterpolater() {}
+        virtual void Interpolate(float x, Values &out)
+        {
+            Evaluate(findSegment(x_, x), x, out);
+        };
+        virtual void Interpolate(float x, size_t &cursor, Values &out)
+        {
+            cursor = advanceSegment(x_, x, cursor);
+            Evaluate(cursor, x, out);
+        };
+        virtual void Setup(const std::vector<float> &x, const Samples &y)
+        {
+            x_ = x;
+            y_ = y;
+        };
+
+    private:
+        void Evaluate(size_t i, float x, Values &out) const
+        {
+            out = y_.col(i) + (y_.col(i + 1) - y_.col(i)) * ((x - x_[i]) / (x_[i + 1] - x_[i]));
+        }
+
+        std::vector<float> x_;
+        Samples y_;
+    };
+
+    class SplineInterpolater : public Interpolater
+    {
+    public:
+        SplineInterpolater() : Interpolater() {}
+        ~SplineInterpolater() {}
+
+        virtual void Interpolate(float x, Values &out)
+        {
+            Evaluate(findSegment(knots_, x), x, out);
+        }
+
+        virtual void Interpolate(float x, size_t &cursor, Values &out)
+        {
+            cursor = advanceSegment(knots_, x, cursor);
+            Evaluate(cursor, x, out);
+        }
+
+        // Value with its first and second derivative in x
+        void Interpolate(float x, size_t &cursor, Values &out, Values &d1, Values &d2)
+        {
+            cursor = advanceSegment(knots_, x, cursor);
+            Evaluate(cursor, x, out);
+            const float tt = x - knots_[cursor];
+            d1 = b_.col(cursor) + tt * (2.0f * c_.col(cursor) + (3.0f * tt) * d_.col(cursor));
+            d2 = 2.0f * c_.col(cursor) + (6.0f * tt) * d_.col(cursor);
+        }
+
+        virtual void Setup(const std::vector<float> &x, const Samples &y)
+        {
+            // realization of the algorithm from https://en.wikipedia.org/wiki/Spline_(mathematics)
+            // Natural spline. The tridiagonal factorization (h, l, mu) depends on x only,
+            // so it is computed once and shared by all channels.
+            size_t n = x.size() - 1;
+            knots_ = x;
+            h_.resize(n);
+            l_.resize(n + 1);
+            mu_.resize(n + 1);
+            a_ = y;
+            b_.resize(y.rows(), n);
+            c_.resize(y.rows(), n + 1);
+            d_.resize(y.rows(), n);
+            z_.resize(y.rows(), n + 1);
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                h_[i] = x[i + 1] - x[i];
+            }
+            l_[0] = 1;
+            mu_[0] = 0;
+            z_.col(0).setZero();
+            for (size_t i = 1; i < n; ++i)
+            {
+                l_[i] = 2.0f * (x[i + 1] - x[i - 1]) - h_[i - 1] * mu_[i - 1];
+                mu_[i] = h_[i] / l_[i];
+                // alpha = (3 / h[i]) * (a[i + 1] - a[i]) - (3 / h[i - 1]) * (a[i] - a[i - 1])
+                z_.col(i) = ((3.0f / h_[i]) * (a_.col(i + 1) - a_.col(i)) - (3.0f / h_[i - 1]) * (a_.col(i) - a_.col(i - 1))
+                             - h_[i - 1] * z_.col(i - 1)) / l_[i];
+            }
+            l_[n] = 1;
+            z_.col(n).setZero();
+            c_.col(n).setZero();
+            for (int i = n - 1; i >= 0; --i)
+            {
+                c_.col(i) = z_.col(i) - mu_[i] * c_.col(i + 1);
+                b_.col(i) = (a_.col(i + 1) - a_.col(i)) / h_[i] - h_[i] * (c_.col(i + 1) + 2 * c_.col(i)) / 3.0f;
+                d_.col(i) = (c_.col(i + 1) - c_.col(i)) / (3.0f * h_[i]);
+            }
+        }
+
+    private:
+        void Evaluate(size_t i, float x, Values &out) const
+        {
+            const float tt = x - knots_[i];
+            out = a_.col(i) + tt * (b_.col(i) + tt * (c_.col(i) + tt * d_.col(i)));
+        }
+
+        std::vector<float> knots_;
+        std::vector<float> h_;
+        std::vector<float> l_;
+        std::vector<float> mu_;
+        // Coefficients, channels x knots
+        Samples a_;
+        Samples b_;
+        Samples c_;
+        Samples d_;
+        Samples z_;
+    };
+
+    /**
+     * Natural spline that grows one knot at a time, for waypoints that arrive online.
+     *
+     * The forward sweep of the tridiagonal solve is exact and only adds one row per knot.
+     * The back-substitution restarts from the new natural end but runs over the last
+     * `window` knots only: a change of c at the end decays by mu (about 2 - sqrt(3)) per knot,
+     * so older segments are frozen and never recomputed. Each Append costs O(window) instead
+     * of O(history), and segments [0, getFrozen()) never change again.
+     */
+    class IncrementalSplineInterpolater
+    {
+    public:
+        typedef Interpolater::Samples Samples;
+        typedef Interpolater::Values Values;
+
+        IncrementalSplineInterpolater() : frozen_(0) {}
+
+        void Reset(int channels)
+        {
+            knots_.clear();
+            h_.clear();
+            l_.clear();
+            mu_.clear();
+            frozen_ = 0;
+            if (a_.rows() != channels)
+            {
+                a_.resize(channels, 0);
+                b_.resize(channels, 0);
+                c_.resize(channels, 0);
+                d_.resize(channels, 0);
+                z_.resize(channels, 0);
+            }
+        }
+
+        // x must be larger than the last knot
+        void Append(float x, const Values &y, size_t window)
+        {
+            const size_t n = knots_.size();
+            reserve(n + 1);
+            knots_.push_back(x);
+            a_.col(n) = y;
+            if (n == 0)
+            {
+                l_.push_back(1);
+                mu_.push_back(0);
+                z_.col(0).setZero();
+                // A single knot evaluates to itself
+                b_.col(0).setZero();
+                c_.col(0).setZero();
+                d_.col(0).setZero();
+                return;
+            }
+            h_.push_back(x - knots_[n - 1]);
+            if (n >= 2)
+            {
+                // Row n - 1 was the natural end, now it is an interior row
+                const size_t i = n - 1;
+                l_[i] = 2.0f * (knots_[i + 1] - knots_[i - 1]) - h_[i - 1] * mu_[i - 1];
+                mu_[i] = h_[i] / l_[i];
+                z_.col(i) = ((3.0f / h_[i]) * (a_.col(i + 1) - a_.col(i)) - (3.0f / h_[i - 1]) * (a_.col(i) - a_.col(i - 1))
+                             - h_[i - 1] * z_.col(i - 1)) / l_[i];
+            }
+            // Natural end at the new knot
+            l_.push_back(1);
+            mu_.push_back(0);
+            z_.col(n).setZero();
+            c_.col(n).setZero();
+
+            const size_t lo = n > window ? n - window : 0;
+            for (size_t i = n; i-- > lo;)
+            {
+                c_.col(i) = z_.col(i) - mu_[i] * c_.col(i + 1);
+            }
+            // Segment lo - 1 takes the last update of c[lo] and is frozen from now on
+            for (size_t i = lo > 0 ? lo - 1 : 0; i < n; ++i)
+            {
+                b_.col(i) = (a_.col(i + 1) - a_.col(i)) / h_[i] - h_[i] * (c_.col(i + 1) + 2 * c_.col(i)) / 3.0f;
+                d_.col(i) = (c_.col(i + 1) - c_.col(i)) / (3.0f * h_[i]);
+            }
+            frozen_ = lo;
+        }
+
+        // The tail is already solved exactly for the current knots; freeze it too
+        void Finish() { frozen_ = getNumSegments(); }
+
+        size_t getNumKnots() const { return knots_.size(); }
+        size_t getNumSegments() const { return knots_.empty() ? 0 : knots_.size() - 1; }
+        size_t getFrozen() const { return frozen_; }
+        float getKnot(size_t i) const { return knots_[i]; }
+
+        // Evaluate segment i at x
+        void Interpolate(size_t i, float x, Values &out) const
+        {
+            const float tt = x - knots_[i];
+            out = a_.col(i) + tt * (b_.col(i) + tt * (c_.col(i) + tt * d_.col(i)));
+        }
+
+    private:
+        // Grow the coefficient columns geometrically, so appending is amortized O(1)
+        void reserve(size_t knots)
+        {
+            if ((Eigen::Index)knots <= a_.cols())
+            {
+                return;
+            }
+            const Eigen::Index cols = std::max<Eigen::Index>(16, 2 * a_.cols());
+            a_.conservativeResize(Eigen::NoChange, cols);
+            b_.conservativeResize(Eigen::NoChange, cols);
+            c_.conservativeResize(Eigen::NoChange, cols);
+            d_.conservativeResize(Eigen::NoChange, cols);
+            z_.conservativeResize(Eigen::NoChange, cols);
+        }
+
+        std::vector<float> knots_;
+        std::vector<float> h_;
+        std::vector<float> l_;
+        std::vector<float> mu_;
+        size_t frozen_;
+        // Coefficients, channels x capacity
+        Samples a_;
+        Samples b_;
+        Samples c_;
+        Samples d_;
+        Samples z_;
+    };
+}
+
+#endif // TRAJ_PLAN_INTERPOLATION_HPP
@@ -0,0 +1,354 @@
+/**
+ * Time-optimal parameterization of the joint spline against velocity and acceleration limits.
+ */
+#ifndef TRAJ_PLAN_TIME_OPTIMAL_HPP
+#define TRAJ_PLAN_TIME_OPTIMAL_HPP
+
+#include <map>
+#include <limits>
+#include <cmath>
+#include "traj_plan/trajectory_planner.hpp"
+
+namespace traj_plan
+{
+    /**
+     * Path velocity profile s(t) along q(s), for |dq/dt| <= v and |d2q/dt2| <= a per channel.
+     *
+     * The path is sampled on a grid of step ds. With x = (ds/dt)^2 the joint constraints are
+     * linear in (x, s''): |q' s'' + q'' x| <= a, q'^2 x <= v^2. Each grid point gets the largest
+     * feasible x (maximum velocity curve), then a forward pass at maximum s'' from x = 0 and a
+     * backward pass at minimum s'' into x = 0 give the bang-bang profile under that curve.
+     */
+    class TimeOptimalParameterization
+    {
+    public:
+        typedef Interpolater::Values Values;
+
+        /**
+         * `path` is set up over [0, s_end]. The grid holds `steps_per_unit` steps per unit of s,
+         * so integer s (the waypoints) fall on grid points.
+         */
+        void Compute(SplineInterpolater &path, float s_end, int steps_per_unit, const Values &max_vel, const Values &max_acc)
+        {
+            const size_t n = std::max(1, (int)std::ceil(s_end * steps_per_unit)) + 1;
+            ds_ = s_end / (n - 1);
+            d1_.resize(max_vel.size(), n);
+            d2_.resize(max_vel.size(), n);
+            x_.resize(n);
+            time_.resize(n);
+
+            // Maximum velocity curve
+            size_t cursor = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                path.Interpolate(i * ds_, cursor, q_, d1_col_, d2_col_);
+                d1_.col(i) = d1_col_;
+                d2_.col(i) = d2_col_;
+                x_[i] = maxVelocityCurve(i, max_vel, max_acc);
+            }
+
+            // Forward pass, start at rest.
+            // Each step keeps the s'' of the interval inside the bounds of both of its ends.
+            x_[0] = 0;
+            for (size_t i = 0; i + 1 < n; ++i)
+            {
+                const float x_next = std::min(x_[i] + 2 * ds_ * maxAcceleration(i, x_[i], max_acc), maxReachable(i + 1, x_[i], max_acc));
+                x_[i + 1] = std::min(x_[i + 1], std::max(0.0f, x_next));
+            }
+            // Backward pass, stop at rest
+            x_[n - 1] = 0;
+            for (size_t i = n - 1; i > 0; --i)
+            {
+                const float x_prev = std::min(x_[i] - 2 * ds_ * minAcceleration(i, x_[i], max_acc), maxReachable(i - 1, x_[i], max_acc, -1));
+                x_[i - 1] = std::min(x_[i - 1], std::max(0.0f, x_prev));
+            }
+
+            // Constant s'' between grid points: dt = 2 ds / (sqrt(x0) + sqrt(x1))
+            time_[0] = 0;
+            for (size_t i = 0; i + 1 < n; ++i)
+            {
+                const float denom = std::max(std::sqrt(x_[i]) + std::sqrt(x_[i + 1]), 1e-6f);
+                time_[i + 1] = time_[i] + 2 * ds_ / denom;
+            }
+        }
+
+        float getDuration() const { return time_.back(); }
+        float getStep() const { return ds_; }
+        // Time at grid point i
+        float getTime(size_t i) const { return time_[i]; }
+
+        /**
+         * Path parameter and its derivatives at time t in [0, getDuration()].
+         * `cursor` is the grid interval and only moves forward (start with 0).
+         */
+        void Sample(float t, size_t &cursor, float &s, float &sdot, float &sddot) const
+        {
+            while (cursor + 2 < time_.size() && time_[cursor + 1] < t)
+            {
+                cursor++;
+            }
+            const float tau = std::min(std::max(t - time_[cursor], 0.0f), time_[cursor + 1] - time_[cursor]);
+            const float sdot0 = std::sqrt(x_[cursor]);
+            sddot = (x_[cursor + 1] - x_[cursor]) / (2 * ds_);
+            s = cursor * ds_ + sdot0 * tau + 0.5f * sddot * tau * tau;
+            sdot = sdot0 + sddot * tau;
+        }
+
+    private:
+        // Largest x at grid point i with a feasible s'' and no joint over its velocity limit
+        float maxVelocityCurve(size_t i, const Values &max_vel, const Values &max_acc) const
+        {
+            const float eps = 1e-6f;
+            float x_max = std::numeric_limits<float>::max();
+            for (int j = 0; j < max_vel.size(); ++j)
+            {
+                const float d1 = std::abs(d1_(j, i));
+                if (d1 > eps)
+                {
+                    x_max = std::min(x_max, (max_vel[j] / d1) * (max_vel[j] / d1));
+                }
+                else if (std::abs(d2_(j, i)) > eps)
+                {
+                    // q' = 0: |q'' x| <= a on its own
+                    x_max = std::min(x_max, max_acc[j] / std::abs(d2_(j, i)));
+                }
+            }
+            // Joint j's lower bound of s'' stays under joint k's upper bound:
+            // -a_j/|q'_j| - (q''_j/q'_j) x <= a_k/|q'_k| - (q''_k/q'_k) x
+            for (int j = 0; j < max_vel.size(); ++j)
+            {
+                if (std::abs(d1_(j, i)) <= eps)
+                {
+                    continue;
+                }
+                for (int k = 0; k < max_vel.size(); ++k)
+                {
+                    if (k == j || std::abs(d1_(k, i)) <= eps)
+                    {
+                        continue;
+                    }
+                    const float coef = d2_(k, i) / d1_(k, i) - d2_(j, i) / d1_(j, i);
+                    if (coef > eps)
+                    {
+                        x_max = std::min(x_max, (max_acc[k] / std::abs(d1_(k, i)) + max_acc[j] / std::abs(d1_(j, i))) / coef);
+                    }
+                }
+            }
+            return x_max;
+        }
+
+        /**
+         * Largest x at grid point i that is reached from x_from at the previous point (dir = +1)
+         * or reaches x_from at the next point (dir = -1) with the s'' of the interval between
+         * the bounds evaluated at point i itself:
+         * x (1 + dir 2 ds q''/q') <= x_from + 2 ds a/|q'| for every joint.
+         */
+        float maxReachable(size_t i, float x_from, const Values &max_acc, int dir = 1) const
+        {
+            float x_max = std::numeric_limits<float>::max();
+            for (int j = 0; j < max_acc.size(); ++j)
+            {
+                const float d1 = d1_(j, i);
+                if (std::abs(d1) > 1e-6f)
+                {
+                    const float gain = 1 + dir * 2 * ds_ * d2_(j, i) / d1;
+                    if (gain > 0)
+                    {
+                        x_max = std::min(x_max, (x_from + 2 * ds_ * max_acc[j] / std::abs(d1)) / gain);
+                    }
+                }
+            }
+            return x_max;
+        }
+
+        float maxAcceleration(size_t i, float x, const Values &max_acc) const
+        {
+            float s_max = std::numeric_limits<float>::max();
+            for (int j = 0; j < max_acc.size(); ++j)
+            {
+                const float d1 = d1_(j, i);
+                if (std::abs(d1) > 1e-6f)
+                {
+                    s_max = std::min(s_max, max_acc[j] / std::abs(d1) - d2_(j, i) * x / d1);
+                }
+            }
+            return s_max;
+        }
+
+        float minAcceleration(size_t i, float x, const Values &max_acc) const
+        {
+            float s_min = -std::numeric_limits<float>::max();
+            for (int j = 0; j < max_acc.size(); ++j)
+            {
+                const float d1 = d1_(j, i);
+                if (std::abs(d1) > 1e-6f)
+                {
+                    s_min = std::max(s_min, -max_acc[j] / std::abs(d1) - d2_(j, i) * x / d1);
+                }
+            }
+            return s_min;
+        }
+
+        float ds_;
+        // q'(s) and q''(s) on the grid, channels x grid points
+        Interpolater::Samples d1_;
+        Interpolater::Samples d2_;
+        Values q_;
+        Values d1_col_;
+        Values d2_col_;
+        // (ds/dt)^2 and t on the grid
+        std::vector<float> x_;
+        std::vector<float> time_;
+    };
+
+    /**
+     * Third planner mode next to linear and spline: the joint waypoints are joined by the
+     * natural spline over the waypoint index, then timed as fast as the joint limits allow.
+     *
+     * Limits come from `joint_limits_ns`/<joint>/{has_velocity_limits, max_velocity,
+     * has_acceleration_limits, max_acceleration} (the moveit_config joint_limits.yaml),
+     * falling back to `default_max_velocity` and `default_max_acceleration`.
+     * Pose waypoints are resampled like the spline mode.
+     */
+    class TimeOptimalTrajectoryPlanner : public TrajectoryPlanner<SplineInterpolater>
+    {
+    public:
+        typedef Interpolater::Values Values;
+
+        void Init(ros::NodeHandle &nh, float time_period)
+        {
+            TrajectoryPlanner<SplineInterpolater>::Init(nh, time_period);
+            nh_ = nh;
+            nh.param<std::string>("joint_limits_ns", joint_limits_ns_, "/robot_description_planning/joint_limits");
+            nh.param<double>("default_max_velocity", default_max_velocity_, 1.0);
+            nh.param<double>("default_max_acceleration", default_max_acceleration_, 2.0);
+            nh.param<int>("steps_per_waypoint", steps_per_waypoint_, 100);
+        }
+
+        virtual void calcJointTrajectory(const trajectory_msgs::JointTrajectory &req, trajectory_msgs::JointTrajectory &res)
+        {
+            const size_t num_joints = req.joint_names.size();
+            if (req.points.size() < 2)
+            {
+                res = req;
+                return;
+            }
+            setupJointInterpolation(req);
+            max_vel_.resize(num_joints);
+            max_acc_.resize(num_joints);
+            for (size_t j = 0; j < num_joints; ++j)
+            {
+                const Limit &limit = getLimit(req.joint_names[j]);
+                max_vel_[j] = limit.max_velocity;
+                max_acc_[j] = limit.max_acceleration;
+            }
+            profile_.Compute(interpolator_, curve_param_.back(), steps_per_waypoint_, max_vel_, max_acc_);
+
+            // set a new message
+            res.header = req.header;
+            res.joint_names = req.joint_names;
+            res.points.clear();
+            const float duration = profile_.getDuration();
+            res.points.reserve((size_t)(duration / time_period_) + req.points.size() + 1);
+
+            // Resampled at k * time_period_, with the waypoints inserted at their own time; a sample
+            // within eps of the previous one is dropped so that time_from_start strictly increases
+            const float eps = 1e-3f * time_period_;
+            size_t profile_cursor = 0;
+            size_t path_cursor = 0;
+            float last = -1;
+            // Adds t unless it is too close to the previous sample or to the last one at duration
+            auto addSample = [&](const float t) {
+                if (t <= last + eps || t >= duration - eps) { return; }
+                addPoint(req, t, profile_cursor, path_cursor, res);
+                last = t;
+            };
+            // The first and the last waypoint are the samples at 0 and duration
+            size_t next_waypoint = 1;
+            for (size_t k = 0; k * time_period_ < duration; ++k)
+            {
+                const float t = k * time_period_;
+                while (next_waypoint + 1 < req.points.size()
+                       && profile_.getTime(next_waypoint * steps_per_waypoint_) <= t + eps)
+                {
+                    addSample(profile_.getTime(next_waypoint * steps_per_waypoint_));
+                    next_waypoint++;
+                }
+                addSample(t);
+            }
+            while (next_waypoint + 1 < req.points.size())
+            {
+                addSample(profile_.getTime(next_waypoint * steps_per_waypoint_));
+                next_waypoint++;
+            }
+            addPoint(req, duration, profile_cursor, path_cursor, res);
+            ROS_DEBUG_STREAM("Time-optimal trajectory: " << duration << " [s], " << res.points.size() << " points");
+        }
+
+    private:
+        struct Limit
+        {
+            float max_velocity;
+            float max_acceleration;
+        };
+
+        // Limits of a joint, read once from the parameter server
+        const Limit &getLimit(const std::string &joint)
+        {
+            std::map<std::string, Limit>::iterator it = limits_.find(joint);
+            if (it != limits_.end())
+            {
+                return it->second;
+            }
+            const std::string prefix = joint_limits_ns_ + "/" + joint + "/";
+            bool has_limits = false;
+            double value = 0;
+            Limit limit = {(float)default_max_velocity_, (float)default_max_acceleration_};
+            if (nh_.getParam(prefix + "has_velocity_limits", has_limits) && has_limits
+                && nh_.getParam(prefix + "max_velocity", value) && value > 0)
+            {
+                limit.max_velocity = value;
+            }
+            has_limits = false;
+            if (nh_.getParam(prefix + "has_acceleration_limits", has_limits) && has_limits
+                && nh_.getParam(prefix + "max_acceleration", value) && value > 0)
+            {
+                limit.max_acceleration = value;
+            }
+            ROS_INFO_STREAM(joint << " limits: velocity " << limit.max_velocity << ", acceleration " << limit.max_acceleration);
+            return limits_.insert(std::make_pair(joint, limit)).first->second;
+        }
+
+        void addPoint(const trajectory_msgs::JointTrajectory &req, float t, size_t &profile_cursor, size_t &path_cursor,
+                      trajectory_msgs::JointTrajectory &res)
+        {
+            float s, sdot, sddot;
+            profile_.Sample(t, profile_cursor, s, sdot, sddot);
+            interpolator_.Interpolate(s, path_cursor, values_, d1_, d2_);
+            // dq/dt = q' s', d2q/dt2 = q'' s'^2 + q' s''
+            d2_ = d2_ * (sdot * sdot) + d1_ * sddot;
+            d1_ *= sdot;
+            res.points.emplace_back();
+            trajectory_msgs::JointTrajectoryPoint &point = res.points.back();
+            point.positions.assign(values_.data(), values_.data() + values_.size());
+            point.velocities.assign(d1_.data(), d1_.data() + d1_.size());
+            point.accelerations.assign(d2_.data(), d2_.data() + d2_.size());
+            point.time_from_start = ros::Duration(t) + req.points.front().time_from_start;
+        }
+
+        ros::NodeHandle nh_;
+        std::string joint_limits_ns_;
+        double default_max_velocity_;
+        double default_max_acceleration_;
+        int steps_per_waypoint_;
+        std::map<std::string, Limit> limits_;
+
+        TimeOptimalParameterization profile_;
+        Values max_vel_;
+        Values max_acc_;
+        Values d1_;
+        Values d2_;
+    };
+}
+
+#endif // TRAJ_PLAN_TIME_OPTIMAL_HPP
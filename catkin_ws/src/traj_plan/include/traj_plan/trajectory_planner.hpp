@@ -0,0 +1,401 @@
+/**
+ * Resampling of joint and pose waypoints, shared by the traj_plan node and nodelet.
+ */
+#ifndef TRAJ_PLAN_TRAJECTORY_PLANNER_HPP
+#define TRAJ_PLAN_TRAJECTORY_PLANNER_HPP
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <traj_plan/PoseStampedArray.h>
+#include <traj_plan/JointInterpolation.h>
+#include <cmath>
+#include "traj_plan/interpolation.hpp"
+
+namespace traj_plan
+{
+    /**
+     * Topic and service front end of an interpolator.
+     * The interpolator and its buffers are members, so callbacks must not run concurrently:
+     * use a single-threaded spinner, or the nodelet's private (single-threaded) queue.
+     */
+    template <typename InterpolatorType>
+    class TrajectoryPlanner
+    {
+    public:
+        TrajectoryPlanner() {}
+        virtual ~TrajectoryPlanner() {}
+
+        void Init(ros::NodeHandle &nh, float time_period)
+        {
+            time_period_ = time_period;
+
+            // Topic version
+            pub_traj_ = nh.advertise<trajectory_msgs::JointTrajectory>("joint_trajectory", 3, false);
+            pub_pose_ = nh.advertise<traj_plan::PoseStampedArray>("pose_trajectory", 3, false);
+            sub_traj_ = nh.subscribe("joint_waypoints", 3, &TrajectoryPlanner::JointTrajectoryCallback, this);
+            sub_pose_ = nh.subscribe("pose_waypoints", 3, &TrajectoryPlanner::PoseStampedCallback, this);
+
+            // Service version
+            joint_traj_service_ = nh.advertiseService("joint_trajectory_service", &TrajectoryPlanner::JointTrajectoryService, this);
+
+            // Streaming version, always spline-interpolated (stream_window > 0 enables it)
+            nh.param<int>("stream_window", stream_window_, 0);
+            if (stream_window_ > 0)
+            {
+                pub_traj_stream_ = nh.advertise<trajectory_msgs::JointTrajectory>("joint_trajectory_stream", 10, false);
+                pub_pose_stream_ = nh.advertise<traj_plan::PoseStampedArray>("pose_trajectory_stream", 10, false);
+                sub_traj_stream_ = nh.subscribe("joint_waypoint_stream", 10, &TrajectoryPlanner::JointWaypointStreamCallback, this);
+                sub_pose_stream_ = nh.subscribe("pose_waypoint_stream", 10, &TrajectoryPlanner::PoseWaypointStreamCallback, this);
+            }
+        }
+
+        /**
+         * Append the points of `msg` to the current joint stream and publish the segments that became final.
+         * Points are parameterized by their index in the stream, like calcJointTrajectory.
+         * An empty message (or new joint names) ends the stream and publishes the rest of it.
+         */
+        void JointWaypointStreamCallback(const trajectory_msgs::JointTrajectory::ConstPtr &msg)
+        {
+            if (msg->points.empty() || msg->joint_names != joint_stream_names_)
+            {
+                trajectory_msgs::JointTrajectory::Ptr rest = boost::make_shared<trajectory_msgs::JointTrajectory>();
+                rest->header = msg->header;
+                rest->joint_names = joint_stream_names_;
+                joint_stream_.Finish();
+                appendJointStream(*rest, true);
+                if (!rest->points.empty())
+                {
+                    pub_traj_stream_.publish(rest);
+                }
+                joint_stream_.Reset(msg->joint_names.size());
+                joint_stream_names_ = msg->joint_names;
+            }
+
+            trajectory_msgs::JointTrajectory::Ptr new_msg = boost::make_shared<trajectory_msgs::JointTrajectory>();
+            if (!msg->points.empty())
+            {
+                if (joint_stream_.getNumKnots() == 0)
+                {
+                    joint_stream_start_ = msg->points.front().time_from_start;
+                    joint_stream_published_ = 0;
+                }
+                for (const trajectory_msgs::JointTrajectoryPoint &point : msg->points)
+                {
+                    if (point.positions.size() != joint_stream_names_.size())
+                    {
+                        ROS_WARN_STREAM("Dropping joint waypoint with " << point.positions.size() << " positions for "
+                                        << joint_stream_names_.size() << " joints");
+                        continue;
+                    }
+                    stream_values_.resize(point.positions.size());
+                    for (size_t j = 0; j < point.positions.size(); ++j)
+                    {
+                        stream_values_[j] = point.positions[j];
+                    }
+                    joint_stream_.Append(joint_stream_.getNumKnots(), stream_values_, stream_window_);
+                }
+                new_msg->header = msg->header;
+                new_msg->joint_names = joint_stream_names_;
+                appendJointStream(*new_msg, false);
+            }
+            if (!new_msg->points.empty())
+            {
+                pub_traj_stream_.publish(new_msg);
+            }
+        }
+
+        // Same for poses, parameterized by their stamps like PoseStampedCallback
+        void PoseWaypointStreamCallback(const traj_plan::PoseStampedArray::ConstPtr &msg)
+        {
+            traj_plan::PoseStampedArray::Ptr new_msg = boost::make_shared<traj_plan::PoseStampedArray>();
+            if (msg->data.empty())
+            {
+                pose_stream_.Finish();
+                appendPoseStream(*new_msg, true);
+                pose_stream_.Reset(7);
+            }
+            else if (pose_stream_.getNumKnots() == 0)
+            {
+                pose_stream_.Reset(7);
+                pose_stream_start_ = msg->data.front().header.stamp.toSec();
+                pose_stream_published_ = 0;
+            }
+            for (const geometry_msgs::PoseStamped &point : msg->data)
+            {
+                const float x = point.header.stamp.toSec() - pose_stream_start_;
+                if (pose_stream_.getNumKnots() > 0 && x <= pose_stream_.getKnot(pose_stream_.getNumKnots() - 1))
+                {
+                    ROS_WARN_STREAM("Dropping pose waypoint that is not newer than the last one");
+                    continue;
+                }
+                stream_values_.resize(7);
+                stream_values_ << point.pose.position.x, point.pose.position.y, point.pose.position.z,
+                    point.pose.orientation.w, point.pose.orientation.x, point.pose.orientation.y, point.pose.orientation.z;
+                pose_stream_.Append(x, stream_values_, stream_window_);
+            }
+            if (!msg->data.empty())
+            {
+                appendPoseStream(*new_msg, false);
+            }
+            if (!new_msg->data.empty())
+            {
+                pub_pose_stream_.publish(new_msg);
+            }
+        }
+        void PoseStampedCallback(const traj_plan::PoseStampedArray::ConstPtr &msg)
+        {
+            traj_plan::PoseStampedArray::Ptr new_msg = boost::make_shared<traj_plan::PoseStampedArray>();
+            calcPoseTrajectory(*msg, *new_msg);
+            // Published as a shared pointer, so intra-process subscribers get it without a copy
+            pub_pose_.publish(new_msg);
+        }
+        void JointTrajectoryCallback(const trajectory_msgs::JointTrajectory::ConstPtr &msg)
+        {
+            if (!hasAllPositions(*msg)) { return; }
+            trajectory_msgs::JointTrajectory::Ptr new_msg = boost::make_shared<trajectory_msgs::JointTrajectory>();
+            calcJointTrajectory(*msg, *new_msg);
+            pub_traj_.publish(new_msg);
+        }
+
+        bool JointTrajectoryService(traj_plan::JointInterpolationRequest &req, traj_plan::JointInterpolationResponse &res)
+        {
+            if (!hasAllPositions(req.waypoints)) { return false; }
+            calcJointTrajectory(req.waypoints, res.result);
+            return true;
+        }
+
+        // False (with a warning) if a waypoint has no position for some joint, or one too many
+        static bool hasAllPositions(const trajectory_msgs::JointTrajectory &traj)
+        {
+            for (size_t k = 0; k < traj.points.size(); ++k)
+            {
+                if (traj.points[k].positions.size() != traj.joint_names.size())
+                {
+                    ROS_WARN_STREAM("Rejecting joint waypoints: point " << k << " has " << traj.points[k].positions.size()
+                                    << " positions for " << traj.joint_names.size() << " joints");
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void calcPoseTrajectory(const traj_plan::PoseStampedArray &req, traj_plan::PoseStampedArray &res)
+        {
+            // make one sample column per waypoint, channels { x, y, z, qw, qx, qy, qz }.
+            const double start = req.data.front().header.stamp.toSec();
+            samples_.resize(7, req.data.size());
+            curve_param_.resize(req.data.size());
+            for (size_t k = 0; k < req.data.size(); ++k)
+            {
+                const geometry_msgs::Pose &pose = req.data[k].pose;
+                samples_.col(k) << pose.position.x, pose.position.y, pose.position.z,
+                    pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z;
+                curve_param_[k] = req.data[k].header.stamp.toSec() - start;
+            }
+
+            // Setup interpolater
+            interpolator_.Setup(curve_param_, samples_);
+
+            // set a new message
+            res.data.clear();
+            res.data.reserve(maxOutputSize(req.data.size()));
+
+            float prev_t = -1;
+            size_t cursor = 0;
+            auto it_points = req.data.begin();
+            for (float t = curve_param_.front() + time_period_; t < curve_param_.back(); t += time_period_)
+            {
+
+                if ((it_points->header.stamp.toSec() - start) > prev_t && (it_points->header.stamp.toSec() - start) < t)
+                {
+                    res.data.push_back(*it_points);
+                    it_points++;
+                }
+                interpolator_.Interpolate(t, cursor, values_);
+                res.data.emplace_back();
+                geometry_msgs::PoseStamped &point = res.data.back();
+                point.pose.position.x = values_[0];
+                point.pose.position.y = values_[1];
+                point.pose.position.z = values_[2];
+                const float abs = values_.tail<4>().matrix().norm();
+                point.pose.orientation.w = values_[3] / abs;
+                point.pose.orientation.x = values_[4] / abs;
+                point.pose.orientation.y = values_[5] / abs;
+                point.pose.orientation.z = values_[6] / abs;
+                point.header.stamp = ros::Time(t + start);
+                prev_t = t;
+            }
+
+            res.data.push_back(req.data.back());
+        }
+
+        virtual void calcJointTrajectory(const trajectory_msgs::JointTrajectory &req, trajectory_msgs::JointTrajectory &res)
+        {
+            const size_t num_joints = req.joint_names.size();
+            setupJointInterpolation(req);
+
+            // set a new message
+            res.header = req.header;
+            res.joint_names = req.joint_names;
+            res.points.clear();
+            res.points.reserve(maxOutputSize(req.points.size()));
+
+            float prev_t = -1;
+            size_t cursor = 0;
+            auto it_points = req.points.begin();
+            for (float t = curve_param_.front() + time_period_; t < curve_param_.back(); t += time_period_)
+            {
+
+                if (it_points->time_from_start.toSec() > prev_t && it_points->time_from_start.toSec() < t)
+                {
+                    res.points.push_back(*it_points);
+                    it_points++;
+                }
+
+                interpolator_.Interpolate(t, cursor, values_);
+                res.points.emplace_back();
+                trajectory_msgs::JointTrajectoryPoint &point = res.points.back();
+                point.positions.assign(values_.data(), values_.data() + num_joints);
+                point.time_from_start = ros::Duration(t) + req.points.front().time_from_start;
+
+                prev_t = t;
+            }
+            res.points.push_back(req.points.back());
+        }
+
+    protected:
+        /**
+         * Resample the stream segments frozen since the last call on the global grid t = m * time_period_,
+         * so consecutive messages continue each other. `last` also adds the final knot.
+         */
+        template <typename Point, typename MakePoint>
+        void resampleFrozen(const IncrementalSplineInterpolater &stream, size_t &published, bool last,
+                            std::vector<Point> &out, MakePoint make_point)
+        {
+            if (stream.getNumKnots() == 0)
+            {
+                return;
+            }
+            const size_t frozen = stream.getFrozen();
+            for (; published < frozen; ++published)
+            {
+                const float x0 = stream.getKnot(published);
+                const float x1 = stream.getKnot(published + 1);
+                for (long m = (long)std::ceil(x0 / time_period_); m * time_period_ < x1; ++m)
+                {
+                    const float t = m * time_period_;
+                    stream.Interpolate(published, t, stream_values_);
+                    out.push_back(make_point(t, stream_values_));
+                }
+            }
+            if (last)
+            {
+                const size_t end = stream.getNumKnots() - 1;
+                const float t = stream.getKnot(end);
+                stream.Interpolate(end > 0 ? end - 1 : 0, t, stream_values_);
+                out.push_back(make_point(t, stream_values_));
+            }
+        }
+
+        void appendJointStream(trajectory_msgs::JointTrajectory &res, bool last)
+        {
+            const ros::Duration start = joint_stream_start_;
+            resampleFrozen(joint_stream_, joint_stream_published_, last, res.points,
+                           [start](float t, const Interpolater::Values &values) {
+                               trajectory_msgs::JointTrajectoryPoint point;
+                               point.positions.assign(values.data(), values.data() + values.size());
+                               point.time_from_start = ros::Duration(t) + start;
+                               return point;
+                           });
+        }
+
+        void appendPoseStream(traj_plan::PoseStampedArray &res, bool last)
+        {
+            const double start = pose_stream_start_;
+            resampleFrozen(pose_stream_, pose_stream_published_, last, res.data,
+                           [start](float t, const Interpolater::Values &values) {
+                               geometry_msgs::PoseStamped point;
+                               point.pose.position.x = values[0];
+                               point.pose.position.y = values[1];
+                               point.pose.position.z = values[2];
+                               const float abs = values.tail<4>().matrix().norm();
+                               point.pose.orientation.w = values[3] / abs;
+                               point.pose.orientation.x = values[4] / abs;
+                               point.pose.orientation.y = values[5] / abs;
+                               point.pose.orientation.z = values[6] / abs;
+                               point.header.stamp = ros::Time(t + start);
+                               return point;
+                           });
+        }
+
+        // Interpolate the joint positions of `req` over the waypoint index
+        void setupJointInterpolation(const trajectory_msgs::JointTrajectory &req)
+        {
+            // make one sample column per waypoint, one row per joint.
+            samples_.resize(req.joint_names.size(), req.points.size());
+            curve_param_.resize(req.points.size());
+            for (size_t k = 0; k < req.points.size(); ++k)
+            {
+                const std::vector<double> &positions = req.points[k].positions;
+                for (size_t j = 0; j < positions.size(); ++j)
+                {
+                    samples_(j, k) = positions[j];
+                }
+                curve_param_[k] = k;
+            }
+
+            // Setup interpolater
+            interpolator_.Setup(curve_param_, samples_);
+        }
+
+        /**
+         * Upper bound of the output length for the current curve_param_:
+         * every resampled step, plus at most one passed-through waypoint per step, plus the last waypoint.
+         * Counted with the same float stepping as the resampling loops.
+         */
+        size_t maxOutputSize(size_t num_waypoints) const
+        {
+            size_t steps = 0;
+            for (float t = curve_param_.front() + time_period_; t < curve_param_.back(); t += time_period_)
+            {
+                steps++;
+            }
+            return steps + std::min(steps, num_waypoints) + 1;
+        }
+
+        float time_period_;
+
+        // Reused between calls, so a trajectory of the same shape does not allocate
+        InterpolatorType interpolator_;
+        Interpolater::Samples samples_;
+        Interpolater::Values values_;
+        std::vector<float> curve_param_;
+
+        // Topic version
+        ros::Publisher pub_traj_;
+        ros::Publisher pub_pose_;
+        ros::Subscriber sub_traj_;
+        ros::Subscriber sub_pose_;
+
+        // Service version
+        ros::ServiceServer joint_traj_service_;
+
+        // Streaming version
+        int stream_window_;
+        IncrementalSplineInterpolater joint_stream_;
+        std::vector<std::string> joint_stream_names_;
+        ros::Duration joint_stream_start_;
+        size_t joint_stream_published_ = 0;
+        IncrementalSplineInterpolater pose_stream_;
+        double pose_stream_start_ = 0;
+        size_t pose_stream_published_ = 0;
+        Interpolater::Values stream_values_;
+        ros::Publisher pub_traj_stream_;
+        ros::Publisher pub_pose_stream_;
+        ros::Subscriber sub_traj_stream_;
+        ros::Subscriber sub_pose_stream_;
+    };
+}
+
+#endif // TRAJ_PLAN_TRAJECTORY_PLANNER_HPP
@@ -0,0 +1,44 @@
+/**
+ * traj_plan_nodelet.cpp
+ *
+ * Same topics and services as the traj_plan node, loaded into a nodelet manager.
+ * Consumers in the same manager that publish `joint_waypoints` and subscribe
+ * `joint_trajectory` exchange shared pointers without serialization.
+ * (Services are always serialized by roscpp, even inside one manager.)
+ *
+ * `roslaunch traj_plan nodelet.launch`
+ */
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "traj_plan/trajectory_planner.hpp"
+#include "traj_plan/time_optimal.hpp"
+
+namespace traj_plan
+{
+    class TrajPlanNodelet : public nodelet::Nodelet
+    {
+    private:
+        virtual void onInit()
+        {
+            ros::NodeHandle &pnh = getPrivateNodeHandle();
+            float period;
+            pnh.param<float>("period", period, 0.1);
+
+            ros::NodeHandle nh_linear(pnh, "linear");
+            linear_traj_planner_.Init(nh_linear, period);
+
+            ros::NodeHandle nh_spline(pnh, "spline");
+            spline_traj_planner_.Init(nh_spline, period);
+
+            ros::NodeHandle nh_time_optimal(pnh, "time_optimal");
+            time_optimal_traj_planner_.Init(nh_time_optimal, period);
+            NODELET_INFO_STREAM("traj_plan nodelet ready, period " << period);
+        }
+
+        TrajectoryPlanner<LinearInterpolater> linear_traj_planner_;
+        TrajectoryPlanner<SplineInterpolater> spline_traj_planner_;
+        TimeOptimalTrajectoryPlanner time_optimal_traj_planner_;
+    };
+}
+
+PLUGINLIB_EXPORT_CLASS(traj_plan::TrajPlanNodelet, nodelet::Nodelet)
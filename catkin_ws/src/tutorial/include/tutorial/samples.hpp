@@ -0,0 +1,48 @@
+/**
+ * Fixed-size samples sent through a ShmRing, and the ring names of the tutorial nodes.
+ */
+#ifndef TUTORIAL_SAMPLES_HPP
+#define TUTORIAL_SAMPLES_HPP
+
+#include <cstdint>
+#include <time.h>
+
+namespace tutorial
+{
+    const char *const kChatterRing = "/tutorial_chatter";
+    const char *const kJointStateRing = "/tutorial_joint_states";
+
+    // std_msgs/String of talker and listener, truncated to a fixed size
+    struct ChatterSample
+    {
+        uint64_t seq;
+        char data[120];  // Null terminated
+    };
+
+    /**
+     * sensor_msgs/JointState without names (a stream is one robot, the names are known to both sides)
+     * for up to kMaxJoints joints. stamp_ns is CLOCK_MONOTONIC, comparable between processes.
+     */
+    const int kMaxJoints = 8;
+
+    struct JointSample
+    {
+        uint64_t seq;
+        int64_t stamp_ns;
+        uint32_t num_joints;
+        uint32_t reserved;
+        double position[kMaxJoints];
+        double velocity[kMaxJoints];
+        double effort[kMaxJoints];
+    };
+
+    // [ns] CLOCK_MONOTONIC
+    inline int64_t monotonicNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+}
+
+#endif // TUTORIAL_SAMPLES_HPP
@@ -0,0 +1,359 @@
+/**
+ * Shared-memory ring buffer between processes of one host: no serialization, no socket,
+ * no copy besides the one into and out of the ring.
+ *
+ * One writer, any number of readers. The writer never waits for a reader: every slot is a
+ * seqlock, so a reader that falls more than `capacity` samples behind skips to the oldest
+ * sample still in the ring and counts the skipped ones as lost (like a full subscriber queue).
+ * Samples are trivially copyable and copied as relaxed 64-bit atomic words.
+ * A name belongs to one writer at a time: another writer only takes it over once the ring is
+ * stale (closed, or its writer process is gone), and readers notice the takeover.
+ *
+ * [ Usage ]
+ *     tutorial::ShmRingWriter<Sample> writer;
+ *     writer.create("/joint_states", 1024, error);
+ *     writer.write(sample);
+ *     // Another process
+ *     tutorial::ShmRingReader<Sample> reader;
+ *     reader.open("/joint_states", error);
+ *     while (reader.read(sample)) { ... }
+ */
+#ifndef TUTORIAL_SHM_RING_HPP
+#define TUTORIAL_SHM_RING_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace tutorial
+{
+    namespace shm
+    {
+        const uint32_t kMagic = 0x52494e47;  // "RING", stored last by the writer
+        const uint32_t kVersion = 2;
+
+        struct Header
+        {
+            std::atomic<uint32_t> magic;
+            uint32_t version;
+            uint32_t capacity;      // Slots
+            uint32_t sample_bytes;  // sizeof(T) of the writer
+            std::atomic<uint32_t> readers;
+            std::atomic<uint32_t> closed;  // 1: the writer is gone
+            std::atomic<int32_t> writer_pid;  // 0 until the writer has mapped the ring
+            alignas(64) std::atomic<uint64_t> head;  // Samples written so far
+        };
+
+        // Slot of a T: a sequence number (odd while written) and the sample as 64-bit words
+        template <typename T>
+        struct alignas(64) Slot
+        {
+            enum { kWords = (sizeof(T) + 7) / 8 };
+            std::atomic<uint64_t> seq;
+            std::atomic<uint64_t> words[kWords];
+        };
+
+        template <typename T>
+        std::size_t mappingBytes(const uint32_t capacity)
+        {
+            return sizeof(Header) + (sizeof(Header) % 64 == 0 ? 0 : 64 - sizeof(Header) % 64) +
+                   (std::size_t)capacity * sizeof(Slot<T>);
+        }
+
+        template <typename T>
+        Slot<T> *slots(void *data)
+        {
+            const std::size_t offset = mappingBytes<T>(0);
+            return reinterpret_cast<Slot<T> *>(static_cast<char *>(data) + offset);
+        }
+
+        // True if `pid` runs (rings are shared within one pid namespace)
+        inline bool isProcessAlive(const int32_t pid)
+        {
+            return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+        }
+
+        // Inode of the ring named `name` now, 0 if there is none
+        inline ino_t currentInode(const std::string &name)
+        {
+            const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0) { return 0; }
+            struct stat st;
+            const ino_t inode = fstat(fd, &st) == 0 ? st.st_ino : 0;
+            ::close(fd);
+            return inode;
+        }
+
+        /**
+         * True if the ring named `name` has no live writer: closed, or the writer process is gone.
+         * A ring without a writer pid yet is being created (or its writer crashed while creating
+         * it, see /dev/shm) and counts as in use.
+         */
+        inline bool isStale(const std::string &name)
+        {
+            const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0) { return errno == ENOENT; }
+            struct stat st;
+            void *data = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header))
+            {
+                data = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (data == MAP_FAILED) { return false; }
+            const Header *header = static_cast<const Header *>(data);
+            const int32_t pid = header->writer_pid.load(std::memory_order_acquire);
+            const bool stale = pid != 0 && (header->closed.load(std::memory_order_acquire) != 0 || !isProcessAlive(pid));
+            munmap(data, sizeof(Header));
+            return stale;
+        }
+    }
+
+    template <typename T>
+    class ShmRingWriter
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "ShmRing samples are copied as raw words");
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "ShmRing needs lock-free 64-bit atomics");
+
+    public:
+        ShmRingWriter() {}
+        ~ShmRingWriter() { close(); }
+        ShmRingWriter(const ShmRingWriter &) = delete;
+        ShmRingWriter &operator=(const ShmRingWriter &) = delete;
+
+        /**
+         * Create the ring `name` ("/something", see shm_open) with `capacity` slots.
+         * A stale ring of the same name (closed, or left behind by a crashed writer) is replaced;
+         * fails if the name belongs to a running writer.
+         */
+        bool create(const std::string &name, const uint32_t capacity, std::string &error)
+        {
+            close();
+            if (capacity < 1)
+            {
+                error = "capacity must be positive";
+                return false;
+            }
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0 && errno == EEXIST)
+            {
+                if (!shm::isStale(name))
+                {
+                    error = name + " belongs to a running writer";
+                    return false;
+                }
+                shm_unlink(name.c_str());
+                fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            }
+            if (fd < 0)
+            {
+                error = "shm_open " + name + ": " + std::strerror(errno);
+                return false;
+            }
+            const std::size_t bytes = shm::mappingBytes<T>(capacity);
+            void *data = MAP_FAILED;
+            struct stat st;
+            if (ftruncate(fd, bytes) == 0 && fstat(fd, &st) == 0)
+            {
+                data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (data == MAP_FAILED)
+            {
+                error = "mmap " + name + ": " + std::strerror(errno);
+                shm_unlink(name.c_str());
+                return false;
+            }
+
+            // ftruncate zero-filled the mapping, the atomics start at 0
+            header_ = new (data) shm::Header;
+            header_->writer_pid.store(getpid(), std::memory_order_release);
+            header_->version = shm::kVersion;
+            header_->capacity = capacity;
+            header_->sample_bytes = sizeof(T);
+            header_->readers.store(0, std::memory_order_relaxed);
+            header_->closed.store(0, std::memory_order_relaxed);
+            header_->head.store(0, std::memory_order_relaxed);
+            slots_ = shm::slots<T>(data);
+            for (uint32_t s = 0; s < capacity; s++) { new (&slots_[s]) shm::Slot<T>; }
+            header_->magic.store(shm::kMagic, std::memory_order_release);
+
+            name_ = name;
+            inode_ = st.st_ino;
+            bytes_ = bytes;
+            capacity_ = capacity;
+            head_ = 0;
+            return true;
+        }
+
+        void write(const T &sample)
+        {
+            uint64_t words[shm::Slot<T>::kWords] = {};
+            std::memcpy(words, &sample, sizeof(T));
+
+            const uint64_t n = head_;
+            shm::Slot<T> &slot = slots_[n % capacity_];
+            slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (int w = 0; w < shm::Slot<T>::kWords; w++) { slot.words[w].store(words[w], std::memory_order_relaxed); }
+            slot.seq.store(2 * n + 2, std::memory_order_release);
+            header_->head.store(n + 1, std::memory_order_release);
+            head_ = n + 1;
+        }
+
+        // Readers that have the ring open (like Publisher::getNumSubscribers)
+        uint32_t getNumReaders() const { return header_ ? header_->readers.load(std::memory_order_acquire) : 0; }
+        bool isOpen() const { return header_ != nullptr; }
+
+        // Readers keep their mapping until they close; the name is free for the next writer
+        void close()
+        {
+            if (!header_) { return; }
+            header_->closed.store(1, std::memory_order_release);
+            munmap(header_, bytes_);
+            if (shm::currentInode(name_) == inode_) { shm_unlink(name_.c_str()); }
+            header_ = nullptr;
+            slots_ = nullptr;
+        }
+
+    private:
+        shm::Header *header_ = nullptr;
+        shm::Slot<T> *slots_ = nullptr;
+        std::string name_;
+        ino_t inode_ = 0;
+        std::size_t bytes_ = 0;
+        uint32_t capacity_ = 0;
+        uint64_t head_ = 0;
+    };
+
+    template <typename T>
+    class ShmRingReader
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "ShmRing samples are copied as raw words");
+
+    public:
+        ShmRingReader() {}
+        ~ShmRingReader() { close(); }
+        ShmRingReader(const ShmRingReader &) = delete;
+        ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+        // Open the ring of a running writer, reading starts at the next sample written
+        bool open(const std::string &name, std::string &error)
+        {
+            close();
+            const int fd = shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+            {
+                error = "shm_open " + name + ": " + std::strerror(errno);
+                return false;
+            }
+            struct stat st;
+            void *data = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t)shm::mappingBytes<T>(0))
+            {
+                data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (data == MAP_FAILED)
+            {
+                error = "mmap " + name + " failed";
+                return false;
+            }
+            shm::Header *header = static_cast<shm::Header *>(data);
+            if (header->magic.load(std::memory_order_acquire) != shm::kMagic ||
+                header->version != shm::kVersion ||
+                header->sample_bytes != sizeof(T) ||
+                shm::mappingBytes<T>(header->capacity) > (std::size_t)st.st_size)
+            {
+                error = name + " is not a ring of this sample type (or not ready yet)";
+                munmap(data, st.st_size);
+                return false;
+            }
+            header_ = header;
+            slots_ = shm::slots<T>(data);
+            name_ = name;
+            inode_ = st.st_ino;
+            writer_pid_ = header->writer_pid.load(std::memory_order_acquire);
+            bytes_ = st.st_size;
+            capacity_ = header->capacity;
+            header_->readers.fetch_add(1, std::memory_order_acq_rel);
+            next_ = header_->head.load(std::memory_order_acquire);
+            lost_ = 0;
+            return true;
+        }
+
+        // Copy the next sample to `sample`, false if there is none yet
+        bool read(T &sample)
+        {
+            uint64_t words[shm::Slot<T>::kWords];
+            while (true)
+            {
+                const uint64_t head = header_->head.load(std::memory_order_acquire);
+                if (next_ >= head) { return false; }
+                if (head - next_ > capacity_)
+                {
+                    // Lapped by the writer
+                    lost_ += head - next_ - capacity_;
+                    next_ = head - capacity_;
+                }
+                const shm::Slot<T> &slot = slots_[next_ % capacity_];
+                const uint64_t expected = 2 * next_ + 2;
+                const uint64_t before = slot.seq.load(std::memory_order_acquire);
+                for (int w = 0; w < shm::Slot<T>::kWords; w++) { words[w] = slot.words[w].load(std::memory_order_relaxed); }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const uint64_t after = slot.seq.load(std::memory_order_relaxed);
+                next_++;
+                if (before == expected && after == expected)
+                {
+                    std::memcpy(&sample, words, sizeof(T));
+                    return true;
+                }
+                lost_++;  // Overwritten while copying
+            }
+        }
+
+        uint64_t getLost() const { return lost_; }
+        bool isOpen() const { return header_ != nullptr; }
+        /**
+         * The writer closed the ring, crashed, or the name now belongs to a new ring: open again.
+         * A few system calls, so check it while idle rather than for every sample.
+         */
+        bool isWriterClosed() const
+        {
+            return header_->closed.load(std::memory_order_acquire) != 0 ||
+                   !shm::isProcessAlive(writer_pid_) ||
+                   shm::currentInode(name_) != inode_;
+        }
+
+        void close()
+        {
+            if (!header_) { return; }
+            header_->readers.fetch_sub(1, std::memory_order_acq_rel);
+            munmap(header_, bytes_);
+            header_ = nullptr;
+            slots_ = nullptr;
+        }
+
+    private:
+        shm::Header *header_ = nullptr;
+        const shm::Slot<T> *slots_ = nullptr;
+        std::string name_;
+        ino_t inode_ = 0;
+        int32_t writer_pid_ = 0;
+        std::size_t bytes_ = 0;
+        uint32_t capacity_ = 0;
+        uint64_t next_ = 0;
+        uint64_t lost_ = 0;
+    };
+}
+
+#endif // TUTORIAL_SHM_RING_HPP
@@ -1,18 +1,67 @@
 #include "ros/ros.h"
 #include "std_msgs/String.h"
+#include "tutorial/samples.hpp"
+#include "tutorial/shm_ring.hpp"
 
 void chatterCallback(const std_msgs::String::ConstPtr& msg)
 {
   ROS_INFO("I heard: [%s]", msg->data.c_str());
 }
 
+// Poll the talker's ring, reopening it whenever the talker restarts
+void listenShm()
+{
+  tutorial::ShmRingReader<tutorial::ChatterSample> ring;
+  tutorial::ChatterSample sample;
+  std::string error;
+  ros::WallRate poll_rate(1000);
+  int idle_polls = 0;
+
+  while (ros::ok())
+  {
+    // Checking for a new talker costs system calls, do it every 100 idle polls
+    if (!ring.isOpen() || (idle_polls >= 100 && ring.isWriterClosed()))
+    {
+      idle_polls = 0;
+      if (!ring.open(tutorial::kChatterRing, error))
+      {
+        ROS_INFO_THROTTLE(5.0, "Waiting for the talker: %s", error.c_str());
+        ros::WallDuration(0.1).sleep();
+        continue;
+      }
+    }
+    idle_polls = idle_polls >= 100 ? 0 : idle_polls + 1;
+    while (ring.read(sample))
+    {
+      ROS_INFO("I heard: [%s]", sample.data);
+      idle_polls = 0;
+    }
+    poll_rate.sleep();
+  }
+  if (ring.isOpen() && ring.getLost() > 0)
+  {
+    ROS_WARN("Lost %lu samples", (unsigned long)ring.getLost());
+  }
+}
+
 int main(int argc, char **argv)
 {
   ros::init(argc, argv, "listener");
   ros::NodeHandle n;
+  ros::NodeHandle pnh("~");
+
+  // "tcpros": subscribe to chatter, "shm": read the shared-memory ring of a talker on this host
+  std::string transport;
+  pnh.param<std::string>("transport", transport, "tcpros");
+
+  if (transport == "shm")
+  {
+    listenShm();
+    return 0;
+  }
 
   ros::Subscriber sub = n.subscribe("chatter", 1000, chatterCallback);
   ros::spin();
 
   return 0;
-}
\ No newline at end of file
+}
@@ -1,5 +1,8 @@
 #include "ros/ros.h"
 #include "std_msgs/String.h"
+#include "tutorial/samples.hpp"
+#include "tutorial/shm_ring.hpp"
+#include <cstring>
 #include <sstream>
 
 int main(int argc, char **argv)
@@ -7,9 +10,30 @@ int main(int argc, char **argv)
 
     ros::init(argc, argv, "talker");
     ros::NodeHandle n;
+    ros::NodeHandle pnh("~");
 
-    ros::Publisher chatter_pub =
-        n.advertise<std_msgs::String>("chatter", 1000);
+    // "tcpros": std_msgs/String on chatter, "shm": shared-memory ring for a listener on this host
+    std::string transport;
+    pnh.param<std::string>("transport", transport, "tcpros");
+    // Slots of the shared-memory ring
+    int ring_capacity;
+    pnh.param<int>("ring_capacity", ring_capacity, 1024);
+
+    ros::Publisher chatter_pub;
+    tutorial::ShmRingWriter<tutorial::ChatterSample> chatter_ring;
+    if (transport == "shm")
+    {
+        std::string error;
+        if (!chatter_ring.create(tutorial::kChatterRing, ring_capacity, error))
+        {
+            ROS_ERROR("%s", error.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        chatter_pub = n.advertise<std_msgs::String>("chatter", 1000);
+    }
     ros::Rate loop_rate(10);
     int count = 0;
 
@@ -24,7 +48,18 @@ int main(int argc, char **argv)
         msg.data = ss.str();
 
         ROS_INFO("%s", msg.data.c_str());
-        chatter_pub.publish(msg);
+        if (chatter_ring.isOpen())
+        {
+            tutorial::ChatterSample sample;
+            sample.seq = count;
+            std::strncpy(sample.data, msg.data.c_str(), sizeof(sample.data) - 1);
+            sample.data[sizeof(sample.data) - 1] = '\0';
+            chatter_ring.write(sample);
+        }
+        else
+        {
+            chatter_pub.publish(msg);
+        }
 
         ros::spinOnce();
         loop_rate.sleep();
@@ -32,4 +67,4 @@ int main(int argc, char **argv)
     }
 
     return 0;
-}
\ No newline at end of file
+}
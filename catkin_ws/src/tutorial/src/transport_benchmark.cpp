@@ -0,0 +1,287 @@
+/**
+ * transport_benchmark.cpp
+ *
+ * Latency and throughput of a joint state stream over three transports:
+ *  - tcpros:       sender and receiver in two managers, sensor_msgs/JointState serialized over TCP
+ *  - intraprocess: both in one manager, roscpp hands the shared pointer over without serialization
+ *  - shm:          two managers, a JointSample copied through a ShmRing (see shm_ring.hpp)
+ * Latency is measured from just before the send to the receive callback, on CLOCK_MONOTONIC
+ * (the ROS transports carry that stamp in header.stamp). Sample loss is count - received.
+ *
+ * `roslaunch tutorial transport_benchmark.launch mode:=shm rate:=1000`
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/JointState.h>
+#include "tutorial/samples.hpp"
+#include "tutorial/shm_ring.hpp"
+
+namespace tutorial
+{
+    const char *const kJointStateTopic = "benchmark/joint_states";
+
+    inline void sleepUntil(const int64_t ns)
+    {
+        timespec ts;
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+    }
+
+    // Sends `count` joint states at `rate` [Hz] (0: as fast as possible) once the receiver is connected
+    class JointSender : public nodelet::Nodelet
+    {
+    public:
+        virtual ~JointSender()
+        {
+            stop_ = true;
+            if (thread_.joinable()) { thread_.join(); }
+        }
+
+    private:
+        virtual void onInit()
+        {
+            ros::NodeHandle &pnh = getPrivateNodeHandle();
+            pnh.param<std::string>("transport", transport_, "ros");
+            pnh.param<double>("rate", rate_, 1000.0);
+            pnh.param<int>("count", count_, 10000);
+            pnh.param<int>("num_joints", num_joints_, 6);
+            int queue_size;
+            pnh.param<int>("queue_size", queue_size, 1000);
+            num_joints_ = std::max(1, std::min(num_joints_, kMaxJoints));
+
+            if (transport_ == "shm")
+            {
+                std::string error;
+                if (!ring_.create(kJointStateRing, queue_size, error))
+                {
+                    NODELET_ERROR_STREAM(error);
+                    return;
+                }
+            }
+            else
+            {
+                pub_ = getNodeHandle().advertise<sensor_msgs::JointState>(kJointStateTopic, queue_size);
+            }
+            for (int j = 0; j < num_joints_; j++) { names_.push_back("joint_" + std::to_string(j + 1)); }
+            stop_ = false;
+            thread_ = std::thread(&JointSender::run, this);
+        }
+
+        int getNumReceivers() const
+        {
+            return ring_.isOpen() ? ring_.getNumReaders() : pub_.getNumSubscribers();
+        }
+
+        void run()
+        {
+            while (!stop_ && ros::ok() && getNumReceivers() == 0) { ros::WallDuration(0.01).sleep(); }
+            if (stop_ || !ros::ok()) { return; }
+            NODELET_INFO_STREAM("Sending " << count_ << " joint states at " << rate_ << " Hz over " << transport_);
+
+            const int64_t period = rate_ > 0.0 ? (int64_t)(1e9 / rate_) : 0;
+            int64_t deadline = monotonicNs();
+            for (int seq = 0; seq < count_ && !stop_ && ros::ok(); seq++)
+            {
+                if (period > 0)
+                {
+                    deadline += period;
+                    sleepUntil(deadline);
+                }
+                send(seq);
+            }
+            NODELET_INFO_STREAM("Sent " << count_ << " joint states");
+        }
+
+        void send(const int seq)
+        {
+            const double t = rate_ > 0.0 ? seq / rate_ : seq * 1e-3;
+            if (ring_.isOpen())
+            {
+                JointSample sample;
+                sample.seq = seq;
+                sample.num_joints = num_joints_;
+                sample.reserved = 0;
+                for (int j = 0; j < kMaxJoints; j++)
+                {
+                    sample.position[j] = j < num_joints_ ? std::sin(t + j) : 0.0;
+                    sample.velocity[j] = j < num_joints_ ? std::cos(t + j) : 0.0;
+                    sample.effort[j] = 0.0;
+                }
+                sample.stamp_ns = monotonicNs();
+                ring_.write(sample);
+                return;
+            }
+            // A new message every time: an intra-process receiver still holds the previous one
+            sensor_msgs::JointStatePtr msg(new sensor_msgs::JointState);
+            msg->header.seq = seq;
+            msg->name = names_;
+            msg->position.resize(num_joints_);
+            msg->velocity.resize(num_joints_);
+            msg->effort.assign(num_joints_, 0.0);
+            for (int j = 0; j < num_joints_; j++)
+            {
+                msg->position[j] = std::sin(t + j);
+                msg->velocity[j] = std::cos(t + j);
+            }
+            msg->header.stamp.fromNSec(monotonicNs());
+            pub_.publish(msg);
+        }
+
+        std::string transport_;
+        double rate_;
+        int count_;
+        int num_joints_;
+        std::vector<std::string> names_;
+        ros::Publisher pub_;
+        ShmRingWriter<JointSample> ring_;
+        std::atomic<bool> stop_;
+        std::thread thread_;
+    };
+
+    /**
+     * Receives the sender's stream and reports latency quantiles and throughput once `count`
+     * samples arrived, or `timeout` seconds after the last one. A row per run is appended to
+     * `output_file` (CSV) if set.
+     */
+    class JointReceiver : public nodelet::Nodelet
+    {
+    public:
+        virtual ~JointReceiver()
+        {
+            stop_ = true;
+            if (thread_.joinable()) { thread_.join(); }
+        }
+
+    private:
+        virtual void onInit()
+        {
+            ros::NodeHandle &pnh = getPrivateNodeHandle();
+            pnh.param<std::string>("transport", transport_, "ros");
+            pnh.param<std::string>("label", label_, transport_);
+            pnh.param<int>("count", count_, 10000);
+            pnh.param<double>("timeout", timeout_, 2.0);
+            pnh.param<double>("poll_period", poll_period_, 0.0);
+            pnh.param<std::string>("output_file", output_file_, "");
+            int queue_size;
+            pnh.param<int>("queue_size", queue_size, 1000);
+            count_ = std::max(count_, 1);
+
+            latencies_.reserve(count_);
+            stop_ = false;
+            done_ = false;
+            if (transport_ == "shm")
+            {
+                thread_ = std::thread(&JointReceiver::pollRing, this);
+                return;
+            }
+            // One callback queue per nodelet: the subscriber and the timer never run concurrently
+            ros::NodeHandle &nh = getNodeHandle();
+            sub_ = nh.subscribe(kJointStateTopic, queue_size, &JointReceiver::onJointState, this,
+                                ros::TransportHints().tcpNoDelay());
+            timer_ = nh.createWallTimer(ros::WallDuration(0.1), &JointReceiver::onTimer, this);
+        }
+
+        void onJointState(const sensor_msgs::JointState::ConstPtr &msg)
+        {
+            record((int64_t)msg->header.stamp.toNSec());
+        }
+
+        void onTimer(const ros::WallTimerEvent &)
+        {
+            checkTimeout();
+        }
+
+        // Busy polls with poll_period 0, which costs a core and gives the lowest latency
+        void pollRing()
+        {
+            ShmRingReader<JointSample> ring;
+            JointSample sample;
+            std::string error;
+            while (!stop_ && ros::ok() && !ring.open(kJointStateRing, error))
+            {
+                NODELET_INFO_STREAM_THROTTLE(5.0, "Waiting for the sender: " << error);
+                ros::WallDuration(0.01).sleep();
+            }
+            while (!stop_ && ros::ok() && !done_)
+            {
+                while (!done_ && ring.read(sample)) { record(sample.stamp_ns); }
+                checkTimeout();
+                if (poll_period_ > 0.0) { ros::WallDuration(poll_period_).sleep(); }
+                else { std::this_thread::yield(); }
+            }
+            if (ring.getLost() > 0) { NODELET_WARN_STREAM("Overrun by the sender: " << ring.getLost() << " samples"); }
+        }
+
+        void record(const int64_t stamp_ns)
+        {
+            if (done_) { return; }
+            const int64_t now = monotonicNs();
+            if (latencies_.empty()) { first_ns_ = now; }
+            last_ns_ = now;
+            latencies_.push_back(now - stamp_ns);
+            if ((int)latencies_.size() >= count_) { report(); }
+        }
+
+        void checkTimeout()
+        {
+            if (!done_ && !latencies_.empty() && (monotonicNs() - last_ns_) * 1e-9 > timeout_) { report(); }
+        }
+
+        void report()
+        {
+            done_ = true;
+            sub_.shutdown();
+            timer_.stop();
+
+            const std::size_t received = latencies_.size();
+            std::sort(latencies_.begin(), latencies_.end());
+            auto quantile = [this](double q) {
+                const std::size_t rank = (std::size_t)std::ceil(q * latencies_.size());
+                return latencies_[std::max<std::size_t>(rank, 1) - 1] * 1e-3;
+            };
+            const double p50 = quantile(0.5), p90 = quantile(0.9), p99 = quantile(0.99), max = latencies_.back() * 1e-3;
+            const double window = (last_ns_ - first_ns_) * 1e-9;
+            const double throughput = received > 1 && window > 0.0 ? (received - 1) / window : 0.0;
+            const long lost = (long)count_ - (long)received;
+            NODELET_INFO_STREAM(label_ << ": received " << received << "/" << count_ << " (lost " << lost << "), latency [us] p50 "
+                                << p50 << " p90 " << p90 << " p99 " << p99 << " max " << max << ", " << throughput << " Hz");
+
+            if (output_file_.empty()) { return; }
+            std::ofstream out(output_file_, std::ios::app);
+            if (!out)
+            {
+                NODELET_ERROR_STREAM("Failed to open " << output_file_);
+                return;
+            }
+            out.seekp(0, std::ios::end);
+            if (out.tellp() == 0) { out << "transport,count,received,lost,p50_us,p90_us,p99_us,max_us,throughput_hz\n"; }
+            out << label_ << "," << count_ << "," << received << "," << lost << "," << p50 << "," << p90 << ","
+                << p99 << "," << max << "," << throughput << "\n";
+        }
+
+        std::string transport_;
+        std::string label_;
+        int count_;
+        double timeout_;
+        double poll_period_;
+        std::string output_file_;
+        ros::Subscriber sub_;
+        ros::WallTimer timer_;
+        std::vector<int64_t> latencies_;  // [ns]
+        int64_t first_ns_ = 0;            // Arrival of the first and last sample
+        int64_t last_ns_ = 0;
+        std::atomic<bool> stop_;
+        std::atomic<bool> done_;
+        std::thread thread_;
+    };
+}
+
+PLUGINLIB_EXPORT_CLASS(tutorial::JointSender, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(tutorial::JointReceiver, nodelet::Nodelet)
@@ -0,0 +1,439 @@
+/**
+ * Closed-form inverse kinematics for the chains of this repository, on top of a
+ * modified DH chain (workspace/dh_chain.hpp).
+ *
+ *  PLANAR: three revolute joints with parallel axes (rrr), optionally followed by a
+ *          prismatic joint along the same axis (scara). 2 branches (elbow up / down).
+ *  PUMA:   Craig's PUMA 560 layout, a spherical wrist behind a 3R arm with
+ *          alpha = (0, -90, 0, -90, 90, -90) deg and a1 = a4 = a5 = d5 = d6 = 0.
+ *          8 branches (shoulder x elbow x wrist flip).
+ * Any other chain is rejected by init(), so the caller can fall back to the numerical solver.
+ *
+ * Solutions are returned in a fixed-size buffer and filtered against the joint limits;
+ * solve() never allocates.
+ *
+ * [ Usage ]
+ *     workspace::AnalyticIK ik;
+ *     if (ik.init(chain, limits, error)) { n = ik.solve(pose, solutions); }
+ */
+#ifndef WORKSPACE_ANALYTIC_IK_HPP
+#define WORKSPACE_ANALYTIC_IK_HPP
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+#include "workspace/batch_fk.hpp"
+
+namespace workspace
+{
+    struct JointLimit
+    {
+        double min;
+        double max;
+    };
+
+    class AnalyticIK
+    {
+    public:
+        enum Kind { NONE, PLANAR, PUMA };
+        enum { MAX_JOINTS = 6, MAX_SOLUTIONS = 8 };
+
+        typedef std::array<double, MAX_JOINTS> Solution;
+        typedef std::array<Solution, MAX_SOLUTIONS> Solutions;
+
+        AnalyticIK(): kind_(NONE) {}
+
+        /**
+         * Recognize the chain, one limit per joint of the chain.
+         * Fails (and tells why in `error`) for a chain without a closed form here.
+         */
+        bool init(const DHChain &chain, const std::vector<JointLimit> &limits, std::string &error)
+        {
+            kind_ = NONE;
+            if (limits.size() != chain.links.size())
+            {
+                error = "one joint limit per link is required";
+                return false;
+            }
+            chain_ = chain;
+            limits_ = limits;
+            base_inv_ = chain.base.inverse();
+            tool_inv_ = chain.tool.inverse();
+            if (initPlanar(error) || initPuma(error))
+            {
+                return true;
+            }
+            error = "no closed form for this chain (" + error + ")";
+            return false;
+        }
+
+        Kind getKind() const { return kind_; }
+        std::size_t getNumJoints() const { return chain_.links.size(); }
+
+        /**
+         * All solutions for the end effector `pose` (model frame) within the joint limits.
+         * Returns the number of solutions written to the front of `solutions`.
+         */
+        std::size_t solve(const Eigen::Isometry3d &pose, Solutions &solutions) const
+        {
+            // Pose of the last link frame in frame 0
+            const Eigen::Isometry3d T = base_inv_ * pose * tool_inv_;
+            switch (kind_)
+            {
+            case PLANAR: return solvePlanar(T, solutions);
+            case PUMA: return solvePuma(T, solutions);
+            default: return 0;
+            }
+        }
+
+        /**
+         * Reachability of `position` with any orientation (position-only IK).
+         * PLANAR scans 64 orientations when the tool is off the last axis, so (like the numerical
+         * position-only IK) a point reachable in a very narrow orientation range can be missed.
+         * PUMA needs the tool point on the wrist center, see supportsPositionOnly().
+         */
+        bool reachable(const Eigen::Vector3d &position) const
+        {
+            return reachable(position, [](const Solution &) { return true; });
+        }
+
+        /**
+         * Same, with the solutions filtered by `valid(const Solution &) -> bool` (e.g. a collision check).
+         * Scanning stops at the first valid solution.
+         * PUMA only tries the zero wrist of each arm branch: when those are all invalid, another
+         * wrist pose may still be valid, so the caller should fall back to the numerical IK.
+         */
+        template <typename Validity>
+        bool reachable(const Eigen::Vector3d &position, Validity valid) const
+        {
+            Solutions solutions;
+            Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+            pose.translation() = position;
+            if (kind_ == PUMA)
+            {
+                const std::size_t n = solvePumaPosition((base_inv_ * pose).translation(), solutions);
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    if (valid(solutions[i])) { return true; }
+                }
+                return false;
+            }
+            if (kind_ != PLANAR) { return false; }
+            // Orientations about the joint axis (z of frame 0) in the model frame
+            const double lever = planar_offset_.x() + chain_.tool.translation().head<2>().norm();
+            const int steps = std::abs(lever) < 1e-9 ? 1 : 64;
+            const Eigen::Vector3d axis = chain_.base.linear().col(2);
+            for (int i = 0; i < steps; i++)
+            {
+                pose.linear() = Eigen::AngleAxisd(2.0 * M_PI * i / steps, axis).toRotationMatrix() * chain_.base.linear() *
+                    tool_inv_.linear().transpose();
+                const std::size_t n = solve(pose, solutions);
+                for (std::size_t s = 0; s < n; s++)
+                {
+                    if (valid(solutions[s])) { return true; }
+                }
+            }
+            return false;
+        }
+
+        bool supportsPositionOnly() const
+        {
+            return kind_ == PLANAR || (kind_ == PUMA && chain_.tool.translation().norm() < 1e-9);
+        }
+
+    private:
+        // One branch of the PUMA arm (DH angles, before the joint offsets)
+        struct PumaArm
+        {
+            double t1, t3, t23;
+            double c1, s1, c23, s23;
+        };
+
+        // The angles here are sums of a few atan2, so a couple of turns at most
+        static double wrapToPi(double x)
+        {
+            while (x > M_PI) { x -= 2.0 * M_PI; }
+            while (x < -M_PI) { x += 2.0 * M_PI; }
+            return x;
+        }
+
+        // Revolute joint value within its limits (trying +- 2 pi), false if there is none
+        bool limitRevolute(std::size_t j, double &q) const
+        {
+            q = wrapToPi(q);
+            for (double k : {0.0, -2.0 * M_PI, 2.0 * M_PI})
+            {
+                if (limits_[j].min - 1e-9 <= q + k && q + k <= limits_[j].max + 1e-9)
+                {
+                    q += k;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool limitPrismatic(std::size_t j, double q) const
+        {
+            return limits_[j].min - 1e-9 <= q && q <= limits_[j].max + 1e-9;
+        }
+
+        static bool near(double x, double y) { return std::abs(x - y) < 1e-9; }
+
+        /***********************************
+         * PLANAR: T = P0 Rz(t1) P1 Rz(t2) P2 Rz(t3) [P3 TransZ(q4) Rz(o4)]
+         * with P_i = TransX(a_i) TransZ(d_i), t_i = q_i + o_i
+         ***********************************/
+        bool initPlanar(std::string &error)
+        {
+            const std::vector<DHParam> &l = chain_.links;
+            if (l.size() != 3 && l.size() != 4)
+            {
+                error = "planar: 3 or 4 joints expected";
+                return false;
+            }
+            for (std::size_t j = 0; j < l.size(); j++)
+            {
+                if (!near(wrapToPi(l[j].alpha), 0.0) || l[j].prismatic != (j == 3))
+                {
+                    error = "planar: parallel revolute axes and an optional last prismatic joint expected";
+                    return false;
+                }
+            }
+            // Everything behind joint 3 is a constant offset in frame 3, except the prismatic stroke along z
+            planar_offset_.setZero();
+            planar_rotation_ = 0.0;
+            if (l.size() == 4)
+            {
+                planar_offset_ << l[3].a, 0.0, l[3].d;
+                planar_rotation_ = l[3].theta;
+            }
+            if (std::abs(l[1].a) < 1e-9 || std::abs(l[2].a) < 1e-9)
+            {
+                error = "planar: two non-zero link lengths expected";
+                return false;
+            }
+            kind_ = PLANAR;
+            return true;
+        }
+
+        std::size_t solvePlanar(const Eigen::Isometry3d &T, Solutions &solutions) const
+        {
+            const std::vector<DHParam> &l = chain_.links;
+            const Eigen::Matrix3d &R = T.linear();
+            // The orientation must be a rotation about z
+            if (std::abs(R(2, 2) - 1.0) > 1e-6) { return 0; }
+            const double phi = std::atan2(R(1, 0), R(0, 0));  // t1 + t2 + t3 + o4
+            const double theta = phi - planar_rotation_;       // t1 + t2 + t3
+
+            // Stroke along z
+            const double z_fixed = l[0].d + l[1].d + l[2].d + planar_offset_.z();
+            double stroke = 0.0;
+            if (l.size() == 4)
+            {
+                stroke = T.translation().z() - z_fixed;
+                if (!limitPrismatic(3, stroke)) { return 0; }
+            }
+            else if (std::abs(T.translation().z() - z_fixed) > 1e-6) { return 0; }
+
+            // Joint 2 of the two-link arm: w = Rz(t1) (a1, 0) + Rz(t1 + t2) (a2, 0)
+            const double wx = T.translation().x() - l[0].a - std::cos(theta) * planar_offset_.x();
+            const double wy = T.translation().y() - std::sin(theta) * planar_offset_.x();
+            const double a1 = l[1].a, a2 = l[2].a;
+            const double c2 = (wx * wx + wy * wy - a1 * a1 - a2 * a2) / (2.0 * a1 * a2);
+            if (c2 < -1.0 - 1e-12 || c2 > 1.0 + 1e-12) { return 0; }
+            const double s2_abs = std::sqrt(std::max(0.0, 1.0 - c2 * c2));
+
+            std::size_t n = 0;
+            for (double s2 : {s2_abs, -s2_abs})
+            {
+                const double t2 = std::atan2(s2, c2);
+                const double t1 = std::atan2(wy, wx) - std::atan2(a2 * s2, a1 + a2 * c2);
+                const double t3 = theta - t1 - t2;
+                Solution &q = solutions[n];
+                q[0] = t1 - l[0].theta;
+                q[1] = t2 - l[1].theta;
+                q[2] = t3 - l[2].theta;
+                q[3] = stroke;
+                if (limitRevolute(0, q[0]) && limitRevolute(1, q[1]) && limitRevolute(2, q[2])) { n++; }
+                if (s2_abs == 0.0) { break; }  // Both branches coincide at full stretch
+            }
+            return n;
+        }
+
+        /***********************************
+         * PUMA: Craig, Introduction to Robotics, 4.7
+         ***********************************/
+        bool initPuma(std::string &error)
+        {
+            const std::vector<DHParam> &l = chain_.links;
+            const double alpha[6] = {0.0, -M_PI_2, 0.0, -M_PI_2, M_PI_2, -M_PI_2};
+            bool ok = l.size() == 6;
+            for (std::size_t j = 0; ok && j < 6; j++)
+            {
+                ok = !l[j].prismatic && near(wrapToPi(l[j].alpha - alpha[j]), 0.0);
+            }
+            ok = ok && near(l[0].a, 0.0) && near(l[0].d, 0.0) && near(l[1].a, 0.0) &&
+                near(l[4].a, 0.0) && near(l[4].d, 0.0) && near(l[5].a, 0.0) && near(l[5].d, 0.0);
+            if (!ok)
+            {
+                error = "puma: Craig's PUMA 560 layout expected";
+                return false;
+            }
+            a2_ = l[2].a;
+            a3_ = l[3].a;
+            d3_ = l[1].d + l[2].d;  // Both offsets are along the parallel axes 2 and 3
+            d4_ = l[3].d;
+            forearm_sq_ = a3_ * a3_ + d4_ * d4_;
+            if (std::abs(a2_) < 1e-9 || forearm_sq_ < 1e-18)
+            {
+                error = "puma: non-zero upper arm and forearm expected";
+                return false;
+            }
+            kind_ = PUMA;
+            return true;
+        }
+
+        /**
+         * Arm joints 1 to 3 for the wrist center p, 4 branches (shoulder x elbow).
+         * The sines and cosines come from the atan2 arguments (angle difference identities),
+         * so each joint costs one atan2 and no sin / cos.
+         */
+        std::size_t solvePumaArm(const Eigen::Vector3d &p, PumaArm *arms) const
+        {
+            const double r_sq = p.x() * p.x() + p.y() * p.y();
+            const double lateral_sq = r_sq - d3_ * d3_;
+            if (lateral_sq < 0.0 || r_sq < 1e-18) { return 0; }
+            const double K = (r_sq + p.z() * p.z() - a2_ * a2_ - a3_ * a3_ - d3_ * d3_ - d4_ * d4_) / (2.0 * a2_);
+            const double rho_sq = forearm_sq_ - K * K;
+            if (rho_sq < -1e-12) { return 0; }
+            const double lateral = std::sqrt(lateral_sq);
+            const double rho = std::sqrt(std::max(0.0, rho_sq));
+
+            std::size_t n = 0;
+            for (double shoulder : {1.0, -1.0})
+            {
+                // t1 = atan2(py, px) - atan2(d3, +-lateral)
+                const double c1 = (p.x() * shoulder * lateral + p.y() * d3_) / r_sq;
+                const double s1 = (p.y() * shoulder * lateral - p.x() * d3_) / r_sq;
+                const double u = c1 * p.x() + s1 * p.y();
+                for (double elbow : {1.0, -1.0})
+                {
+                    // t3 = atan2(a3, d4) - atan2(K, +-rho), both with radius sqrt(a3^2 + d4^2)
+                    const double c3 = (d4_ * elbow * rho + a3_ * K) / forearm_sq_;
+                    const double s3 = (a3_ * elbow * rho - d4_ * K) / forearm_sq_;
+                    const double y23 = (-a3_ - a2_ * c3) * p.z() + u * (a2_ * s3 - d4_);
+                    const double x23 = (a2_ * s3 - d4_) * p.z() + (a3_ + a2_ * c3) * u;
+                    const double r23 = std::sqrt(x23 * x23 + y23 * y23);
+                    if (r23 < 1e-12) { continue; }  // Wrist center on the axis of joint 2
+                    PumaArm &arm = arms[n++];
+                    arm.t1 = std::atan2(s1, c1);
+                    arm.t3 = std::atan2(s3, c3);
+                    arm.t23 = std::atan2(y23, x23);
+                    arm.c1 = c1;
+                    arm.s1 = s1;
+                    arm.c23 = x23 / r23;
+                    arm.s23 = y23 / r23;
+                }
+            }
+            return n;
+        }
+
+        // Arm joints within the limits, written to q[0..2]
+        bool limitPumaArm(const PumaArm &arm, Solution &q) const
+        {
+            const std::vector<DHParam> &l = chain_.links;
+            q[0] = arm.t1 - l[0].theta;
+            q[1] = arm.t23 - arm.t3 - l[1].theta;
+            q[2] = arm.t3 - l[2].theta;
+            return limitRevolute(0, q[0]) && limitRevolute(1, q[1]) && limitRevolute(2, q[2]);
+        }
+
+        // Every arm branch with a zero wrist (any orientation), within the limits
+        std::size_t solvePumaPosition(const Eigen::Vector3d &p, Solutions &solutions) const
+        {
+            PumaArm arms[4];
+            const std::size_t num_arms = solvePumaArm(p, arms);
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < num_arms; i++)
+            {
+                Solution &q = solutions[n];
+                q[3] = q[4] = q[5] = 0.0;
+                if (limitPumaArm(arms[i], q) && limitRevolute(3, q[3]) && limitRevolute(4, q[4]) && limitRevolute(5, q[5]))
+                {
+                    n++;
+                }
+            }
+            return n;
+        }
+
+        std::size_t solvePuma(const Eigen::Isometry3d &T, Solutions &solutions) const
+        {
+            const std::vector<DHParam> &l = chain_.links;
+            PumaArm arms[4];
+            const std::size_t num_arms = solvePumaArm(T.translation(), arms);
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < num_arms; i++)
+            {
+                const PumaArm &arm = arms[i];
+                Solution arm_q;
+                if (!limitPumaArm(arm, arm_q)) { continue; }
+
+                // R03 = Rz(t1) Rx(-90) Rz(t23)
+                Eigen::Matrix3d R03;
+                R03 << arm.c1 * arm.c23, -arm.c1 * arm.s23, -arm.s1,
+                       arm.s1 * arm.c23, -arm.s1 * arm.s23,  arm.c1,
+                               -arm.s23,          -arm.c23,     0.0;
+                // Wrist: R36 = Rx(-90) Rz(t4) Rx(90) Rz(t5) Rx(-90) Rz(t6) = Ry(t4) Rz(t5) Ry(t6) Rx(-90),
+                // so W = R36 Rx(90) = Ry(t4) Rz(t5) Ry(t6) (Y-Z-Y Euler angles)
+                const Eigen::Matrix3d R36 = R03.transpose() * T.linear();
+                Eigen::Matrix3d W;
+                W.col(0) = R36.col(0);
+                W.col(1) = R36.col(2);
+                W.col(2) = -R36.col(1);
+                const double s5 = std::sqrt(W(0, 1) * W(0, 1) + W(2, 1) * W(2, 1));
+                double t4, t5, t6;
+                if (s5 < 1e-9)
+                {
+                    // Wrist singularity: only t4 +- t6 is defined, keep t4 = 0
+                    t4 = 0.0;
+                    t5 = W(1, 1) > 0.0 ? 0.0 : M_PI;
+                    t6 = W(1, 1) > 0.0 ? std::atan2(-W(2, 0), W(0, 0)) : -std::atan2(-W(2, 0), W(0, 0));
+                }
+                else
+                {
+                    t4 = std::atan2(W(2, 1), -W(0, 1));
+                    t5 = std::atan2(s5, W(1, 1));
+                    t6 = std::atan2(W(1, 2), W(1, 0));
+                }
+                // The other wrist branch: (t4 + pi, -t5, t6 + pi)
+                for (int flip = 0; flip < (s5 < 1e-9 ? 1 : 2); flip++)
+                {
+                    Solution &q = solutions[n];
+                    q = arm_q;
+                    q[3] = (flip ? t4 + M_PI : t4) - l[3].theta;
+                    q[4] = (flip ? -t5 : t5) - l[4].theta;
+                    q[5] = (flip ? t6 + M_PI : t6) - l[5].theta;
+                    if (limitRevolute(3, q[3]) && limitRevolute(4, q[4]) && limitRevolute(5, q[5])) { n++; }
+                }
+            }
+            return n;
+        }
+
+        Kind kind_;
+        DHChain chain_;
+        std::vector<JointLimit> limits_;
+        Eigen::Isometry3d base_inv_;
+        Eigen::Isometry3d tool_inv_;
+        // PLANAR
+        Eigen::Vector3d planar_offset_;  // Last revolute frame -> end of the chain, at zero stroke
+        double planar_rotation_;
+        // PUMA
+        double a2_, a3_, d3_, d4_;
+        double forearm_sq_;  // a3^2 + d4^2
+    };
+}
+
+#endif // WORKSPACE_ANALYTIC_IK_HPP
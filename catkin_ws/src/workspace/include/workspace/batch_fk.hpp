@@ -0,0 +1,181 @@
+/**
+ * Batch forward kinematics of a serial chain given by modified DH parameters.
+ *
+ * N configurations are evaluated at once in structure-of-arrays form:
+ * every element of the rotation matrix and of the position is an Eigen array over
+ * the N samples, so the chain product and sin/cos are vectorized by Eigen packet ops.
+ * Use Scalar = float for vectorized sin/cos (Eigen evaluates double sin/cos one by one).
+ *
+ * [ Usage ]
+ *     workspace::BatchFK<float> fk(chain);
+ *     fk.compute(q);                       // q: (num joints) x N, one row per joint
+ *     Eigen::Isometry3d pose = fk.getPose(i);
+ */
+#ifndef WORKSPACE_BATCH_FK_HPP
+#define WORKSPACE_BATCH_FK_HPP
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+namespace workspace
+{
+    /**
+     * Modified DH (Craig) link, same convention as DH() of new folder/dh.hpp:
+     * T = RotX(alpha) * TransX(a) * TransZ(d) * RotZ(theta)
+     * The joint variable is added to theta (revolute) or d (prismatic).
+     *
+     * Tables of the robots in this repository (joint origins of the URDFs, all axes +z):
+     *     rrr   : (0, 0,    0.02, 0) (0, 0.24, 0, 0) (0, 0.24, 0, 0)
+     *     scara : (0, 0,    0.05, 0) (0, 0.12, 0, 0) (0, 0.12, 0, 0) (0, 0.12, -0.05, 0)*prismatic
+     */
+    struct DHParam
+    {
+        double alpha;
+        double a;
+        double d;
+        double theta;
+        bool prismatic;
+    };
+
+    struct DHChain
+    {
+        Eigen::Isometry3d base = Eigen::Isometry3d::Identity();  // Model frame -> frame 0
+        std::vector<DHParam> links;
+        Eigen::Isometry3d tool = Eigen::Isometry3d::Identity();  // Last link frame -> end effector
+    };
+
+    inline Eigen::Isometry3d modifiedDH(double alpha, double a, double d, double theta)
+    {
+        Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+        T.rotate(Eigen::AngleAxisd(alpha, Eigen::Vector3d::UnitX()));
+        T.translate(Eigen::Vector3d(a, 0, d));
+        T.rotate(Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ()));
+        return T;
+    }
+
+    /** Scalar reference: end effector pose of a single configuration */
+    inline Eigen::Isometry3d computeDHChain(const DHChain &chain, const std::vector<double> &q)
+    {
+        Eigen::Isometry3d T = chain.base;
+        for (std::size_t j = 0; j < chain.links.size(); j++)
+        {
+            const DHParam &l = chain.links[j];
+            T = T * modifiedDH(l.alpha, l.a, l.prismatic ? l.d + q[j] : l.d, l.prismatic ? l.theta : l.theta + q[j]);
+        }
+        return T * chain.tool;
+    }
+
+    template <typename Scalar>
+    class BatchFK
+    {
+    public:
+        using Array = Eigen::Array<Scalar, Eigen::Dynamic, 1>;
+        using JointArray = Eigen::Array<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+        explicit BatchFK(const DHChain &chain): chain_(chain) {}
+
+        /**
+         * q: (number of links) x N, row j holds the values of joint j for all samples.
+         * Buffers are reused between calls of the same N.
+         */
+        void compute(const JointArray &q)
+        {
+            const Eigen::Index n = q.cols();
+            resize(n);
+
+            for (int r = 0; r < 3; r++)
+            {
+                for (int c = 0; c < 3; c++) { R_[r][c].setConstant(chain_.base.linear()(r, c)); }
+                p_[r].setConstant(chain_.base.translation()(r));
+            }
+
+            for (std::size_t j = 0; j < chain_.links.size(); j++)
+            {
+                const DHParam &l = chain_.links[j];
+                const Scalar ca = std::cos(l.alpha);
+                const Scalar sa = std::sin(l.alpha);
+                const Scalar a = l.a;
+                if (l.prismatic)
+                {
+                    ct_.setConstant(std::cos(l.theta));
+                    st_.setConstant(std::sin(l.theta));
+                    d_ = q.row(j).transpose() + Scalar(l.d);
+                }
+                else
+                {
+                    th_ = q.row(j).transpose() + Scalar(l.theta);
+                    ct_ = th_.cos();
+                    st_ = th_.sin();
+                    d_.setConstant(l.d);
+                }
+
+                // [R | p] <- [R | p] * RotX(alpha) * TransX(a) * TransZ(d) * RotZ(theta)
+                for (int r = 0; r < 3; r++)
+                {
+                    u_ = ca * R_[r][1] + sa * R_[r][2];     // Row r of R * RotX(alpha), column 1
+                    R_[r][2] = ca * R_[r][2] - sa * R_[r][1]; // Column 2 (unchanged by RotZ)
+                    p_[r] += a * R_[r][0] + d_ * R_[r][2];
+                    R_[r][1] = u_ * ct_ - R_[r][0] * st_;
+                    R_[r][0] = R_[r][0] * ct_ + u_ * st_;
+                }
+            }
+
+            // Tool
+            const Eigen::Matrix3d &tool_R = chain_.tool.linear();
+            const Eigen::Vector3d &tool_p = chain_.tool.translation();
+            for (int r = 0; r < 3; r++)
+            {
+                p_[r] += Scalar(tool_p(0)) * R_[r][0] + Scalar(tool_p(1)) * R_[r][1] + Scalar(tool_p(2)) * R_[r][2];
+                for (int c = 0; c < 3; c++)
+                {
+                    tmp_[c] = Scalar(tool_R(0, c)) * R_[r][0] + Scalar(tool_R(1, c)) * R_[r][1] + Scalar(tool_R(2, c)) * R_[r][2];
+                }
+                for (int c = 0; c < 3; c++) { R_[r][c].swap(tmp_[c]); }
+            }
+        }
+
+        Eigen::Index size() const { return p_[0].size(); }
+        const Array &getPosition(int r) const { return p_[r]; }
+        const Array &getRotation(int r, int c) const { return R_[r][c]; }
+
+        Eigen::Isometry3d getPose(Eigen::Index i) const
+        {
+            Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+            for (int r = 0; r < 3; r++)
+            {
+                for (int c = 0; c < 3; c++) { T.linear()(r, c) = R_[r][c](i); }
+                T.translation()(r) = p_[r](i);
+            }
+            return T;
+        }
+
+        const DHChain &getChain() const { return chain_; }
+
+    private:
+        void resize(Eigen::Index n)
+        {
+            if (p_[0].size() == n) { return; }
+            for (int r = 0; r < 3; r++)
+            {
+                for (int c = 0; c < 3; c++) { R_[r][c].resize(n); }
+                p_[r].resize(n);
+                tmp_[r].resize(n);
+            }
+            th_.resize(n);
+            ct_.resize(n);
+            st_.resize(n);
+            d_.resize(n);
+            u_.resize(n);
+        }
+
+        const DHChain chain_;
+        Array R_[3][3];
+        Array p_[3];
+        Array tmp_[3];
+        Array th_, ct_, st_, d_, u_;
+    };
+}
+
+#endif // WORKSPACE_BATCH_FK_HPP
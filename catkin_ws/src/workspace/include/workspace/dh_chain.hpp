@@ -0,0 +1,189 @@
+/**
+ * Extraction of a modified DH chain (workspace/batch_fk.hpp) from a loaded RobotModel.
+ *
+ * Every active joint of the group must be a single revolute or prismatic joint,
+ * consecutive joints must be connected through fixed joints only, and every
+ * intermediate joint origin must be DH-expressible once the joint axes are mapped onto z.
+ * The base and tool transforms are arbitrary.
+ */
+#ifndef WORKSPACE_DH_CHAIN_HPP
+#define WORKSPACE_DH_CHAIN_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+#include <moveit/robot_state/robot_state.h>
+#include "workspace/analytic_ik.hpp"
+#include "workspace/batch_fk.hpp"
+
+namespace workspace
+{
+    /** True if `to` is reached from its ancestor `from` through fixed joints only */
+    inline bool isFixedPath(const robot_model::LinkModel *from, const robot_model::LinkModel *to)
+    {
+        for (const robot_model::LinkModel *link = to; link != from; link = link->getParentLinkModel())
+        {
+            if (link == nullptr || link->getParentJointModel()->getType() != robot_model::JointModel::FIXED)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Decompose T = RotX(alpha) * TransX(a) * TransZ(d) * RotZ(theta) */
+    inline bool toModifiedDH(const Eigen::Isometry3d &T, DHParam &dh, double tolerance = 1e-9)
+    {
+        const Eigen::Matrix3d &R = T.linear();
+        const Eigen::Vector3d &p = T.translation();
+        dh.alpha = std::atan2(-R(1, 2), R(2, 2));
+        dh.theta = std::atan2(-R(0, 1), R(0, 0));
+        dh.a = p.x();
+        dh.d = -std::sin(dh.alpha) * p.y() + std::cos(dh.alpha) * p.z();
+        return (modifiedDH(dh.alpha, dh.a, dh.d, dh.theta).matrix() - T.matrix()).cwiseAbs().maxCoeff() < tolerance;
+    }
+
+    /**
+     * Build the chain of `joint_model_group` up to `eef_link`.
+     * `state` provides the transforms of the fixed parts (the joints outside the group included).
+     * On failure, `error` tells which joint cannot be expressed.
+     */
+    inline bool extractDHChain(
+        robot_state::RobotState &state,
+        const robot_model::JointModelGroup *joint_model_group,
+        const std::string &eef_link,
+        DHChain &chain,
+        std::string &error)
+    {
+        state.updateLinkTransforms();
+        chain = DHChain();
+        const robot_model::LinkModel *prev_link = nullptr;
+        Eigen::Isometry3d prev_axis = Eigen::Isometry3d::Identity();  // Frame of the previous joint axis
+        for (const robot_model::JointModel *jm : joint_model_group->getActiveJointModels())
+        {
+            DHParam dh{0, 0, 0, 0, false};
+            Eigen::Vector3d axis;
+            if (jm->getMimic() != nullptr)
+            {
+                error = "joint [ " + jm->getName() + " ] is a mimic joint";
+                return false;
+            }
+            if (jm->getType() == robot_model::JointModel::REVOLUTE)
+            {
+                axis = static_cast<const robot_model::RevoluteJointModel*>(jm)->getAxis();
+            }
+            else if (jm->getType() == robot_model::JointModel::PRISMATIC)
+            {
+                axis = static_cast<const robot_model::PrismaticJointModel*>(jm)->getAxis();
+                dh.prismatic = true;
+            }
+            else
+            {
+                error = "joint [ " + jm->getName() + " ] is neither revolute nor prismatic";
+                return false;
+            }
+
+            // Joint motion = Q * RotZ(q) * Q^-1 (or TransZ), Q maps z onto the joint axis
+            Eigen::Isometry3d axis_frame = Eigen::Isometry3d::Identity();
+            axis_frame.linear() = Eigen::Quaterniond::FromTwoVectors(Eigen::Vector3d::UnitZ(), axis.normalized()).toRotationMatrix();
+
+            const robot_model::LinkModel *parent = jm->getParentLinkModel();
+            const Eigen::Isometry3d &origin = jm->getChildLinkModel()->getJointOriginTransform();
+            if (prev_link == nullptr)
+            {
+                chain.base = state.getGlobalLinkTransform(parent) * origin * axis_frame;
+            }
+            else
+            {
+                if (!isFixedPath(prev_link, parent))
+                {
+                    error = "joint [ " + jm->getName() + " ] is not attached to the previous joint through fixed joints";
+                    return false;
+                }
+                const Eigen::Isometry3d link = prev_axis.inverse() *
+                    state.getGlobalLinkTransform(prev_link).inverse() * state.getGlobalLinkTransform(parent) *
+                    origin * axis_frame;
+                if (!toModifiedDH(link, dh))
+                {
+                    error = "origin of joint [ " + jm->getName() + " ] has no modified DH form";
+                    return false;
+                }
+            }
+            chain.links.push_back(dh);
+            prev_link = jm->getChildLinkModel();
+            prev_axis = axis_frame;
+        }
+
+        const robot_model::LinkModel *eef = state.getLinkModel(eef_link);
+        if (prev_link == nullptr || eef == nullptr || !isFixedPath(prev_link, eef))
+        {
+            error = "end effector [ " + eef_link + " ] is not attached to the last joint through fixed joints";
+            return false;
+        }
+        chain.tool = prev_axis.inverse() *
+            state.getGlobalLinkTransform(prev_link).inverse() * state.getGlobalLinkTransform(eef);
+        return true;
+    }
+
+    /** Position limits of the active joints of the group, +-pi for unbounded revolute joints */
+    inline void extractJointLimits(const robot_model::JointModelGroup *joint_model_group, std::vector<JointLimit> &limits)
+    {
+        limits.clear();
+        for (const robot_model::JointModel *jm : joint_model_group->getActiveJointModels())
+        {
+            const robot_model::VariableBounds &bounds = jm->getVariableBounds()[0];
+            if (bounds.position_bounded_) { limits.push_back({bounds.min_position_, bounds.max_position_}); }
+            else { limits.push_back({-M_PI, M_PI}); }
+        }
+    }
+
+    /**
+     * The closed-form IK against MoveIt: for sampled configurations within the limits, the
+     * MoveIt FK pose must be solved, and one of the solutions must give the same pose back.
+     * `state` is left at the last sample.
+     */
+    inline bool verifyAnalyticIK(
+        const AnalyticIK &ik,
+        const std::vector<JointLimit> &limits,
+        robot_state::RobotState &state,
+        const robot_model::JointModelGroup *joint_model_group,
+        const std::string &eef_link,
+        std::string &error,
+        int num_checks = 64)
+    {
+        std::mt19937 rng(0);
+        std::vector<double> joint_values(limits.size());
+        AnalyticIK::Solutions solutions;
+        auto calcFK = [&](const double *values)
+        {
+            state.setJointGroupPositions(joint_model_group, values);
+            state.updateLinkTransforms();
+            Eigen::Isometry3d pose;
+            pose.matrix() = state.getGlobalLinkTransform(eef_link).matrix();
+            return pose;
+        };
+        for (int c = 0; c < num_checks; c++)
+        {
+            for (std::size_t j = 0; j < limits.size(); j++)
+            {
+                joint_values[j] = std::uniform_real_distribution<double>(limits[j].min, limits[j].max)(rng);
+            }
+            const Eigen::Isometry3d target = calcFK(joint_values.data());
+            const std::size_t num_solutions = ik.solve(target, solutions);
+            bool matched = false;
+            for (std::size_t i = 0; i < num_solutions && !matched; i++)
+            {
+                matched = (calcFK(solutions[i].data()).matrix() - target.matrix()).cwiseAbs().maxCoeff() < 1e-6;
+            }
+            if (!matched)
+            {
+                error = "analytic IK differs from MoveIt FK (" + std::to_string(num_solutions) +
+                    " solutions at sample " + std::to_string(c) + ")";
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+#endif // WORKSPACE_DH_CHAIN_HPP
@@ -0,0 +1,187 @@
+/**
+ * Integer lattice helpers shared by the workspace tools.
+ */
+#ifndef WORKSPACE_LATTICE_HPP
+#define WORKSPACE_LATTICE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <geometry_msgs/Point.h>
+
+namespace workspace
+{
+    /**
+     * Regular grid `origin + resolution * (i, j, k)` clipped to an axis-aligned box.
+     * Every lattice point inside the box has a dense linear key in [0, size()).
+     */
+    class Lattice
+    {
+    public:
+        struct Index
+        {
+            int i;
+            int j;
+            int k;
+        };
+
+        Lattice() {}
+        Lattice(
+            const geometry_msgs::Point &origin,
+            const double resolution,
+            const double (&box_min)[3],
+            const double (&box_max)[3])
+            : origin_(origin), resolution_(resolution)
+        {
+            const double o[3] = {origin.x, origin.y, origin.z};
+            for (int a = 0; a < 3; a++)
+            {
+                min_[a] = (int)std::ceil((box_min[a] - o[a]) / resolution - 1e-9);
+                const int max = (int)std::floor((box_max[a] - o[a]) / resolution + 1e-9);
+                dims_[a] = (max >= min_[a]) ? (max - min_[a] + 1) : 0;
+            }
+        }
+
+        // Lattice covering the index range [min, max] (inclusive)
+        Lattice(
+            const geometry_msgs::Point &origin,
+            const double resolution,
+            const Index &min,
+            const Index &max)
+            : origin_(origin), resolution_(resolution)
+        {
+            min_[0] = min.i;
+            min_[1] = min.j;
+            min_[2] = min.k;
+            dims_[0] = (max.i >= min.i) ? (max.i - min.i + 1) : 0;
+            dims_[1] = (max.j >= min.j) ? (max.j - min.j + 1) : 0;
+            dims_[2] = (max.k >= min.k) ? (max.k - min.k + 1) : 0;
+        }
+
+        const geometry_msgs::Point &getOrigin() const { return origin_; }
+        double getResolution() const { return resolution_; }
+        const int *getMinIndex() const { return min_; }
+        const int *getDims() const { return dims_; }
+        std::size_t size() const { return (std::size_t)dims_[0] * dims_[1] * dims_[2]; }
+
+        bool contains(const Index &idx) const
+        {
+            return ((unsigned)(idx.i - min_[0]) < (unsigned)dims_[0]) &&
+                   ((unsigned)(idx.j - min_[1]) < (unsigned)dims_[1]) &&
+                   ((unsigned)(idx.k - min_[2]) < (unsigned)dims_[2]);
+        }
+
+        // Only valid if contains(idx)
+        std::size_t key(const Index &idx) const
+        {
+            return (std::size_t)(idx.i - min_[0]) +
+                   (std::size_t)dims_[0] * ((std::size_t)(idx.j - min_[1]) +
+                                            (std::size_t)dims_[1] * (std::size_t)(idx.k - min_[2]));
+        }
+
+        Index index(std::size_t key) const
+        {
+            Index idx;
+            idx.i = (int)(key % dims_[0]) + min_[0];
+            key /= dims_[0];
+            idx.j = (int)(key % dims_[1]) + min_[1];
+            idx.k = (int)(key / dims_[1]) + min_[2];
+            return idx;
+        }
+
+        geometry_msgs::Point point(const Index &idx) const
+        {
+            geometry_msgs::Point p;
+            p.x = origin_.x + resolution_ * idx.i;
+            p.y = origin_.y + resolution_ * idx.j;
+            p.z = origin_.z + resolution_ * idx.k;
+            return p;
+        }
+
+        // Closest lattice point (may lie outside the box)
+        Index nearest(const geometry_msgs::Point &p) const
+        {
+            Index idx;
+            idx.i = (int)std::lround((p.x - origin_.x) / resolution_);
+            idx.j = (int)std::lround((p.y - origin_.y) / resolution_);
+            idx.k = (int)std::lround((p.z - origin_.z) / resolution_);
+            return idx;
+        }
+
+    private:
+        geometry_msgs::Point origin_;
+        double resolution_ = 1.0;
+        int min_[3] = {0, 0, 0};
+        int dims_[3] = {0, 0, 0};
+    };
+
+    /**
+     * One bit per lattice key.
+     */
+    class DenseBitset
+    {
+    public:
+        DenseBitset() {}
+        explicit DenseBitset(const std::size_t size) : words_((size + 63) / 64, 0) {}
+        explicit DenseBitset(std::vector<uint64_t> words) : words_(std::move(words)) {}
+
+        bool test(const std::size_t key) const { return (words_[key >> 6] >> (key & 63)) & 1; }
+        void set(const std::size_t key) { words_[key >> 6] |= (uint64_t(1) << (key & 63)); }
+        void reset(const std::size_t key) { words_[key >> 6] &= ~(uint64_t(1) << (key & 63)); }
+
+        // Set the bit and return its previous value
+        bool testAndSet(const std::size_t key)
+        {
+            const uint64_t mask = uint64_t(1) << (key & 63);
+            const bool was_set = words_[key >> 6] & mask;
+            words_[key >> 6] |= mask;
+            return was_set;
+        }
+
+        const std::vector<uint64_t> &words() const { return words_; }
+
+    private:
+        std::vector<uint64_t> words_;
+    };
+
+    /**
+     * DenseBitset that several threads can set concurrently.
+     */
+    class AtomicBitset
+    {
+    public:
+        explicit AtomicBitset(const std::size_t size)
+            : num_words_((size + 63) / 64), words_(new std::atomic<uint64_t>[num_words_])
+        {
+            for (std::size_t w = 0; w < num_words_; w++) { words_[w].store(0, std::memory_order_relaxed); }
+        }
+
+        bool test(const std::size_t key) const
+        {
+            return (words_[key >> 6].load(std::memory_order_relaxed) >> (key & 63)) & 1;
+        }
+
+        // Set the bit and return its previous value (exactly one caller sees false)
+        bool testAndSet(const std::size_t key)
+        {
+            const uint64_t mask = uint64_t(1) << (key & 63);
+            if (words_[key >> 6].load(std::memory_order_relaxed) & mask) { return true; }  // Skip the RMW on hot words
+            return words_[key >> 6].fetch_or(mask, std::memory_order_relaxed) & mask;
+        }
+
+        DenseBitset snapshot() const
+        {
+            std::vector<uint64_t> words(num_words_);
+            for (std::size_t w = 0; w < num_words_; w++) { words[w] = words_[w].load(std::memory_order_relaxed); }
+            return DenseBitset(std::move(words));
+        }
+
+    private:
+        const std::size_t num_words_;
+        std::unique_ptr<std::atomic<uint64_t>[]> words_;
+    };
+}
+
+#endif // WORKSPACE_LATTICE_HPP
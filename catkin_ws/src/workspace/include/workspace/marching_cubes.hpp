@@ -0,0 +1,358 @@
+/**
+ * Marching cubes on the binary corner masks of the octree leaves.
+ *
+ * Corners follow Octree::Cube: ba(---) bb(+--) bc(++-) bd(-+-) ta(--+) tb(+-+) tc(+++) td(-++)
+ * and a mask is 0b {ba bb bc bd} {ta tb tc td} (bit set = IK solution found).
+ * Since the corner values are binary, every vertex is the midpoint of its edge.
+ */
+#ifndef WORKSPACE_MARCHING_CUBES_HPP
+#define WORKSPACE_MARCHING_CUBES_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <geometry_msgs/Point.h>
+
+namespace workspace
+{
+    /**
+     * Edge e connects corners MC_EDGE_CORNERS[e] (corner index 0..7 = ba..td).
+     *     bottom: 0 ba-bb, 1 bb-bc, 2 bc-bd, 3 bd-ba
+     *     top   : 4 ta-tb, 5 tb-tc, 6 tc-td, 7 td-ta
+     *     side  : 8 ba-ta, 9 bb-tb, 10 bc-tc, 11 bd-td
+     */
+    static const uint8_t MC_EDGE_CORNERS[12][2] = {
+        {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+    // Corner offsets in cube widths
+    static const uint8_t MC_CORNER_OFFSETS[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+
+    /**
+     * Triangles of each mask as edge triplets, terminated by -1, with normals pointing
+     * from the reachable corners to the unreachable ones.
+     * Generated by tracing the contour over the 6 faces; on an ambiguous face the reachable
+     * corners are kept apart. Neighbouring cubes decide a shared face the same way,
+     * so the surface has no cracks.
+     */
+    static const int8_t MC_TRIANGLES[256][16] = {
+        {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11, 10,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 9,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 9,  6, 10,  9,  4,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  9,  4, 11, 10,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  6,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  5,  4, 11, 10,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  9,  8,  7,  5,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  9,  8, 11,  5,  9, 11,  6,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  9,  8,  7, 10,  9,  7,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  9,  8, 11, 10,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3,  2,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  5,  7,  3, 10,  5,  3,  2, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3,  2,  6,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11,  9,  6, 10,  9,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  7,  3,  9,  4,  3, 10,  9,  3,  2, 10, -1, -1, -1, -1},
+        { 7,  4,  8,  3,  2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  6,  4,  3,  2,  6, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  3,  2, 11,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  5,  4,  3, 10,  5,  3,  2, 10, -1, -1, -1, -1},
+        { 7,  9,  8,  7,  5,  9,  3,  2, 11, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  9,  8,  3,  5,  9,  3,  6,  5,  3,  2,  6, -1, -1, -1, -1},
+        { 7,  9,  8,  7, 10,  9,  7,  6, 10,  3,  2, 11, -1, -1, -1, -1},
+        { 3,  9,  8,  3, 10,  9,  3,  2, 10, -1, -1, -1, -1, -1, -1, -1},
+        {10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 5,  2,  1,  5,  6,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11,  1,  5, 11,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        {10,  2,  1,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7, 10,  2,  1,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 9,  2,  1,  9,  6,  2,  9,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  9,  4, 11,  1,  9, 11,  2,  1, -1, -1, -1, -1},
+        { 7,  4,  8, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  6,  4, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  5,  2,  1,  5,  6,  2, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  5,  4, 11,  1,  5, 11,  2,  1, -1, -1, -1, -1},
+        { 7,  9,  8,  7,  5,  9, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  9,  8, 11,  5,  9, 11,  6,  5, 10,  2,  1, -1, -1, -1, -1},
+        { 7,  9,  8,  7,  1,  9,  7,  2,  1,  7,  6,  2, -1, -1, -1, -1},
+        {11,  9,  8, 11,  1,  9, 11,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 3, 10, 11,  3,  1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3, 10,  6,  3,  1, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6, 11,  3,  5,  6,  3,  1,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  5,  7,  3,  1,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3, 10, 11,  3,  1, 10,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3, 10,  6,  3,  1, 10,  9,  4,  5, -1, -1, -1, -1},
+        { 3,  6, 11,  3,  4,  6,  3,  9,  4,  3,  1,  9, -1, -1, -1, -1},
+        { 3,  4,  7,  3,  9,  4,  3,  1,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  3, 10, 11,  3,  1, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  6,  4,  3, 10,  6,  3,  1, 10, -1, -1, -1, -1},
+        { 7,  4,  8,  3,  6, 11,  3,  5,  6,  3,  1,  5, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  5,  4,  3,  1,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  9,  8,  7,  5,  9,  3, 10, 11,  3,  1, 10, -1, -1, -1, -1},
+        { 3,  9,  8,  3,  5,  9,  3,  6,  5,  3, 10,  6,  3,  1, 10, -1},
+        { 7,  9,  8,  7,  1,  9,  7,  3,  1,  7, 11,  3,  7,  6, 11, -1},
+        { 3,  9,  8,  3,  1,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 1,  0,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 1,  0,  9,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11, 10,  5,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 1,  4,  5,  1,  0,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  1,  4,  5,  1,  0,  4, -1, -1, -1, -1, -1, -1, -1},
+        { 1,  6, 10,  1,  4,  6,  1,  0,  4, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  0,  4, 11,  1,  0, 11, 10,  1, -1, -1, -1, -1},
+        { 7,  4,  8,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  6,  4,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  1,  0,  9,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  5,  4, 11, 10,  5,  1,  0,  9, -1, -1, -1, -1},
+        { 7,  0,  8,  7,  1,  0,  7,  5,  1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  8, 11,  1,  0, 11,  5,  1, 11,  6,  5, -1, -1, -1, -1},
+        { 7,  0,  8,  7,  1,  0,  7, 10,  1,  7,  6, 10, -1, -1, -1, -1},
+        {11,  0,  8, 11,  1,  0, 11, 10,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3,  2,  6,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  2, 11,  1,  0,  9,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  5,  7,  3, 10,  5,  3,  2, 10,  1,  0,  9, -1, -1, -1, -1},
+        { 3,  2, 11,  1,  4,  5,  1,  0,  4, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3,  2,  6,  1,  4,  5,  1,  0,  4, -1, -1, -1, -1},
+        { 3,  2, 11,  1,  6, 10,  1,  4,  6,  1,  0,  4, -1, -1, -1, -1},
+        { 3,  4,  7,  3,  0,  4,  3,  1,  0,  3, 10,  1,  3,  2, 10, -1},
+        { 7,  4,  8,  3,  2, 11,  1,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  6,  4,  3,  2,  6,  1,  0,  9, -1, -1, -1, -1},
+        { 7,  4,  8,  3,  2, 11,  1,  0,  9,  5,  6, 10, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  5,  4,  3, 10,  5,  3,  2, 10,  1,  0,  9, -1},
+        { 7,  0,  8,  7,  1,  0,  7,  5,  1,  3,  2, 11, -1, -1, -1, -1},
+        { 3,  0,  8,  3,  1,  0,  3,  5,  1,  3,  6,  5,  3,  2,  6, -1},
+        { 7,  0,  8,  7,  1,  0,  7, 10,  1,  7,  6, 10,  3,  2, 11, -1},
+        { 3,  0,  8,  3,  1,  0,  3, 10,  1,  3,  2, 10, -1, -1, -1, -1},
+        {10,  0,  9, 10,  2,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7, 10,  0,  9, 10,  2,  0, -1, -1, -1, -1, -1, -1, -1},
+        { 5,  0,  9,  5,  2,  0,  5,  6,  2, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11,  9,  5, 11,  0,  9, 11,  2,  0, -1, -1, -1, -1},
+        {10,  4,  5, 10,  0,  4, 10,  2,  0, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7, 10,  4,  5, 10,  0,  4, 10,  2,  0, -1, -1, -1, -1},
+        { 4,  2,  0,  4,  6,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  0,  4, 11,  2,  0, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8, 10,  0,  9, 10,  2,  0, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  8, 11,  6,  4, 10,  0,  9, 10,  2,  0, -1, -1, -1, -1},
+        { 7,  4,  8,  5,  0,  9,  5,  2,  0,  5,  6,  2, -1, -1, -1, -1},
+        {11,  4,  8, 11,  5,  4, 11,  9,  5, 11,  0,  9, 11,  2,  0, -1},
+        { 7,  0,  8,  7,  2,  0,  7, 10,  2,  7,  5, 10, -1, -1, -1, -1},
+        {11,  0,  8, 11,  2,  0, 11, 10,  2, 11,  5, 10, 11,  6,  5, -1},
+        { 7,  0,  8,  7,  2,  0,  7,  6,  2, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  8, 11,  2,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 3, 10, 11,  3,  9, 10,  3,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  6,  7,  3, 10,  6,  3,  9, 10,  3,  0,  9, -1, -1, -1, -1},
+        { 3,  6, 11,  3,  5,  6,  3,  9,  5,  3,  0,  9, -1, -1, -1, -1},
+        { 3,  5,  7,  3,  9,  5,  3,  0,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 3, 10, 11,  3,  5, 10,  3,  4,  5,  3,  0,  4, -1, -1, -1, -1},
+        { 3,  6,  7,  3, 10,  6,  3,  5, 10,  3,  4,  5,  3,  0,  4, -1},
+        { 3,  6, 11,  3,  4,  6,  3,  0,  4, -1, -1, -1, -1, -1, -1, -1},
+        { 3,  4,  7,  3,  0,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  4,  8,  3, 10, 11,  3,  9, 10,  3,  0,  9, -1, -1, -1, -1},
+        { 3,  4,  8,  3,  6,  4,  3, 10,  6,  3,  9, 10,  3,  0,  9, -1},
+        { 7,  4,  8,  3,  6, 11,  3,  5,  6,  3,  9,  5,  3,  0,  9, -1},
+        { 3,  4,  8,  3,  5,  4,  3,  9,  5,  3,  0,  9, -1, -1, -1, -1},
+        { 7,  0,  8,  7,  3,  0,  7, 11,  3,  7, 10, 11,  7,  5, 10, -1},
+        { 3,  0,  8, 10,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  0,  8,  7,  3,  0,  7, 11,  3,  7,  6, 11, -1, -1, -1, -1},
+        { 3,  0,  8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  0,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11, 10,  5,  8,  0,  3, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  0,  3,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3,  9,  6, 10,  9,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  9,  4, 11, 10,  9,  8,  0,  3, -1, -1, -1, -1},
+        { 7,  0,  3,  7,  4,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  3, 11,  4,  0, 11,  6,  4, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  0,  3,  7,  4,  0,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  3, 11,  4,  0, 11,  5,  4, 11, 10,  5, -1, -1, -1, -1},
+        { 7,  0,  3,  7,  9,  0,  7,  5,  9, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  3, 11,  9,  0, 11,  5,  9, 11,  6,  5, -1, -1, -1, -1},
+        { 7,  0,  3,  7,  9,  0,  7, 10,  9,  7,  6, 10, -1, -1, -1, -1},
+        {11,  0,  3, 11,  9,  0, 11, 10,  9, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  0,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8,  2,  6,  8,  0,  2, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  0,  2,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  5,  7,  8, 10,  5,  8,  2, 10,  8,  0,  2, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  0,  2,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8,  2,  6,  8,  0,  2,  9,  4,  5, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  0,  2,  9,  6, 10,  9,  4,  6, -1, -1, -1, -1},
+        { 8,  4,  7,  8,  9,  4,  8, 10,  9,  8,  2, 10,  8,  0,  2, -1},
+        { 7,  2, 11,  7,  0,  2,  7,  4,  0, -1, -1, -1, -1, -1, -1, -1},
+        { 0,  6,  4,  0,  2,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  0,  2,  7,  4,  0,  5,  6, 10, -1, -1, -1, -1},
+        { 5,  2, 10,  5,  0,  2,  5,  4,  0, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  0,  2,  7,  9,  0,  7,  5,  9, -1, -1, -1, -1},
+        { 9,  6,  5,  9,  2,  6,  9,  0,  2, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  0,  2,  7,  9,  0,  7, 10,  9,  7,  6, 10, -1},
+        { 9,  2, 10,  9,  0,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  0,  3, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  0,  3,  5,  2,  1,  5,  6,  2, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11,  1,  5, 11,  2,  1,  8,  0,  3, -1, -1, -1, -1},
+        { 8,  0,  3, 10,  2,  1,  9,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  0,  3, 10,  2,  1,  9,  4,  5, -1, -1, -1, -1},
+        { 8,  0,  3,  9,  2,  1,  9,  6,  2,  9,  4,  6, -1, -1, -1, -1},
+        {11,  4,  7, 11,  9,  4, 11,  1,  9, 11,  2,  1,  8,  0,  3, -1},
+        { 7,  0,  3,  7,  4,  0, 10,  2,  1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  0,  3, 11,  4,  0, 11,  6,  4, 10,  2,  1, -1, -1, -1, -1},
+        { 7,  0,  3,  7,  4,  0,  5,  2,  1,  5,  6,  2, -1, -1, -1, -1},
+        {11,  0,  3, 11,  4,  0, 11,  5,  4, 11,  1,  5, 11,  2,  1, -1},
+        { 7,  0,  3,  7,  9,  0,  7,  5,  9, 10,  2,  1, -1, -1, -1, -1},
+        {11,  0,  3, 11,  9,  0, 11,  5,  9, 11,  6,  5, 10,  2,  1, -1},
+        { 7,  0,  3,  7,  9,  0,  7,  1,  9,  7,  2,  1,  7,  6,  2, -1},
+        {11,  0,  3, 11,  9,  0, 11,  1,  9, 11,  2,  1, -1, -1, -1, -1},
+        { 8, 10, 11,  8,  1, 10,  8,  0,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8, 10,  6,  8,  1, 10,  8,  0,  1, -1, -1, -1, -1},
+        { 8,  6, 11,  8,  5,  6,  8,  1,  5,  8,  0,  1, -1, -1, -1, -1},
+        { 8,  5,  7,  8,  1,  5,  8,  0,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 8, 10, 11,  8,  1, 10,  8,  0,  1,  9,  4,  5, -1, -1, -1, -1},
+        { 8,  6,  7,  8, 10,  6,  8,  1, 10,  8,  0,  1,  9,  4,  5, -1},
+        { 8,  6, 11,  8,  4,  6,  8,  9,  4,  8,  1,  9,  8,  0,  1, -1},
+        { 8,  4,  7,  8,  9,  4,  8,  1,  9,  8,  0,  1, -1, -1, -1, -1},
+        { 7, 10, 11,  7,  1, 10,  7,  0,  1,  7,  4,  0, -1, -1, -1, -1},
+        {10,  0,  1, 10,  4,  0, 10,  6,  4, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  6, 11,  7,  5,  6,  7,  1,  5,  7,  0,  1,  7,  4,  0, -1},
+        { 5,  0,  1,  5,  4,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7, 10, 11,  7,  1, 10,  7,  0,  1,  7,  9,  0,  7,  5,  9, -1},
+        {10,  0,  1, 10,  9,  0, 10,  5,  9, 10,  6,  5, -1, -1, -1, -1},
+        { 7,  6, 11,  9,  0,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 9,  0,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  1,  3,  8,  9,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  1,  3,  8,  9,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  1,  3,  8,  9,  1,  5,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  5,  7, 11, 10,  5,  8,  1,  3,  8,  9,  1, -1, -1, -1, -1},
+        { 8,  1,  3,  8,  5,  1,  8,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  1,  3,  8,  5,  1,  8,  4,  5, -1, -1, -1, -1},
+        { 8,  1,  3,  8, 10,  1,  8,  6, 10,  8,  4,  6, -1, -1, -1, -1},
+        {11,  4,  7, 11,  8,  4, 11,  3,  8, 11,  1,  3, 11, 10,  1, -1},
+        { 7,  1,  3,  7,  9,  1,  7,  4,  9, -1, -1, -1, -1, -1, -1, -1},
+        {11,  1,  3, 11,  9,  1, 11,  4,  9, 11,  6,  4, -1, -1, -1, -1},
+        { 7,  1,  3,  7,  9,  1,  7,  4,  9,  5,  6, 10, -1, -1, -1, -1},
+        {11,  1,  3, 11,  9,  1, 11,  4,  9, 11,  5,  4, 11, 10,  5, -1},
+        { 7,  1,  3,  7,  5,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  1,  3, 11,  5,  1, 11,  6,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  1,  3,  7, 10,  1,  7,  6, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  1,  3, 11, 10,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  1,  2,  8,  9,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8,  2,  6,  8,  1,  2,  8,  9,  1, -1, -1, -1, -1},
+        { 8,  2, 11,  8,  1,  2,  8,  9,  1,  5,  6, 10, -1, -1, -1, -1},
+        { 8,  5,  7,  8, 10,  5,  8,  2, 10,  8,  1,  2,  8,  9,  1, -1},
+        { 8,  2, 11,  8,  1,  2,  8,  5,  1,  8,  4,  5, -1, -1, -1, -1},
+        { 8,  6,  7,  8,  2,  6,  8,  1,  2,  8,  5,  1,  8,  4,  5, -1},
+        { 8,  2, 11,  8,  1,  2,  8, 10,  1,  8,  6, 10,  8,  4,  6, -1},
+        { 8,  4,  7,  1,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  1,  2,  7,  9,  1,  7,  4,  9, -1, -1, -1, -1},
+        { 1,  4,  9,  1,  6,  4,  1,  2,  6, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  1,  2,  7,  9,  1,  7,  4,  9,  5,  6, 10, -1},
+        { 1,  4,  9,  1,  5,  4,  1, 10,  5,  1,  2, 10, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  1,  2,  7,  5,  1, -1, -1, -1, -1, -1, -1, -1},
+        { 1,  6,  5,  1,  2,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2, 11,  7,  1,  2,  7, 10,  1,  7,  6, 10, -1, -1, -1, -1},
+        { 1,  2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  2,  3,  8, 10,  2,  8,  9, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  6,  7,  8,  2,  3,  8, 10,  2,  8,  9, 10, -1, -1, -1, -1},
+        { 8,  2,  3,  8,  6,  2,  8,  5,  6,  8,  9,  5, -1, -1, -1, -1},
+        {11,  5,  7, 11,  9,  5, 11,  8,  9, 11,  3,  8, 11,  2,  3, -1},
+        { 8,  2,  3,  8, 10,  2,  8,  5, 10,  8,  4,  5, -1, -1, -1, -1},
+        {11,  6,  7,  8,  2,  3,  8, 10,  2,  8,  5, 10,  8,  4,  5, -1},
+        { 8,  2,  3,  8,  6,  2,  8,  4,  6, -1, -1, -1, -1, -1, -1, -1},
+        {11,  4,  7, 11,  8,  4, 11,  3,  8, 11,  2,  3, -1, -1, -1, -1},
+        { 7,  2,  3,  7, 10,  2,  7,  9, 10,  7,  4,  9, -1, -1, -1, -1},
+        {11,  2,  3, 11, 10,  2, 11,  9, 10, 11,  4,  9, 11,  6,  4, -1},
+        { 7,  2,  3,  7,  6,  2,  7,  5,  6,  7,  9,  5,  7,  4,  9, -1},
+        {11,  2,  3,  5,  4,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  2,  3,  7, 10,  2,  7,  5, 10, -1, -1, -1, -1, -1, -1, -1},
+        {11,  2,  3, 11, 10,  2, 11,  5, 10, 11,  6,  5, -1, -1, -1, -1},
+        { 7,  2,  3,  7,  6,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {11,  2,  3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8, 10, 11,  8,  9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8, 10,  6,  8,  9, 10, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6, 11,  8,  5,  6,  8,  9,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  5,  7,  8,  9,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8, 10, 11,  8,  5, 10,  8,  4,  5, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  6,  7,  8, 10,  6,  8,  5, 10,  8,  4,  5, -1, -1, -1, -1},
+        { 8,  6, 11,  8,  4,  6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 8,  4,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7, 10, 11,  7,  9, 10,  7,  4,  9, -1, -1, -1, -1, -1, -1, -1},
+        {10,  4,  9, 10,  6,  4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  6, 11,  7,  5,  6,  7,  9,  5,  7,  4,  9, -1, -1, -1, -1},
+        { 5,  4,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7, 10, 11,  7,  5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {10,  6,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        { 7,  6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+        {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
+    };
+
+    /**
+     * Emit the triangles of one cube as `emit(p0, p1, p2)`.
+     * `anchor` is the ba corner and `width` the edge length.
+     */
+    template <typename Emit>
+    inline int marchCube(const uint8_t eight_iks, const geometry_msgs::Point &anchor, const double width, Emit emit)
+    {
+        auto vertex = [&](const int edge)
+        {
+            const uint8_t *a = MC_CORNER_OFFSETS[MC_EDGE_CORNERS[edge][0]];
+            const uint8_t *b = MC_CORNER_OFFSETS[MC_EDGE_CORNERS[edge][1]];
+            geometry_msgs::Point p;
+            p.x = anchor.x + 0.5 * (a[0] + b[0]) * width;
+            p.y = anchor.y + 0.5 * (a[1] + b[1]) * width;
+            p.z = anchor.z + 0.5 * (a[2] + b[2]) * width;
+            return p;
+        };
+        const int8_t *edges = MC_TRIANGLES[eight_iks];
+        int num_triangles = 0;
+        for (; edges[0] >= 0; edges += 3, num_triangles++)
+        {
+            emit(vertex(edges[0]), vertex(edges[1]), vertex(edges[2]));
+        }
+        return num_triangles;
+    }
+
+    /**
+     * Binary STL of a triangle list (3 consecutive points per triangle).
+     */
+    inline bool saveMeshSTL(const std::string &path, const std::vector<geometry_msgs::Point> &vertices)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) { return false; }
+        char header[80] = "reachable workspace";
+        out.write(header, sizeof(header));
+        const uint32_t num_triangles = vertices.size() / 3;
+        out.write(reinterpret_cast<const char *>(&num_triangles), sizeof(num_triangles));
+        for (uint32_t t = 0; t < num_triangles; t++)
+        {
+            const geometry_msgs::Point &a = vertices[3 * t];
+            const geometry_msgs::Point &b = vertices[3 * t + 1];
+            const geometry_msgs::Point &c = vertices[3 * t + 2];
+            const double u[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+            const double v[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+            float record[12] = {
+                (float)(u[1] * v[2] - u[2] * v[1]), (float)(u[2] * v[0] - u[0] * v[2]), (float)(u[0] * v[1] - u[1] * v[0]),
+                (float)a.x, (float)a.y, (float)a.z,
+                (float)b.x, (float)b.y, (float)b.z,
+                (float)c.x, (float)c.y, (float)c.z};
+            const float norm = std::sqrt(record[0] * record[0] + record[1] * record[1] + record[2] * record[2]);
+            if (norm > 0) { record[0] /= norm; record[1] /= norm; record[2] /= norm; }
+            const uint16_t attributes = 0;
+            out.write(reinterpret_cast<const char *>(record), sizeof(record));
+            out.write(reinterpret_cast<const char *>(&attributes), sizeof(attributes));
+        }
+        return (bool)out;
+    }
+}
+
+#endif // WORKSPACE_MARCHING_CUBES_HPP
@@ -0,0 +1,197 @@
+/**
+ * Background marker publisher: compute loops queue markers and never wait for RViz.
+ */
+#ifndef WORKSPACE_MARKER_PUBLISHER_HPP
+#define WORKSPACE_MARKER_PUBLISHER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <ros/ros.h>
+#include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
+
+namespace workspace
+{
+    /**
+     * Bounded marker queue drained by its own thread: every 1/rate seconds, up to batch_size
+     * queued markers go out as one MarkerArray.
+     *  - A marker whose (ns, id) is still queued replaces it in place (the latest pose wins).
+     *  - A DELETEALL drops everything queued before it.
+     *  - A full queue drops its oldest marker (DROP_OLDEST) or every other queued ADD (DECIMATE),
+     *    so the producer only ever takes a short lock.
+     */
+    class MarkerPublisher
+    {
+    public:
+        enum Overflow
+        {
+            DROP_OLDEST,
+            DECIMATE
+        };
+
+        struct Options
+        {
+            Options() : batch_size(512), rate(20.0), capacity(16384), overflow(DECIMATE) {}
+
+            std::size_t batch_size;  // Markers per MarkerArray
+            double rate;             // [Hz] MarkerArrays
+            std::size_t capacity;    // Queued markers
+            Overflow overflow;
+        };
+
+        MarkerPublisher(ros::NodeHandle &nh, const std::string &topic, const Options &options = Options())
+            : options_(options), front_seq_(0), dropped_(0), coalesced_(0), published_(0), stop_(false)
+        {
+            if (options_.batch_size < 1) { options_.batch_size = 1; }
+            if (options_.capacity < 2) { options_.capacity = 2; }
+            if (!(options_.rate > 0.0)) { options_.rate = Options().rate; }
+            pub_ = nh.advertise<visualization_msgs::MarkerArray>(topic, 1);
+            thread_ = std::thread(&MarkerPublisher::run, this);
+        }
+
+        ~MarkerPublisher()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+
+        void publish(visualization_msgs::Marker marker)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (marker.action == visualization_msgs::Marker::DELETEALL)
+            {
+                front_seq_ += queue_.size();
+                queue_.clear();
+                index_.clear();
+                queue_.push_back(std::move(marker));
+                return;
+            }
+            const Key key(marker.ns, marker.id);
+            const auto it = index_.find(key);
+            if (it != index_.end())
+            {
+                queue_[it->second - front_seq_] = std::move(marker);
+                coalesced_++;
+                return;
+            }
+            if (queue_.size() >= options_.capacity) { makeRoom(); }
+            index_[key] = front_seq_ + queue_.size();
+            queue_.push_back(std::move(marker));
+        }
+
+        void deleteAll()
+        {
+            visualization_msgs::Marker marker;
+            marker.action = visualization_msgs::Marker::DELETEALL;
+            publish(std::move(marker));
+        }
+
+        // Block until every queued marker is handed to ROS, false after `timeout` [sec]
+        bool flush(double timeout)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            return drained_.wait_for(lock, std::chrono::duration<double>(timeout), [this]{ return queue_.empty(); });
+        }
+
+        std::size_t getQueued() const { std::lock_guard<std::mutex> lock(mutex_); return queue_.size(); }
+        std::size_t getDropped() const { std::lock_guard<std::mutex> lock(mutex_); return dropped_; }
+        std::size_t getCoalesced() const { std::lock_guard<std::mutex> lock(mutex_); return coalesced_; }
+        std::size_t getPublished() const { std::lock_guard<std::mutex> lock(mutex_); return published_; }
+
+    private:
+        typedef std::pair<std::string, int> Key;
+
+        // Called with the lock held on a full queue
+        void makeRoom()
+        {
+            if (options_.overflow == DROP_OLDEST)
+            {
+                popFront();
+                dropped_++;
+                return;
+            }
+            // Keep the odd ADDs (the newest one of each pair) and every DELETE
+            std::deque<visualization_msgs::Marker> kept;
+            for (std::size_t i = 0; i < queue_.size(); i++)
+            {
+                if (i % 2 == 1 || queue_[i].action != visualization_msgs::Marker::ADD)
+                {
+                    kept.push_back(std::move(queue_[i]));
+                }
+            }
+            dropped_ += queue_.size() - kept.size();
+            queue_.swap(kept);
+            index_.clear();
+            for (std::size_t i = 0; i < queue_.size(); i++)
+            {
+                if (queue_[i].action != visualization_msgs::Marker::DELETEALL)
+                {
+                    index_[Key(queue_[i].ns, queue_[i].id)] = front_seq_ + i;
+                }
+            }
+        }
+
+        // Moves the oldest marker to `out` if not null
+        void popFront(visualization_msgs::Marker *out = nullptr)
+        {
+            visualization_msgs::Marker &front = queue_.front();
+            const auto it = index_.find(Key(front.ns, front.id));
+            if (it != index_.end() && it->second == front_seq_) { index_.erase(it); }
+            if (out != nullptr) { *out = std::move(front); }
+            queue_.pop_front();
+            front_seq_++;
+        }
+
+        void run()
+        {
+            const auto period = std::chrono::duration<double>(1.0 / options_.rate);
+            visualization_msgs::MarkerArray array;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stop_)
+            {
+                wake_.wait_for(lock, period, [this]{ return stop_; });
+                if (stop_) { break; }
+                array.markers.clear();
+                while (!queue_.empty() && array.markers.size() < options_.batch_size)
+                {
+                    array.markers.emplace_back();
+                    popFront(&array.markers.back());
+                }
+                if (queue_.empty()) { drained_.notify_all(); }
+                if (array.markers.empty()) { continue; }
+
+                // Serialization happens outside of the lock, producers keep queueing
+                published_ += array.markers.size();
+                lock.unlock();
+                pub_.publish(array);
+                lock.lock();
+            }
+        }
+
+        Options options_;
+        ros::Publisher pub_;
+        std::deque<visualization_msgs::Marker> queue_;
+        std::map<Key, std::size_t> index_;  // Sequence number of each queued (ns, id)
+        std::size_t front_seq_;             // Sequence number of queue_.front()
+        std::size_t dropped_;
+        std::size_t coalesced_;
+        std::size_t published_;
+        bool stop_;
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable drained_;
+        std::thread thread_;
+    };
+}
+
+#endif // WORKSPACE_MARKER_PUBLISHER_HPP
@@ -0,0 +1,188 @@
+/**
+ * Octree refinement cubes of the reachable workspace search (reachable_ws_ik).
+ *
+ * A cube lives on the probe lattice of a ReachabilityCache and keeps the IK result of its
+ * 8 corners. Splitting it probes the 19 new points of its 3x3x3 grid and pushes the 8
+ * children. The IK is a `check(Index) -> bool` callable, so the probe pattern does not
+ * depend on MoveIt.
+ */
+#ifndef WORKSPACE_OCTREE_HPP
+#define WORKSPACE_OCTREE_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "workspace/lattice.hpp"
+
+namespace Octree
+{
+    inline unsigned char makeEightIKs(
+        const std::bitset<27> &checkpoints,
+        const std::size_t ba_index,
+        const std::size_t bb_index,
+        const std::size_t bc_index,
+        const std::size_t bd_index,
+        const std::size_t ta_index,
+        const std::size_t tb_index,
+        const std::size_t tc_index,
+        const std::size_t td_index)
+    {
+        /**
+         * { ba, bb, bc, bd, ta, tb, tc, td } eight_iks
+         *    7,  6,  5,  4,  3,  2,  1,  0   => Required shift
+         */
+        return (checkpoints[ba_index] << 7) |
+               (checkpoints[bb_index] << 6) |
+               (checkpoints[bc_index] << 5) |
+               (checkpoints[bd_index] << 4) |
+               (checkpoints[ta_index] << 3) |
+               (checkpoints[tb_index] << 2) |
+               (checkpoints[tc_index] << 1) |
+               checkpoints[td_index];
+    }
+
+    inline unsigned char makeEightIKs(
+        const bool ba, const bool bb, const bool bc, const bool bd,
+        const bool ta, const bool tb, const bool tc, const bool td)
+    {
+        return (ba << 7) | (bb << 6) | (bc << 5) | (bd << 4) | (ta << 3) | (tb << 2) | (tc << 1) | td;
+    }
+
+    using Index = workspace::Lattice::Index;
+
+    /**
+     * Plain-old-data cube on the probe lattice of the IK cache (spacing dfs_resolution / 2^depth).
+     * A level-0 cube is a DFS cube, its width is 2^depth probe steps. Every split halves it.
+     */
+    class Cube
+    {
+    public:
+        Cube() = default;
+
+        void init(
+            const Index &anchor,
+            const uint8_t level,
+            const unsigned char eight_iks)
+        {
+            anchor_[0] = anchor.i;
+            anchor_[1] = anchor.j;
+            anchor_[2] = anchor.k;
+            level_ = level;
+            eight_iks_ = eight_iks;
+        }
+
+        // Probe the 8 corners with `check(Index) -> bool`
+        template <typename ProbeCheck>
+        void init(
+            const Index &anchor,
+            const uint8_t level,
+            const int depth,
+            ProbeCheck &check)
+        {
+            const int w = 1 << (depth - level);
+            const int i = anchor.i, j = anchor.j, k = anchor.k;
+            init(anchor, level, makeEightIKs(
+                check(Index{i,     j,     k    }),   // ba
+                check(Index{i + w, j,     k    }),   // bb
+                check(Index{i + w, j + w, k    }),   // bc
+                check(Index{i,     j + w, k    }),   // bd
+                check(Index{i,     j,     k + w}),   // ta
+                check(Index{i + w, j,     k + w}),   // tb
+                check(Index{i + w, j + w, k + w}),   // tc
+                check(Index{i,     j + w, k + w}))); // td
+        }
+
+        Index getAnchor() const { return Index{anchor_[0], anchor_[1], anchor_[2]}; }
+        uint8_t getLevel() const { return level_; }
+        int getWidth(const int depth) const { return 1 << (depth - level_); }  // In probe steps
+        unsigned char getEightIks() const { return eight_iks_; }
+
+        bool isUseful() const
+        {
+            // 0xFF: Every corner has a solution.
+            // 0x00: Every corner has no solution.
+            return (eight_iks_) && (eight_iks_ != 0xFF);
+        }
+
+        // Push the 8 children onto `openlist` (the popped slot of this cube may be reused)
+        template <typename ProbeCheck>
+        void split(
+            std::vector<Cube> &openlist,
+            int &top,
+            const int depth,
+            ProbeCheck &check)
+        {
+            // Backup this cube to prevent data conflict.
+            const Cube parent = *this;
+            const Index anchor = parent.getAnchor();
+            const int half_width = parent.getWidth(depth) / 2;
+
+            /**
+             * 27 IK checkpoints, index = x + 3y + 9z with (x, y, z) in half widths
+             * { ba(---), (0--), bb(+--),  (-0-), (00-), (+0-),  bd(-+-), (0+-), bc(++-),  // 012 345 678
+             *     (--0), (0-0),   (+-0),  (-00), (000), (+00),    (-+0), (0+0),   (++0),  // 9*1 234 567
+             *   ta(--+), (0-+), tb(+-+),  (-0+), (00+), (+0+),  td(-++), (0++), tc(+++) } // 89* 123 456
+             * ___________________________________________________
+             * { ba, bb, bc, bd, ta, tb, tc, td } => Already known
+             */
+            std::bitset<27> checkpoints(0);
+            // 8 Knowns
+            checkpoints[0] = parent.eight_iks_ & 0x80;  // ba
+            checkpoints[2] = parent.eight_iks_ & 0x40;  // bb
+            checkpoints[8] = parent.eight_iks_ & 0x20;  // bc
+            checkpoints[6] = parent.eight_iks_ & 0x10;  // bd
+            checkpoints[18] = parent.eight_iks_ & 0x08; // ta
+            checkpoints[20] = parent.eight_iks_ & 0x04; // tb
+            checkpoints[26] = parent.eight_iks_ & 0x02; // tc
+            checkpoints[24] = parent.eight_iks_ & 0x01; // td
+            // 19 Unknowns
+            for (int z = 0; z < 3; z++)
+            {
+                for (int y = 0; y < 3; y++)
+                {
+                    for (int x = 0; x < 3; x++)
+                    {
+                        if (x != 1 && y != 1 && z != 1) { continue; }  // Corner
+                        const Index probe{anchor.i + x * half_width, anchor.j + y * half_width, anchor.k + z * half_width};
+                        checkpoints[x + 3 * y + 9 * z] = check(probe);
+                    }
+                }
+            }
+
+            // Push 8 cubes into the openlist
+            // ba-side, bb-side, bc-side, bd-side, td-side, tc-side, tb-side, ta-side
+            static const int octants[8][3] = {
+                {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 0, 1}, {0, 0, 1}};
+            const uint8_t level = parent.level_ + 1;
+            for (const int *o : octants)
+            {
+                const std::size_t c = o[0] + 3 * o[1] + 9 * o[2];  // ba corner of the child
+                top++;
+                openlist[top].init(
+                    Index{anchor.i + o[0] * half_width, anchor.j + o[1] * half_width, anchor.k + o[2] * half_width},
+                    level,
+                    makeEightIKs(checkpoints, c, c + 1, c + 4, c + 3, c + 9, c + 10, c + 13, c + 12));
+            }
+        }
+
+    private:
+        int32_t anchor_[3]; // The ba corner on the probe lattice
+        uint8_t level_;     // 0: DFS cube
+        /**
+         * IK results for each corner. true == solution found.
+         * Cube 8 division order:
+         *     [+x: foward, +y: left, +z: up] => (+++)
+         *     Bottom CCW : ba(---) -> bb(+--) -> bc(++-) -> bd(-+-)
+         *     Top CCW    : ta(--+) -> tb(+-+) -> tc(+++) -> td(-++)
+         * eight_iks_ == 0b {ba bb bc bd} {ta tb tc td}
+         */
+        unsigned char eight_iks_;
+    };
+    static_assert(std::is_trivial<Cube>::value && sizeof(Cube) == 16, "Octree::Cube must stay a 16-byte POD");
+
+    // Every split pops 1 cube and pushes 8, so a depth-first refinement never holds more than this
+    inline std::size_t openlistSize(const int depth) { return 7 * depth + 1; }
+}
+
+#endif // WORKSPACE_OCTREE_HPP
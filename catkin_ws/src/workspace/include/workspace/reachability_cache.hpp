@@ -0,0 +1,106 @@
+/**
+ * Memoized IK reachability on a lattice.
+ */
+#ifndef WORKSPACE_REACHABILITY_CACHE_HPP
+#define WORKSPACE_REACHABILITY_CACHE_HPP
+
+#include <atomic>
+#include <memory>
+#include "workspace/lattice.hpp"
+
+namespace workspace
+{
+    /**
+     * Two bits per lattice point: { reachable, known }.
+     * Lookups and stores are lock-free, so one cache can be shared by all octree workers.
+     * A racing store of the same point only costs a duplicated IK call.
+     */
+    class ReachabilityCache
+    {
+    public:
+        enum State
+        {
+            UNKNOWN = 0x0,
+            UNREACHABLE = 0x1,
+            REACHABLE = 0x3,
+        };
+
+        explicit ReachabilityCache(const Lattice &lattice)
+            : lattice_(lattice),
+              num_words_((lattice.size() + 31) / 32),
+              words_(new std::atomic<uint64_t>[num_words_])
+        {
+            for (std::size_t w = 0; w < num_words_; w++) { words_[w].store(0, std::memory_order_relaxed); }
+        }
+
+        const Lattice &getLattice() const { return lattice_; }
+        std::size_t getMemoryBytes() const { return num_words_ * sizeof(uint64_t); }
+
+        // Points outside of the lattice are always UNKNOWN
+        State lookup(const Lattice::Index &idx) const
+        {
+            if (!lattice_.contains(idx)) { return UNKNOWN; }
+            const std::size_t key = lattice_.key(idx);
+            const uint64_t word = words_[key >> 5].load(std::memory_order_relaxed);
+            return (State)((word >> ((key & 31) << 1)) & 0x3);
+        }
+
+        void store(const Lattice::Index &idx, const bool reachable)
+        {
+            if (!lattice_.contains(idx)) { return; }
+            const std::size_t key = lattice_.key(idx);
+            const uint64_t bits = reachable ? REACHABLE : UNREACHABLE;
+            words_[key >> 5].fetch_or(bits << ((key & 31) << 1), std::memory_order_relaxed);
+        }
+
+        /**
+         * Forget every point of the box [min, max] (clipped to the lattice).
+         * Not safe while other threads look up or store.
+         */
+        void invalidate(const Lattice::Index &min, const Lattice::Index &max)
+        {
+            for (int k = min.k; k <= max.k; k++)
+            {
+                for (int j = min.j; j <= max.j; j++)
+                {
+                    for (int i = min.i; i <= max.i; i++)
+                    {
+                        const Lattice::Index idx{i, j, k};
+                        if (!lattice_.contains(idx)) { continue; }
+                        const std::size_t key = lattice_.key(idx);
+                        words_[key >> 5].fetch_and(~(uint64_t(0x3) << ((key & 31) << 1)), std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        // Keep the known points of `other` (same origin and resolution) that lie on this lattice
+        void copyFrom(const ReachabilityCache &other)
+        {
+            for (std::size_t key = 0; key < other.lattice_.size(); key++)
+            {
+                const Lattice::Index idx = other.lattice_.index(key);
+                const State state = other.lookup(idx);
+                if (state != UNKNOWN) { store(idx, state == REACHABLE); }
+            }
+        }
+
+        // Return the cached result of the lattice point `idx`, or evaluate `solve()` once and remember it
+        template <typename Solver>
+        bool check(const Lattice::Index &idx, Solver solve)
+        {
+            const State state = lookup(idx);
+            if (state != UNKNOWN) { return state == REACHABLE; }
+            const bool reachable = solve();
+            store(idx, reachable);
+            return reachable;
+        }
+
+    private:
+        const Lattice lattice_;
+        const std::size_t num_words_;
+        std::unique_ptr<std::atomic<uint64_t>[]> words_;
+    };
+}
+
+#endif // WORKSPACE_REACHABILITY_CACHE_HPP
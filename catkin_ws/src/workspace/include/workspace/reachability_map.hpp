@@ -0,0 +1,319 @@
+/**
+ * Persistent reachability map.
+ *
+ * File layout (native endianness, every section 8-byte aligned):
+ *     MapHeader | DFS grid (1 bit per lattice point, uint64 words) | MapCube[num_cubes] | MapObject[num_objects]
+ * Boundary cubes are sorted by the key of the DFS cell that contains them.
+ * A collision-aware map also lists the collision objects it was computed with,
+ * so a later run re-refines only around the objects that changed since.
+ */
+#ifndef WORKSPACE_REACHABILITY_MAP_HPP
+#define WORKSPACE_REACHABILITY_MAP_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "workspace/lattice.hpp"
+
+namespace workspace
+{
+    static const char MAP_MAGIC[8] = {'R', 'W', 'S', 'M', 'A', 'P', '\0', '\0'};
+    static const uint32_t MAP_VERSION = 2;
+
+    struct MapHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_bytes;
+        uint64_t model_hash;
+        char planning_group[64];
+        double dfs_resolution;
+        double marching_resolution;
+        double roi_y_min;
+        double roi_y_max;
+        double origin[3];      // Lattice origin (zero pose of the eef)
+        int32_t grid_min[3];   // DFS lattice index range
+        int32_t grid_dims[3];
+        uint32_t octree_depth; // Cube anchors live on the lattice of dfs_resolution / 2^octree_depth
+        uint32_t collision_aware;  // 1: IK solutions are checked against the planning scene
+        uint64_t grid_offset;
+        uint64_t grid_words;
+        uint64_t cubes_offset;
+        uint64_t num_cubes;
+        uint64_t objects_offset;
+        uint64_t num_objects;
+    };
+
+    struct MapCube
+    {
+        int32_t anchor[3];  // ba corner on the fine lattice
+        uint8_t level;      // width == dfs_resolution / 2^level
+        uint8_t eight_iks;  // Same bit order as Octree::Cube
+        uint8_t reserved[2];
+    };
+
+    // Collision object of the planning scene, as far as the map is concerned
+    struct MapObject
+    {
+        char id[64];
+        double min[3];  // Axis-aligned box around the object (model frame)
+        double max[3];
+        uint64_t hash;  // Shapes and poses, a move inside the same box changes it too
+    };
+
+    // FNV-1a, stable across builds (unlike std::hash)
+    inline uint64_t hashString(const std::string &s, uint64_t hash = 0xcbf29ce484222325ULL)
+    {
+        for (const char c : s)
+        {
+            hash ^= (unsigned char)c;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    inline uint64_t hashRobotModel(const std::string &urdf, const std::string &srdf)
+    {
+        return hashString(srdf, hashString(urdf));
+    }
+
+    inline MapHeader makeMapHeader(
+        const uint64_t model_hash,
+        const std::string &planning_group,
+        const double dfs_resolution,
+        const double marching_resolution,
+        const double roi_y_min,
+        const double roi_y_max,
+        const Lattice &grid,
+        const uint32_t octree_depth,
+        const bool collision_aware = false)
+    {
+        MapHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+        header.version = MAP_VERSION;
+        header.header_bytes = sizeof(MapHeader);
+        header.model_hash = model_hash;
+        std::strncpy(header.planning_group, planning_group.c_str(), sizeof(header.planning_group) - 1);
+        header.dfs_resolution = dfs_resolution;
+        header.marching_resolution = marching_resolution;
+        header.roi_y_min = roi_y_min;
+        header.roi_y_max = roi_y_max;
+        header.origin[0] = grid.getOrigin().x;
+        header.origin[1] = grid.getOrigin().y;
+        header.origin[2] = grid.getOrigin().z;
+        for (int a = 0; a < 3; a++)
+        {
+            header.grid_min[a] = grid.getMinIndex()[a];
+            header.grid_dims[a] = grid.getDims()[a];
+        }
+        header.octree_depth = octree_depth;
+        header.collision_aware = collision_aware ? 1 : 0;
+        return header;
+    }
+
+    /**
+     * True if a map built from `header` answers the same request as `key`, on the same lattice:
+     * the grid and the cube anchors are only meaningful for the origin, index range and depth they were built on.
+     */
+    inline bool sameMapKey(const MapHeader &header, const MapHeader &key)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            if (header.origin[a] != key.origin[a] ||
+                header.grid_min[a] != key.grid_min[a] ||
+                header.grid_dims[a] != key.grid_dims[a])
+            {
+                return false;
+            }
+        }
+        return header.model_hash == key.model_hash &&
+               std::strncmp(header.planning_group, key.planning_group, sizeof(header.planning_group)) == 0 &&
+               header.dfs_resolution == key.dfs_resolution &&
+               header.marching_resolution == key.marching_resolution &&
+               header.roi_y_min == key.roi_y_min &&
+               header.roi_y_max == key.roi_y_max &&
+               header.octree_depth == key.octree_depth &&
+               header.collision_aware == key.collision_aware;
+    }
+
+    inline Lattice makeGridLattice(const MapHeader &header)
+    {
+        geometry_msgs::Point origin;
+        origin.x = header.origin[0];
+        origin.y = header.origin[1];
+        origin.z = header.origin[2];
+        const Lattice::Index min{header.grid_min[0], header.grid_min[1], header.grid_min[2]};
+        const Lattice::Index max{min.i + header.grid_dims[0] - 1, min.j + header.grid_dims[1] - 1, min.k + header.grid_dims[2] - 1};
+        return Lattice(origin, header.dfs_resolution, min, max);
+    }
+
+    // Floor division by 2^depth (also for negative indices)
+    inline int coarsen(const int fine, const uint32_t depth)
+    {
+        const int scale = 1 << depth;
+        return (fine >= 0) ? (fine / scale) : -((-fine + scale - 1) / scale);
+    }
+
+    /**
+     * Write the map to `path` (through a temporary file, so readers never see a partial map).
+     * `cubes` are sorted in place.
+     */
+    inline bool saveReachabilityMap(
+        const std::string &path,
+        MapHeader header,
+        const DenseBitset &grid,
+        std::vector<MapCube> &cubes,
+        const std::vector<MapObject> &objects = std::vector<MapObject>())
+    {
+        const Lattice lattice = makeGridLattice(header);
+        auto cellKey = [&](const MapCube &c)
+        {
+            const Lattice::Index cell{
+                coarsen(c.anchor[0], header.octree_depth),
+                coarsen(c.anchor[1], header.octree_depth),
+                coarsen(c.anchor[2], header.octree_depth)};
+            return lattice.contains(cell) ? lattice.key(cell) : lattice.size();
+        };
+        std::sort(cubes.begin(), cubes.end(), [&](const MapCube &a, const MapCube &b)
+        {
+            return cellKey(a) < cellKey(b);
+        });
+
+        header.grid_offset = sizeof(MapHeader);
+        header.grid_words = grid.words().size();
+        header.cubes_offset = header.grid_offset + header.grid_words * sizeof(uint64_t);
+        header.num_cubes = cubes.size();
+        header.objects_offset = header.cubes_offset + header.num_cubes * sizeof(MapCube);
+        header.num_objects = objects.size();
+
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) { return false; }
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(grid.words().data()), header.grid_words * sizeof(uint64_t));
+            out.write(reinterpret_cast<const char *>(cubes.data()), cubes.size() * sizeof(MapCube));
+            out.write(reinterpret_cast<const char *>(objects.data()), objects.size() * sizeof(MapObject));
+            if (!out) { return false; }
+        }
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+    /**
+     * Read-only, memory-mapped reachability map.
+     */
+    class ReachabilityMap
+    {
+    public:
+        ReachabilityMap() {}
+        ~ReachabilityMap() { close(); }
+        ReachabilityMap(const ReachabilityMap &) = delete;
+        ReachabilityMap &operator=(const ReachabilityMap &) = delete;
+
+        bool open(const std::string &path)
+        {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) { return false; }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapHeader))
+            {
+                ::close(fd);
+                return false;
+            }
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) { return false; }
+            data_ = static_cast<const char *>(data);
+            size_ = st.st_size;
+
+            header_ = reinterpret_cast<const MapHeader *>(data_);
+            const bool valid =
+                std::memcmp(header_->magic, MAP_MAGIC, sizeof(MAP_MAGIC)) == 0 &&
+                header_->version == MAP_VERSION &&
+                header_->header_bytes == sizeof(MapHeader) &&
+                header_->grid_offset + header_->grid_words * sizeof(uint64_t) <= size_ &&
+                header_->cubes_offset + header_->num_cubes * sizeof(MapCube) <= size_ &&
+                header_->objects_offset + header_->num_objects * sizeof(MapObject) <= size_;
+            if (!valid)
+            {
+                close();
+                return false;
+            }
+            grid_ = makeGridLattice(*header_);
+            if ((grid_.size() + 63) / 64 != header_->grid_words)
+            {
+                close();
+                return false;
+            }
+            grid_words_ = reinterpret_cast<const uint64_t *>(data_ + header_->grid_offset);
+            cubes_ = reinterpret_cast<const MapCube *>(data_ + header_->cubes_offset);
+            objects_ = reinterpret_cast<const MapObject *>(data_ + header_->objects_offset);
+            return true;
+        }
+
+        void close()
+        {
+            if (data_) { munmap(const_cast<char *>(data_), size_); }
+            data_ = nullptr;
+            size_ = 0;
+            header_ = nullptr;
+            grid_words_ = nullptr;
+            cubes_ = nullptr;
+            objects_ = nullptr;
+        }
+
+        bool isOpen() const { return data_ != nullptr; }
+        const MapHeader &getHeader() const { return *header_; }
+        const Lattice &getGridLattice() const { return grid_; }
+        std::size_t getNumCubes() const { return header_->num_cubes; }
+        const MapCube *getCubes() const { return cubes_; }
+        std::size_t getNumObjects() const { return header_->num_objects; }
+        const MapObject *getObjects() const { return objects_; }
+
+        double getCubeWidth(const MapCube &c) const { return header_->dfs_resolution / (1 << c.level); }
+        geometry_msgs::Point getCubeAnchor(const MapCube &c) const
+        {
+            const double fine = header_->dfs_resolution / (1 << header_->octree_depth);
+            geometry_msgs::Point p;
+            p.x = header_->origin[0] + fine * c.anchor[0];
+            p.y = header_->origin[1] + fine * c.anchor[1];
+            p.z = header_->origin[2] + fine * c.anchor[2];
+            return p;
+        }
+
+        // Reachability of a DFS lattice point (false outside of the grid)
+        bool isGridPointReachable(const Lattice::Index &idx) const
+        {
+            if (!grid_.contains(idx)) { return false; }
+            const std::size_t key = grid_.key(idx);
+            return (grid_words_[key >> 6] >> (key & 63)) & 1;
+        }
+
+        // O(1) query: reachability of the nearest DFS lattice point
+        bool isReachable(const geometry_msgs::Point &p) const
+        {
+            return isGridPointReachable(grid_.nearest(p));
+        }
+
+    private:
+        const char *data_ = nullptr;
+        std::size_t size_ = 0;
+        const MapHeader *header_ = nullptr;
+        Lattice grid_;
+        const uint64_t *grid_words_ = nullptr;
+        const MapCube *cubes_ = nullptr;
+        const MapObject *objects_ = nullptr;
+    };
+}
+
+#endif // WORKSPACE_REACHABILITY_MAP_HPP
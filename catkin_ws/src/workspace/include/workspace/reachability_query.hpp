@@ -0,0 +1,117 @@
+/**
+ * Header-only reachability queries on a precomputed reachability map.
+ *
+ * [ Usage ]
+ *     workspace::ReachabilityQuery query;
+ *     if (query.open(map_file) && !query.isReachable(grasp.position)) { reject the grasp }
+ */
+#ifndef WORKSPACE_REACHABILITY_QUERY_HPP
+#define WORKSPACE_REACHABILITY_QUERY_HPP
+
+#include <cmath>
+#include <algorithm>
+#include "workspace/reachability_map.hpp"
+
+namespace workspace
+{
+    /**
+     * Trilinear interpolation of the 8 corner bits of a cube.
+     * (u, v, w) in [0, 1]^3 are the coordinates from the ba corner.
+     * The mask uses the Octree::Cube order: 0b {ba bb bc bd} {ta tb tc td}.
+     */
+    inline double interpolateEightIks(const uint8_t eight_iks, const double u, const double v, const double w)
+    {
+        const double ba = (eight_iks >> 7) & 1; // (---)
+        const double bb = (eight_iks >> 6) & 1; // (+--)
+        const double bc = (eight_iks >> 5) & 1; // (++-)
+        const double bd = (eight_iks >> 4) & 1; // (-+-)
+        const double ta = (eight_iks >> 3) & 1; // (--+)
+        const double tb = (eight_iks >> 2) & 1; // (+-+)
+        const double tc = (eight_iks >> 1) & 1; // (+++)
+        const double td = eight_iks & 1;        // (-++)
+        const double bottom = (1 - v) * ((1 - u) * ba + u * bb) + v * ((1 - u) * bd + u * bc);
+        const double top = (1 - v) * ((1 - u) * ta + u * tb) + v * ((1 - u) * td + u * tc);
+        return (1 - w) * bottom + w * top;
+    }
+
+    class ReachabilityQuery
+    {
+    public:
+        ReachabilityQuery() {}
+
+        bool open(const std::string &path) { return map_.open(path); }
+        bool isOpen() const { return map_.isOpen(); }
+        const ReachabilityMap &getMap() const { return map_; }
+
+        /**
+         * Reachability score in [0, 1].
+         * Inside a boundary cube, the corner mask of that cube is interpolated.
+         * Elsewhere, the 8 DFS grid points around `p` are interpolated
+         * (1.0 deep inside the workspace, 0.0 far outside of it).
+         */
+        double score(const geometry_msgs::Point &p) const
+        {
+            const MapHeader &header = map_.getHeader();
+            const Lattice &grid = map_.getGridLattice();
+            const double res = header.dfs_resolution;
+            const double x = (p.x - header.origin[0]) / res;
+            const double y = (p.y - header.origin[1]) / res;
+            const double z = (p.z - header.origin[2]) / res;
+            const Lattice::Index cell{(int)std::floor(x), (int)std::floor(y), (int)std::floor(z)};
+
+            // Boundary cube lookup (cubes are sorted by their DFS cell)
+            if (grid.contains(cell))
+            {
+                const std::size_t cell_key = grid.key(cell);
+                const MapCube *begin = map_.getCubes();
+                const MapCube *end = begin + map_.getNumCubes();
+                const MapCube *it = std::lower_bound(begin, end, cell_key, [&](const MapCube &c, std::size_t key)
+                {
+                    return cellKey(c) < key;
+                });
+                const double scale = 1 << header.octree_depth;
+                for (; it != end && cellKey(*it) == cell_key; ++it)
+                {
+                    const double width = scale / (1 << it->level);  // In fine lattice units
+                    const double u = (x * scale - it->anchor[0]) / width;
+                    const double v = (y * scale - it->anchor[1]) / width;
+                    const double w = (z * scale - it->anchor[2]) / width;
+                    if (u >= 0 && u <= 1 && v >= 0 && v <= 1 && w >= 0 && w <= 1)
+                    {
+                        return interpolateEightIks(it->eight_iks, u, v, w);
+                    }
+                }
+            }
+
+            // DFS grid cell
+            const uint8_t corners =
+                (map_.isGridPointReachable({cell.i, cell.j, cell.k}) << 7) |
+                (map_.isGridPointReachable({cell.i + 1, cell.j, cell.k}) << 6) |
+                (map_.isGridPointReachable({cell.i + 1, cell.j + 1, cell.k}) << 5) |
+                (map_.isGridPointReachable({cell.i, cell.j + 1, cell.k}) << 4) |
+                (map_.isGridPointReachable({cell.i, cell.j, cell.k + 1}) << 3) |
+                (map_.isGridPointReachable({cell.i + 1, cell.j, cell.k + 1}) << 2) |
+                (map_.isGridPointReachable({cell.i + 1, cell.j + 1, cell.k + 1}) << 1) |
+                (map_.isGridPointReachable({cell.i, cell.j + 1, cell.k + 1}));
+            return interpolateEightIks(corners, x - cell.i, y - cell.j, z - cell.k);
+        }
+
+        bool isReachable(const geometry_msgs::Point &p, const double threshold = 0.5) const
+        {
+            return score(p) >= threshold;
+        }
+
+    private:
+        std::size_t cellKey(const MapCube &c) const
+        {
+            const uint32_t depth = map_.getHeader().octree_depth;
+            const Lattice &grid = map_.getGridLattice();
+            const Lattice::Index cell{coarsen(c.anchor[0], depth), coarsen(c.anchor[1], depth), coarsen(c.anchor[2], depth)};
+            return grid.contains(cell) ? grid.key(cell) : grid.size();
+        }
+
+        ReachabilityMap map_;
+    };
+}
+
+#endif // WORKSPACE_REACHABILITY_QUERY_HPP
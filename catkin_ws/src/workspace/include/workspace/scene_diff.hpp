@@ -0,0 +1,127 @@
+/**
+ * Changes of the collision objects between two planning scenes, and the DFS cells they touch.
+ *
+ * An object mostly blocks the end effector positions around it, so a change is bounded by
+ * the boxes of the object before and after, inflated by a margin (the links near the
+ * end effector). Only the lattice points inside those boxes are probed again, and only the
+ * DFS cells intersecting them are re-refined.
+ */
+#ifndef WORKSPACE_SCENE_DIFF_HPP
+#define WORKSPACE_SCENE_DIFF_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "workspace/lattice.hpp"
+#include "workspace/reachability_map.hpp"
+
+namespace workspace
+{
+    // Axis-aligned box in the model frame
+    struct Region
+    {
+        double min[3];
+        double max[3];
+    };
+
+    inline MapObject makeMapObject(const std::string &id, const double (&min)[3], const double (&max)[3], const uint64_t hash)
+    {
+        MapObject object;
+        std::memset(&object, 0, sizeof(object));
+        std::strncpy(object.id, id.c_str(), sizeof(object.id) - 1);
+        for (int a = 0; a < 3; a++)
+        {
+            object.min[a] = min[a];
+            object.max[a] = max[a];
+        }
+        object.hash = hash;
+        return object;
+    }
+
+    inline Region inflate(const MapObject &object, const double margin)
+    {
+        Region r;
+        for (int a = 0; a < 3; a++)
+        {
+            r.min[a] = object.min[a] - margin;
+            r.max[a] = object.max[a] + margin;
+        }
+        return r;
+    }
+
+    /**
+     * Regions of every object that was added, removed, moved or reshaped from `before` to `after`
+     * (objects are matched by id). A moved object covers its old and its new box.
+     */
+    inline std::vector<Region> diffObjects(
+        const std::vector<MapObject> &before,
+        const std::vector<MapObject> &after,
+        const double margin)
+    {
+        std::map<std::string, const MapObject *> old_objects;
+        for (const MapObject &object : before) { old_objects[object.id] = &object; }
+
+        std::vector<Region> changed;
+        for (const MapObject &object : after)
+        {
+            const auto it = old_objects.find(object.id);
+            if (it == old_objects.end())
+            {
+                changed.push_back(inflate(object, margin));
+                continue;
+            }
+            const MapObject &old = *it->second;
+            if (old.hash != object.hash ||
+                !std::equal(old.min, old.min + 3, object.min) || !std::equal(old.max, old.max + 3, object.max))
+            {
+                changed.push_back(inflate(old, margin));
+                changed.push_back(inflate(object, margin));
+            }
+            old_objects.erase(it);
+        }
+        for (const auto &removed : old_objects) { changed.push_back(inflate(*removed.second, margin)); }
+        return changed;
+    }
+
+    /**
+     * DFS cells whose cube [point(c), point(c) + resolution] intersects `region`, clipped to `grid`.
+     * False if there is none.
+     */
+    inline bool cellRange(const Lattice &grid, const Region &region, Lattice::Index &lo, Lattice::Index &hi)
+    {
+        const double o[3] = {grid.getOrigin().x, grid.getOrigin().y, grid.getOrigin().z};
+        const double res = grid.getResolution();
+        int l[3], h[3];
+        for (int a = 0; a < 3; a++)
+        {
+            l[a] = std::max((int)std::ceil((region.min[a] - o[a]) / res - 1.0), grid.getMinIndex()[a]);
+            h[a] = std::min((int)std::floor((region.max[a] - o[a]) / res), grid.getMinIndex()[a] + grid.getDims()[a] - 1);
+            if (l[a] > h[a]) { return false; }
+        }
+        lo = Lattice::Index{l[0], l[1], l[2]};
+        hi = Lattice::Index{h[0], h[1], h[2]};
+        return true;
+    }
+
+    // Lattice points inside `region`, clipped to `lattice`. False if there is none.
+    inline bool pointRange(const Lattice &lattice, const Region &region, Lattice::Index &lo, Lattice::Index &hi)
+    {
+        const double o[3] = {lattice.getOrigin().x, lattice.getOrigin().y, lattice.getOrigin().z};
+        const double res = lattice.getResolution();
+        int l[3], h[3];
+        for (int a = 0; a < 3; a++)
+        {
+            l[a] = std::max((int)std::ceil((region.min[a] - o[a]) / res), lattice.getMinIndex()[a]);
+            h[a] = std::min((int)std::floor((region.max[a] - o[a]) / res), lattice.getMinIndex()[a] + lattice.getDims()[a] - 1);
+            if (l[a] > h[a]) { return false; }
+        }
+        lo = Lattice::Index{l[0], l[1], l[2]};
+        hi = Lattice::Index{h[0], h[1], h[2]};
+        return true;
+    }
+}
+
+#endif // WORKSPACE_SCENE_DIFF_HPP
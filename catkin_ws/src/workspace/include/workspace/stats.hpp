@@ -0,0 +1,298 @@
+/**
+ * Hot-path counters and duration histograms, published on /diagnostics.
+ *
+ * Every thread records into its own Recorder (one writer per slot, relaxed atomics only),
+ * so counting an IK call or timing a split never takes a lock. The publisher sums the
+ * recorders of all threads on a wall timer.
+ *
+ * [ Usage ]
+ *     workspace::stats::Registry registry;
+ *     const int IK_CALLS = registry.addCounter("ik_calls");        // before recording starts
+ *     const int IK_TIME = registry.addHistogram("ik_time");
+ *     workspace::stats::DiagnosticsPublisher publisher(nh, registry, "reachable_ws_ik", 1.0);
+ *     // On every thread:
+ *     workspace::stats::Recorder &recorder = registry.makeRecorder();
+ *     recorder.count(IK_CALLS);
+ *     { stats::ScopedTimer timer(recorder, IK_TIME); ... }
+ */
+#ifndef WORKSPACE_STATS_HPP
+#define WORKSPACE_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+namespace workspace
+{
+    namespace stats
+    {
+        const int kMaxCounters = 16;
+        const int kMaxHistograms = 8;
+        /**
+         * Log-linear buckets of nanoseconds: bucket 0 is [0, 4), then each power of two [2^e, 2^(e + 1))
+         * for e = 2..39 is split into 4 buckets, so a quantile is off by 25 % at most.
+         * The last bucket holds everything from 2^40 ns (18 min) on.
+         */
+        const int kSubBuckets = 4;
+        const int kMinExponent = 2;
+        const int kMaxExponent = 40;
+        const int kNumBuckets = 1 + (kMaxExponent - kMinExponent) * kSubBuckets + 1;
+
+        inline int bucketOf(uint64_t ns)
+        {
+            if (ns < (1ULL << kMinExponent)) { return 0; }  // Too short to split
+            const int e = 63 - __builtin_clzll(ns);
+            if (e >= kMaxExponent) { return kNumBuckets - 1; }
+            const int sub = (int)((ns >> (e - 2)) & 0x3);
+            return 1 + (e - kMinExponent) * kSubBuckets + sub;
+        }
+
+        // Exclusive upper bound of bucket b [ns], the lower bound 2^40 for the last one
+        inline double bucketUpperBound(int b)
+        {
+            if (b == 0) { return std::ldexp(1.0, kMinExponent); }
+            if (b >= kNumBuckets - 1) { return std::ldexp(1.0, kMaxExponent); }
+            const int e = (b - 1) / kSubBuckets + kMinExponent;
+            return std::ldexp(1.0, e) * (1.0 + (double)((b - 1) % kSubBuckets + 1) / kSubBuckets);
+        }
+
+        typedef std::chrono::steady_clock Clock;
+
+        struct Histogram
+        {
+            uint64_t count;
+            uint64_t sum;  // [ns]
+            uint64_t buckets[kNumBuckets];
+
+            // Upper bound of the bucket holding the q quantile [sec]
+            double quantile(double q) const
+            {
+                if (count == 0) { return 0.0; }
+                const uint64_t rank = (uint64_t)std::ceil(q * count);
+                uint64_t seen = 0;
+                for (int b = 0; b < kNumBuckets; b++)
+                {
+                    seen += buckets[b];
+                    if (seen >= rank) { return bucketUpperBound(b) * 1e-9; }
+                }
+                return bucketUpperBound(kNumBuckets - 1) * 1e-9;
+            }
+
+            double mean() const { return count > 0 ? (double)sum / count * 1e-9 : 0.0; }
+        };
+
+        // Sum of every recorder at one time
+        struct Snapshot
+        {
+            uint64_t counters[kMaxCounters];
+            Histogram histograms[kMaxHistograms];
+            Clock::time_point stamp;
+        };
+
+        // One thread's counters. Single writer: a load and a store, no read-modify-write.
+        class Recorder
+        {
+        public:
+            Recorder()
+            {
+                for (std::atomic<uint64_t> &c : counters_) { c.store(0, std::memory_order_relaxed); }
+                for (std::atomic<uint64_t> &c : histograms_) { c.store(0, std::memory_order_relaxed); }
+            }
+
+            void count(int counter, uint64_t n = 1)
+            {
+                add(counters_[counter], n);
+            }
+
+            void record(int histogram, Clock::duration duration)
+            {
+                const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+                const uint64_t value = ns > 0 ? (uint64_t)ns : 0;
+                std::atomic<uint64_t> *h = &histograms_[histogram * kHistogramSize];
+                add(h[0], 1);
+                add(h[1], value);
+                add(h[2 + bucketOf(value)], 1);
+            }
+
+            // Any thread
+            void addTo(Snapshot &snapshot) const
+            {
+                for (int c = 0; c < kMaxCounters; c++)
+                {
+                    snapshot.counters[c] += counters_[c].load(std::memory_order_relaxed);
+                }
+                for (int i = 0; i < kMaxHistograms; i++)
+                {
+                    const std::atomic<uint64_t> *h = &histograms_[i * kHistogramSize];
+                    Histogram &out = snapshot.histograms[i];
+                    out.count += h[0].load(std::memory_order_relaxed);
+                    out.sum += h[1].load(std::memory_order_relaxed);
+                    for (int b = 0; b < kNumBuckets; b++) { out.buckets[b] += h[2 + b].load(std::memory_order_relaxed); }
+                }
+            }
+
+        private:
+            enum { kHistogramSize = 2 + kNumBuckets };  // count, sum, buckets
+
+            static void add(std::atomic<uint64_t> &value, uint64_t n)
+            {
+                value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+
+            std::atomic<uint64_t> counters_[kMaxCounters];
+            std::atomic<uint64_t> histograms_[kMaxHistograms * kHistogramSize];
+        };
+
+        // Records the lifetime of the timer
+        class ScopedTimer
+        {
+        public:
+            ScopedTimer(Recorder &recorder, int histogram)
+                : recorder_(recorder), histogram_(histogram), start_(Clock::now())
+            {
+            }
+
+            ~ScopedTimer() { recorder_.record(histogram_, Clock::now() - start_); }
+
+        private:
+            Recorder &recorder_;
+            const int histogram_;
+            const Clock::time_point start_;
+        };
+
+        /**
+         * Names of the counters and histograms, and the recorders of every thread.
+         * Names are added before recording starts; recorders live as long as the registry,
+         * so the totals of a finished thread are kept.
+         */
+        class Registry
+        {
+        public:
+            // Index of the new counter, -1 past kMaxCounters
+            int addCounter(const std::string &name)
+            {
+                if (counter_names_.size() >= (std::size_t)kMaxCounters) { return -1; }
+                counter_names_.push_back(name);
+                return counter_names_.size() - 1;
+            }
+
+            // Index of the new duration histogram, -1 past kMaxHistograms
+            int addHistogram(const std::string &name)
+            {
+                if (histogram_names_.size() >= (std::size_t)kMaxHistograms) { return -1; }
+                histogram_names_.push_back(name);
+                return histogram_names_.size() - 1;
+            }
+
+            // Once per thread (takes the lock), then record without locking
+            Recorder &makeRecorder()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                recorders_.emplace_back(new Recorder());
+                return *recorders_.back();
+            }
+
+            void snapshot(Snapshot &out) const
+            {
+                out = Snapshot();
+                out.stamp = Clock::now();
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const std::unique_ptr<Recorder> &recorder : recorders_) { recorder->addTo(out); }
+            }
+
+            const std::vector<std::string> &getCounterNames() const { return counter_names_; }
+            const std::vector<std::string> &getHistogramNames() const { return histogram_names_; }
+
+        private:
+            std::vector<std::string> counter_names_;
+            std::vector<std::string> histogram_names_;
+            mutable std::mutex mutex_;
+            std::vector<std::unique_ptr<Recorder>> recorders_;
+        };
+
+        /**
+         * DiagnosticStatus of the registry every `period` seconds: counter totals and rates,
+         * and the count, mean and p50/p90/p99 [ms] of each histogram since the last publication.
+         */
+        class DiagnosticsPublisher
+        {
+        public:
+            DiagnosticsPublisher(
+                ros::NodeHandle &nh,
+                const Registry &registry,
+                const std::string &name,
+                double period,
+                const std::string &topic = "/diagnostics")
+                : registry_(registry)
+            {
+                pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>(topic, 1);
+                status_.name = name;
+                status_.hardware_id = ros::this_node::getName();
+                status_.level = diagnostic_msgs::DiagnosticStatus::OK;
+                registry_.snapshot(last_);
+                timer_ = nh.createWallTimer(ros::WallDuration(period), &DiagnosticsPublisher::onTimer, this);
+            }
+
+            void publish()
+            {
+                Snapshot now;
+                registry_.snapshot(now);
+                const double window = std::chrono::duration<double>(now.stamp - last_.stamp).count();
+                status_.values.clear();
+                const std::vector<std::string> &counters = registry_.getCounterNames();
+                for (std::size_t c = 0; c < counters.size(); c++)
+                {
+                    addValue(counters[c], std::to_string(now.counters[c]));
+                    addValue(counters[c] + "/rate", std::to_string((now.counters[c] - last_.counters[c]) / window));
+                }
+                const std::vector<std::string> &histograms = registry_.getHistogramNames();
+                for (std::size_t i = 0; i < histograms.size(); i++)
+                {
+                    Histogram h = now.histograms[i];
+                    const Histogram &before = last_.histograms[i];
+                    h.count -= before.count;
+                    h.sum -= before.sum;
+                    for (int b = 0; b < kNumBuckets; b++) { h.buckets[b] -= before.buckets[b]; }
+                    addValue(histograms[i] + "/count", std::to_string(h.count));
+                    addValue(histograms[i] + "/mean_ms", std::to_string(h.mean() * 1e3));
+                    addValue(histograms[i] + "/p50_ms", std::to_string(h.quantile(0.5) * 1e3));
+                    addValue(histograms[i] + "/p90_ms", std::to_string(h.quantile(0.9) * 1e3));
+                    addValue(histograms[i] + "/p99_ms", std::to_string(h.quantile(0.99) * 1e3));
+                }
+                status_.message = std::to_string(window) + " s window";
+                diagnostic_msgs::DiagnosticArray msg;
+                msg.header.stamp = ros::Time::now();
+                msg.status.push_back(status_);
+                pub_.publish(msg);
+                last_ = now;
+            }
+
+        private:
+            void onTimer(const ros::WallTimerEvent &) { publish(); }
+
+            void addValue(const std::string &key, const std::string &value)
+            {
+                diagnostic_msgs::KeyValue kv;
+                kv.key = key;
+                kv.value = value;
+                status_.values.push_back(kv);
+            }
+
+            const Registry &registry_;
+            ros::Publisher pub_;
+            ros::WallTimer timer_;
+            diagnostic_msgs::DiagnosticStatus status_;
+            Snapshot last_;
+        };
+    }
+}
+
+#endif // WORKSPACE_STATS_HPP
@@ -0,0 +1,61 @@
+#include <ros/ros.h>
+#include "workspace/CheckReachability.h"
+#include "workspace/reachability_query.hpp"
+
+class ReachabilityServer
+{
+public:
+    ReachabilityServer(ros::NodeHandle &nh, const std::string &map_file, double threshold)
+        : threshold_(threshold)
+    {
+        if (!query_.open(map_file))
+        {
+            ROS_ERROR_STREAM("Cannot open the reachability map: " << map_file);
+            return;
+        }
+        const workspace::MapHeader &header = query_.getMap().getHeader();
+        ROS_INFO_STREAM("Reachability map: " << map_file
+                        << " (group " << header.planning_group
+                        << ", " << header.num_cubes << " boundary cubes)");
+        service_ = nh.advertiseService("check_reachability", &ReachabilityServer::check, this);
+    }
+
+    bool isOpen() const { return query_.isOpen(); }
+
+private:
+    bool check(workspace::CheckReachability::Request &req, workspace::CheckReachability::Response &res)
+    {
+        const double threshold = req.threshold > 0 ? req.threshold : threshold_;
+        const std::size_t n = req.points.size() + req.poses.size();
+        res.reachable.resize(n);
+        res.score.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const geometry_msgs::Point &p = i < req.points.size() ? req.points[i] : req.poses[i - req.points.size()].position;
+            res.score[i] = query_.score(p);
+            res.reachable[i] = res.score[i] >= threshold;
+        }
+        return true;
+    }
+
+    workspace::ReachabilityQuery query_;
+    ros::ServiceServer service_;
+    double threshold_;
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "reachability_server");
+    ros::NodeHandle nh("~");
+
+    std::string map_file;
+    double threshold;
+    nh.param<std::string>("map_file", map_file, "");
+    nh.param<double>("threshold", threshold, 0.5);
+
+    ReachabilityServer server(nh, map_file, threshold);
+    if (!server.isOpen()) return 1;
+
+    ros::spin();
+    return 0;
+}
@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <cmath>
 #include <map>
+#include <deque>
 #include <iomanip>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <ros/ros.h>
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
@@ -8,6 +15,13 @@
 #include <moveit_msgs/JointLimits.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_eigen/tf2_eigen.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include "workspace/batch_fk.hpp"
+#include "workspace/dh_chain.hpp"
+#include "workspace/lattice.hpp"
+#include "workspace/marker_publisher.hpp"
+#include "workspace/reachability_map.hpp"
 
 namespace rvt = rviz_visual_tools;
 
@@ -81,10 +95,28 @@ public:
         // }
     }
 
+    /**
+     * Jump to the sample with the given mixed-radix index.
+     * The last joint is the fastest digit, which is the order of moveToNextSample.
+     */
+    void setSample(unsigned long long sample)
+    {
+        count = sample;
+        for (std::size_t i = joint_values.size(); i-- > 0;)
+        {
+            joint_index_vector[i] = sample % joint_cases_vector[i];
+            sample /= joint_cases_vector[i];
+            double sample_value = joint_limits[i].min_position + joint_index_vector[i] * joint_resolution[i];
+            joint_values[i] = (sample_value > joint_limits[i].max_position) ?
+                joint_limits[i].max_position : sample_value;
+        }
+    }
+
     const std::vector<double>& getJointValues() {return joint_values;}
     bool isAvailable() {return initialized;}
     bool workRemains() {return count < num_total_cases;}
     float getProgress() {return 100.0 * ((float)count / (float)num_total_cases);}
+    unsigned long long getNumTotalCases() {return num_total_cases;}
 
 private:
     void _resetJointValues(const std::size_t start_idx)
@@ -171,6 +203,148 @@ private:
     std::vector<double> joint_values;
 };
 
+/**
+ * Compare the DH chain against MoveIt FK on samples spread over the joint space.
+ */
+bool verifyDHChain(
+    const workspace::DHChain &chain,
+    JointTreversal jt,
+    const robot_state::RobotStatePtr &kinematic_state,
+    const robot_model::JointModelGroup *joint_model_group,
+    const std::string &eef_link)
+{
+    const unsigned long long num_checks = 64;
+    for (unsigned long long c = 0; c < num_checks; c++)
+    {
+        jt.setSample(c * (jt.getNumTotalCases() - 1) / (num_checks - 1));
+        geometry_msgs::Pose eef_pose;
+        calcFK(jt.getJointValues(), kinematic_state, joint_model_group, eef_link, eef_pose);
+        const Eigen::Vector3d p = workspace::computeDHChain(chain, jt.getJointValues()).translation();
+        const double error = (p - Eigen::Vector3d(eef_pose.position.x, eef_pose.position.y, eef_pose.position.z)).norm();
+        if (error > 1e-6)
+        {
+            ROS_WARN_STREAM("DH chain differs from MoveIt FK by " << error << " m");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Box around every end effector position of the group: from the parent link of the first joint,
+ * the end effector is at most the sum of the joint origin offsets and prismatic strokes away.
+ * False if a joint on the way is neither fixed, revolute nor a bounded prismatic joint.
+ */
+bool computeReachBounds(
+    const robot_state::RobotStatePtr &kinematic_state,
+    const robot_model::JointModelGroup *joint_model_group,
+    const std::string &eef_link,
+    double (&ws_min)[3],
+    double (&ws_max)[3],
+    std::string &error)
+{
+    if (joint_model_group->getActiveJointModels().empty())
+    {
+        error = "the group has no active joint";
+        return false;
+    }
+    const robot_model::LinkModel *root = joint_model_group->getActiveJointModels().front()->getParentLinkModel();
+    double reach = 0.0;
+    for (const robot_model::LinkModel *link = kinematic_state->getLinkModel(eef_link); link != root; link = link->getParentLinkModel())
+    {
+        if (link == nullptr)
+        {
+            error = "[ " + eef_link + " ] is not below the first joint of the group";
+            return false;
+        }
+        const robot_model::JointModel *jm = link->getParentJointModel();
+        reach += link->getJointOriginTransform().translation().norm();
+        if (jm->getType() == robot_model::JointModel::PRISMATIC)
+        {
+            const robot_model::VariableBounds &bounds = jm->getVariableBounds()[0];
+            if (!bounds.position_bounded_)
+            {
+                error = "prismatic joint [ " + jm->getName() + " ] has no position limits";
+                return false;
+            }
+            reach += std::max(std::abs(bounds.min_position_), std::abs(bounds.max_position_));
+        }
+        else if (jm->getType() != robot_model::JointModel::FIXED && jm->getType() != robot_model::JointModel::REVOLUTE)
+        {
+            error = "joint [ " + jm->getName() + " ] is " + jm->getTypeName();
+            return false;
+        }
+    }
+    kinematic_state->updateLinkTransforms();
+    const Eigen::Vector3d center = kinematic_state->getGlobalLinkTransform(root).translation();
+    for (int a = 0; a < 3; a++)
+    {
+        ws_min[a] = center[a] - reach;
+        ws_max[a] = center[a] + reach;
+    }
+    return true;
+}
+
+/**
+ * Bounded queue between the sweep workers and the visualization thread.
+ * Workers block while the queue is full, so memory stays bounded even when
+ * the visualization cannot keep up with the sweep.
+ */
+template <typename T>
+class BatchQueue
+{
+public:
+    explicit BatchQueue(std::size_t capacity): capacity_(capacity) {}
+
+    void push(std::vector<T> &&batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]{ return batches_.size() < capacity_; });
+        batches_.push_back(std::move(batch));
+        not_empty_.notify_one();
+    }
+
+    /** Returns false if no batch arrived within `timeout`. */
+    bool pop(std::vector<T> &batch, const std::chrono::milliseconds &timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!not_empty_.wait_for(lock, timeout, [this]{ return !batches_.empty(); })) { return false; }
+        batch = std::move(batches_.front());
+        batches_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+private:
+    const std::size_t capacity_;
+    std::deque<std::vector<T>> batches_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+void publishVoxelCloud(
+    const ros::Publisher &publisher,
+    const std::string &frame_id,
+    const std::vector<geometry_msgs::Point> &voxels)
+{
+    sensor_msgs::PointCloud2 cloud;
+    cloud.header.frame_id = frame_id;
+    cloud.header.stamp = ros::Time::now();
+    sensor_msgs::PointCloud2Modifier modifier(cloud);
+    modifier.setPointCloud2FieldsByString(1, "xyz");
+    modifier.resize(voxels.size());
+    sensor_msgs::PointCloud2Iterator<float> it_x(cloud, "x");
+    sensor_msgs::PointCloud2Iterator<float> it_y(cloud, "y");
+    sensor_msgs::PointCloud2Iterator<float> it_z(cloud, "z");
+    for (const geometry_msgs::Point &p : voxels)
+    {
+        *it_x = p.x; *it_y = p.y; *it_z = p.z;
+        ++it_x; ++it_y; ++it_z;
+    }
+    publisher.publish(cloud);
+}
+
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "reachable_ws_fk");
@@ -183,12 +357,36 @@ int main(int argc, char **argv)
     double prismatic_resolution_m;
     double marker_scale;
     std::string planning_group;
-    double sleep_time;
+    double voxel_resolution;
+    double publish_period;
+    std::string map_file;
+    int num_threads;
+    int chunk_size;
+    std::string fk_backend;
     nh.param<double>("revolute_resolution_deg", revolute_resolution_deg_, 30);
     nh.param<double>("prismatic_resolution_m", prismatic_resolution_m, 0.02);
     nh.param<double>("marker_scale", marker_scale, 0.01);
     nh.param<std::string>("planning_group", planning_group, "scara");
-    nh.param<double>("sleep_time", sleep_time, 0.1);
+    nh.param<double>("voxel_resolution", voxel_resolution, 0.01);
+    nh.param<double>("publish_period", publish_period, 1.0);
+    nh.param<std::string>("map_file", map_file, "");
+    nh.param<int>("num_threads", num_threads, 1);
+    nh.param<int>("chunk_size", chunk_size, 512);
+    nh.param<std::string>("fk_backend", fk_backend, "moveit");
+    // Box of the voxel grid [m], empty: derived from the joint offsets and strokes of the group
+    std::vector<double> workspace_min, workspace_max;
+    nh.param<std::vector<double>>("workspace_min", workspace_min, std::vector<double>());
+    nh.param<std::vector<double>>("workspace_max", workspace_max, std::vector<double>());
+    // Markers per MarkerArray, MarkerArrays per second, and queued markers before decimating
+    int marker_batch_size, marker_queue_size;
+    workspace::MarkerPublisher::Options marker_options;
+    nh.param<int>("marker_batch_size", marker_batch_size, 512);
+    nh.param<double>("marker_rate", marker_options.rate, 20.0);
+    nh.param<int>("marker_queue_size", marker_queue_size, 16384);
+    marker_options.batch_size = std::max(marker_batch_size, 1);
+    marker_options.capacity = std::max(marker_queue_size, 2);
+    num_threads = std::max(num_threads, 1);
+    chunk_size = std::max(chunk_size, 1);
     double revolute_resolution_rad = revolute_resolution_deg_ * M_PI / 180.0;
 
     std::map<robot_state::JointModel::JointType, double> resolution;
@@ -210,11 +408,12 @@ int main(int argc, char **argv)
 
     // Visualization
     moveit_visual_tools::MoveItVisualTools visual_tools(base_link);
-    visual_tools.deleteAllMarkers();
     visual_tools.loadRemoteControl();
-    visual_tools.enableBatchPublishing();
     visual_tools.setAlpha(0.5);
-    std::size_t marker_count = 0;
+    // Sphere lists go out from a background thread, the main loop never waits for RViz
+    workspace::MarkerPublisher markers(nh, "/rviz_visual_tools", marker_options);
+    markers.deleteAll();
+    ros::Publisher cloud_pub = nh.advertise<sensor_msgs::PointCloud2>("reachable_voxels", 1, true);
 
     // Get joint information
     const std::vector<const robot_state::JointModel*> &joint_model_vector =
@@ -235,34 +434,215 @@ int main(int argc, char **argv)
     JointTreversal jt(joint_model_vector, resolution);
     if (!jt.isAvailable()) { return 1; }
 
+    // FK backend
+    // "moveit": RobotState::setJointGroupPositions + getGlobalLinkTransform, one sample at a time
+    // "dh"    : batch FK of a whole chunk on the DH chain extracted from the robot model
+    workspace::DHChain dh_chain;
+    bool use_batch_fk = false;
+    if (fk_backend == "dh")
+    {
+        std::string error;
+        if (!workspace::extractDHChain(*kinematic_state, joint_model_group, eef_link, dh_chain, error))
+        {
+            ROS_WARN_STREAM("No DH chain for [ " << planning_group << " ]: " << error);
+        }
+        else if (verifyDHChain(dh_chain, jt, kinematic_state, joint_model_group, eef_link))
+        {
+            use_batch_fk = true;
+            for (const workspace::DHParam &l : dh_chain.links)
+            {
+                ROS_INFO_STREAM("DH (alpha, a, d, theta): (" << l.alpha << ", " << l.a << ", " << l.d << ", " << l.theta << ")"
+                                << (l.prismatic ? " prismatic" : " revolute"));
+            }
+        }
+        ROS_WARN_STREAM("FK backend: " << (use_batch_fk ? "batch DH" : "MoveIt (fallback)"));
+    }
+
+    // Voxel occupancy
+    /**
+     * FK samples are accumulated into an occupancy bitset over a fixed box, so memory
+     * depends on the voxel resolution only, not on the number of samples.
+     * Only newly occupied voxels leave the workers.
+     */
+    double ws_min[3] = {-2.0, -2.0, -2.0};
+    double ws_max[3] = {2.0, 2.0, 2.0};
+    if (workspace_min.size() == 3 && workspace_max.size() == 3)
+    {
+        std::copy(workspace_min.begin(), workspace_min.end(), ws_min);
+        std::copy(workspace_max.begin(), workspace_max.end(), ws_max);
+    }
+    else
+    {
+        if (!workspace_min.empty() || !workspace_max.empty())
+        {
+            ROS_WARN_STREAM("workspace_min and workspace_max need 3 values each, deriving the box from the robot");
+        }
+        std::string error;
+        if (!computeReachBounds(kinematic_state, joint_model_group, eef_link, ws_min, ws_max, error))
+        {
+            ROS_WARN_STREAM("Cannot bound the reach (" << error << "), set workspace_min/max. Using +-2 m");
+        }
+        else
+        {
+            // One voxel of slack for the rounding to the nearest lattice point
+            for (int a = 0; a < 3; a++)
+            {
+                ws_min[a] -= voxel_resolution;
+                ws_max[a] += voxel_resolution;
+            }
+        }
+    }
+    workspace::Lattice voxel_lattice(geometry_msgs::Point(), voxel_resolution, ws_min, ws_max);
+    workspace::AtomicBitset voxel_occupied(voxel_lattice.size());
+    ROS_INFO_STREAM("Voxel grid: [" << ws_min[0] << ", " << ws_max[0] << "] x [" << ws_min[1] << ", " << ws_max[1] << "] x ["
+                    << ws_min[2] << ", " << ws_max[2] << "] m, resolution " << voxel_resolution << ", "
+                    << voxel_lattice.size() / 8 / 1024 << " KiB");
+
     // Find reachable workspace
-    while (jt.workRemains())
+    /**
+     * The joint space is split into chunks of `chunk_size` consecutive mixed-radix indices.
+     * Workers claim chunks from a shared cursor and run FK on their own RobotState
+     * (FK only reads the shared RobotModel, so no per-thread model is needed).
+     * The new voxels of each chunk are handed to this thread, which owns the visualization.
+     */
+    const unsigned long long num_total_cases = jt.getNumTotalCases();
+    std::atomic<unsigned long long> next_sample(0);
+    std::atomic<unsigned long long> done_samples(0);
+    std::atomic<unsigned long long> outside_samples(0);
+    std::atomic<int> running_workers(num_threads);
+    BatchQueue<std::size_t> voxel_queue(4 * num_threads);
+    std::vector<std::thread> workers;
+    ROS_INFO_STREAM("Joint space sweep with " << num_threads << " threads, chunk size " << chunk_size);
+    for (int t = 0; t < num_threads; t++)
     {
-        // Get joint values
-        const std::vector<double> joint_values = jt.getJointValues();
-        jt.moveToNextSample();
+        workers.emplace_back([&]()
+        {
+            JointTreversal worker_jt(jt);
+            robot_state::RobotStatePtr state(new robot_state::RobotState(*kinematic_state));
+            workspace::BatchFK<float> batch_fk(dh_chain);
+            workspace::BatchFK<float>::JointArray q;
+            unsigned long long outside = 0;
+            std::vector<std::size_t> new_voxels;
+            auto occupy = [&](const double x, const double y, const double z)
+            {
+                geometry_msgs::Point p;
+                p.x = x; p.y = y; p.z = z;
+                const workspace::Lattice::Index idx = voxel_lattice.nearest(p);
+                if (!voxel_lattice.contains(idx)) { outside++; return; }
+                const std::size_t key = voxel_lattice.key(idx);
+                if (!voxel_occupied.testAndSet(key)) { new_voxels.push_back(key); }
+            };
 
-        // FK
-        geometry_msgs::Pose eef_pose;
-        calcFK(joint_values, kinematic_state, joint_model_group, eef_link, eef_pose);
+            for (unsigned long long begin = next_sample.fetch_add(chunk_size);
+                 begin < num_total_cases && ros::ok();
+                 begin = next_sample.fetch_add(chunk_size))
+            {
+                const unsigned long long end = std::min(begin + chunk_size, num_total_cases);
+                worker_jt.setSample(begin);
+                if (use_batch_fk)
+                {
+                    q.resize(dh_chain.links.size(), end - begin);
+                    for (Eigen::Index i = 0; i < q.cols(); i++)
+                    {
+                        const std::vector<double> &joint_values = worker_jt.getJointValues();
+                        for (Eigen::Index j = 0; j < q.rows(); j++) { q(j, i) = joint_values[j]; }
+                        worker_jt.moveToNextSample();
+                    }
+                    batch_fk.compute(q);
+                    for (Eigen::Index i = 0; i < q.cols(); i++)
+                    {
+                        occupy(batch_fk.getPosition(0)(i), batch_fk.getPosition(1)(i), batch_fk.getPosition(2)(i));
+                    }
+                }
+                else
+                {
+                    for (unsigned long long s = begin; s < end; s++)
+                    {
+                        geometry_msgs::Pose eef_pose;
+                        calcFK(worker_jt.getJointValues(), state, joint_model_group, eef_link, eef_pose);
+                        occupy(eef_pose.position.x, eef_pose.position.y, eef_pose.position.z);
+                        worker_jt.moveToNextSample();
+                    }
+                }
+                done_samples += end - begin;
+                if (!new_voxels.empty()) { voxel_queue.push(std::move(new_voxels)); }
+                new_voxels.clear();
+            }
+            outside_samples += outside;
+            running_workers--;
+        });
+    }
 
-        // Visualization
-        visual_tools.publishSphere(eef_pose, rvt::BLUE, marker_scale);
-        marker_count++;
+    // Visualization
+    // Each period, the new voxels are drawn as one sphere list and the whole set as one PointCloud2
+    std::vector<geometry_msgs::Point> voxels;
+    std::size_t drawn_voxels = 0;
+    int sphere_list_id = 0;
+    auto publishVoxels = [&]()
+    {
+        if (drawn_voxels < voxels.size())
+        {
+            visualization_msgs::Marker sphere_list;
+            sphere_list.header.frame_id = base_link;
+            sphere_list.header.stamp = ros::Time::now();
+            sphere_list.ns = "reachable_voxels";
+            sphere_list.id = sphere_list_id++;
+            sphere_list.type = visualization_msgs::Marker::SPHERE_LIST;
+            sphere_list.action = visualization_msgs::Marker::ADD;
+            sphere_list.pose.orientation.w = 1.0;
+            sphere_list.scale.x = sphere_list.scale.y = sphere_list.scale.z = marker_scale;
+            sphere_list.color = visual_tools.getColor(rvt::BLUE);
+            sphere_list.points.assign(voxels.begin() + drawn_voxels, voxels.end());
+            markers.publish(std::move(sphere_list));
+            drawn_voxels = voxels.size();
+        }
+        publishVoxelCloud(cloud_pub, base_link, voxels);
+        float process = 100.0 * ((float)done_samples / (float)num_total_cases);
+        ROS_INFO_STREAM("Process: " << std::fixed << std::setprecision(3) << process << "% (" << voxels.size() << " voxels)");
+    };
 
-        // Print progress
-        if (marker_count > 512)
+    std::vector<std::size_t> batch;
+    ros::WallTime last_publish = ros::WallTime::now();
+    while (running_workers > 0 || voxel_queue.pop(batch, std::chrono::milliseconds(0)))
+    {
+        if (batch.empty()) { voxel_queue.pop(batch, std::chrono::milliseconds(100)); }
+        for (const std::size_t key : batch) { voxels.push_back(voxel_lattice.point(voxel_lattice.index(key))); }
+        batch.clear();
+
+        if ((ros::WallTime::now() - last_publish).toSec() > publish_period)
         {
-            visual_tools.trigger();
-            float process = jt.getProgress();
-            ROS_INFO_STREAM("Process: " << std::fixed << std::setprecision(3) << process << "%");
-            ros::Duration(sleep_time).sleep();
-            marker_count = 0;
+            publishVoxels();
+            last_publish = ros::WallTime::now();
         }
     }
-    visual_tools.trigger();
+    for (std::thread &worker : workers) { worker.join(); }
+    publishVoxels();
     ROS_INFO_STREAM("Process: 100%");
+    if (outside_samples > 0)
+    {
+        ROS_WARN_STREAM(outside_samples << " samples are outside of the voxel grid, widen workspace_min/max");
+    }
     ROS_WARN_STREAM("Reachable workspace found!");
+
+    // Save
+    if (!map_file.empty())
+    {
+        std::string urdf, srdf;
+        nh.getParam("/robot_description", urdf);
+        nh.getParam("/robot_description_semantic", srdf);
+        const workspace::MapHeader map_header = workspace::makeMapHeader(
+            workspace::hashRobotModel(urdf, srdf), planning_group, voxel_resolution, voxel_resolution,
+            ws_min[1], ws_max[1], voxel_lattice, 0);
+        std::vector<workspace::MapCube> no_cubes;
+        if (workspace::saveReachabilityMap(map_file, map_header, voxel_occupied.snapshot(), no_cubes))
+        {
+            ROS_INFO_STREAM("Reachability map saved: " << map_file);
+        }
+        else
+        {
+            ROS_ERROR_STREAM("Cannot save the reachability map: " << map_file);
+        }
+    }
     ros::waitForShutdown();
     return 0;
 }
@@ -1,25 +1,59 @@
 /**
  * Fast boundary search for the workspace of a robot.
- * [ DFS -> Octree -> Pseudo marching cubes ]
+ * [ DFS -> Octree -> Marching cubes ]
  */
 #include <bitset>
 #include <memory>
 #include <array>
-#include <set>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <limits>
 #include <ros/ros.h>
 #include <moveit/move_group_interface/move_group_interface.h>
-#include <moveit/planning_scene_interface/planning_scene_interface.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <geometric_shapes/bodies.h>
 #include <rviz_visual_tools/rviz_visual_tools.h>
 #include <moveit_visual_tools/moveit_visual_tools.h>
 #include <geometry_msgs/Point.h>
+#include <visualization_msgs/Marker.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_eigen/tf2_eigen.h>
+#include "workspace/analytic_ik.hpp"
+#include "workspace/dh_chain.hpp"
+#include "workspace/lattice.hpp"
+#include "workspace/marching_cubes.hpp"
+#include "workspace/marker_publisher.hpp"
+#include "workspace/octree.hpp"
+#include "workspace/reachability_cache.hpp"
+#include "workspace/reachability_map.hpp"
+#include "workspace/scene_diff.hpp"
+#include "workspace/stats.hpp"
 
 namespace rvt = rviz_visual_tools;
 
 double roi_y_min = -5.0;
 double roi_y_max = 5.0;
 
+// Closed-form position-only IK, set up in main when the planning group has one
+workspace::AnalyticIK analytic_ik;
+bool use_analytic_ik = false;
+
+// Hot-path statistics, one recorder per thread, published on /diagnostics
+workspace::stats::Registry ik_stats;
+const int IK_CALLS = ik_stats.addCounter("ik_calls");
+const int IK_FAILURES = ik_stats.addCounter("ik_failures");
+const int CACHE_HITS = ik_stats.addCounter("cache_hits");
+const int SPLITS = ik_stats.addCounter("splits");
+const int LEAVES = ik_stats.addCounter("leaves");
+const int IK_TIME = ik_stats.addHistogram("ik_time");
+const int SPLIT_TIME = ik_stats.addHistogram("split_time");
+
 void debugPause()
 {
     // User input
@@ -40,15 +74,94 @@ void calcFK(
     pose = Eigen::toMsg(eef_transformation);
 }
 
-bool checkIK(
+// A group configuration without collisions in the scene (self collisions included)
+bool isCollisionFree(
+    const planning_scene::PlanningScene &scene,
+    robot_state::RobotState &state,
+    const robot_model::JointModelGroup *joint_model_group,
+    const double *joint_values)
+{
+    state.setJointGroupPositions(joint_model_group, joint_values);
+    state.update();
+    return !scene.isStateColliding(state, joint_model_group->getName());
+}
+
+// `scene` == nullptr: any IK solution, otherwise a collision-free one
+bool checkNumericalIK(
     const geometry_msgs::Pose &eef_pose,
     const robot_state::RobotStatePtr &kinematic_state,
-    const robot_model::JointModelGroup *joint_model_group)
+    const robot_model::JointModelGroup *joint_model_group,
+    const planning_scene::PlanningScene *scene)
 {
     const unsigned int attempts = 10;
     // 1 msec enough. ​Usually, 0.02~0.05 msec is required to solve IK.
     const double timeout = 0.001;
-    return kinematic_state->setFromIK(joint_model_group, eef_pose, attempts, timeout);
+    if (scene == nullptr)
+    {
+        return kinematic_state->setFromIK(joint_model_group, eef_pose, attempts, timeout);
+    }
+    // The solver keeps sampling until a solution passes the validity callback
+    return kinematic_state->setFromIK(joint_model_group, eef_pose, attempts, timeout,
+        [scene](robot_state::RobotState *state, const robot_model::JointModelGroup *group, const double *values)
+        {
+            return isCollisionFree(*scene, *state, group, values);
+        });
+}
+
+bool checkIK(
+    const geometry_msgs::Pose &eef_pose,
+    const robot_state::RobotStatePtr &kinematic_state,
+    const robot_model::JointModelGroup *joint_model_group,
+    const planning_scene::PlanningScene *scene,
+    workspace::stats::Recorder &recorder)
+{
+    recorder.count(IK_CALLS);
+    workspace::stats::ScopedTimer timer(recorder, IK_TIME);
+    const Eigen::Vector3d position(eef_pose.position.x, eef_pose.position.y, eef_pose.position.z);
+    bool reachable;
+    if (!use_analytic_ik)
+    {
+        reachable = checkNumericalIK(eef_pose, kinematic_state, joint_model_group, scene);
+    }
+    else if (scene == nullptr)
+    {
+        reachable = analytic_ik.reachable(position);
+    }
+    else
+    {
+        reachable = analytic_ik.reachable(position, [&](const workspace::AnalyticIK::Solution &q)
+        {
+            return isCollisionFree(*scene, *kinematic_state, joint_model_group, q.data());
+        });
+        // PUMA only checks zero wrists, search the other wrist poses if the wrist center is reachable
+        if (!reachable && analytic_ik.getKind() == workspace::AnalyticIK::PUMA && analytic_ik.reachable(position))
+        {
+            reachable = checkNumericalIK(eef_pose, kinematic_state, joint_model_group, scene);
+        }
+    }
+    if (!reachable) { recorder.count(IK_FAILURES); }
+    return reachable;
+}
+
+// Memoized checkIK of a probe given by its index on the lattice of the cache
+bool checkIK(
+    const workspace::Lattice::Index &probe,
+    const robot_state::RobotStatePtr &kinematic_state,
+    const robot_model::JointModelGroup *joint_model_group,
+    const planning_scene::PlanningScene *scene,
+    workspace::ReachabilityCache &cache,
+    workspace::stats::Recorder &recorder)
+{
+    bool solved = false;
+    const bool reachable = cache.check(probe, [&]()
+    {
+        solved = true;
+        geometry_msgs::Pose eef_pose;
+        eef_pose.position = cache.getLattice().point(probe);
+        return checkIK(eef_pose, kinematic_state, joint_model_group, scene, recorder);
+    });
+    if (!solved) { recorder.count(CACHE_HITS); }
+    return reachable;
 }
 
 bool calcIK(
@@ -57,7 +170,7 @@ bool calcIK(
     const robot_model::JointModelGroup *joint_model_group,
     std::vector<double> &joint_values)
 {
-    bool found_ik = checkIK(eef_pose, kinematic_state, joint_model_group);
+    bool found_ik = checkNumericalIK(eef_pose, kinematic_state, joint_model_group, nullptr);
     if (found_ik)
         kinematic_state->copyJointGroupPositions(joint_model_group, joint_values);
     return found_ik;
@@ -66,298 +179,153 @@ bool calcIK(
 void drawCuboidFromAnchor(
     const geometry_msgs::Point &anchor,
     const double width,
-    moveit_visual_tools::MoveItVisualTools &visual_tools,
-    const rvt::colors color)
+    const std::string &frame_id,
+    const std_msgs::ColorRGBA &color,
+    workspace::MarkerPublisher &markers)
 {
-    geometry_msgs::Pose p;
-    p.position = anchor;
-    p.orientation.w = 1.0;
-    visual_tools.publishCuboid(p, width, width, width, color);
+    static int id = 0;
+    visualization_msgs::Marker marker;
+    marker.header.frame_id = frame_id;
+    marker.header.stamp = ros::Time::now();
+    marker.ns = "Cuboid";
+    marker.id = id++;
+    marker.type = visualization_msgs::Marker::CUBE;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.pose.position = anchor;
+    marker.pose.orientation.w = 1.0;
+    marker.scale.x = marker.scale.y = marker.scale.z = width;
+    marker.color = color;
+    markers.publish(std::move(marker));
 }
 
-namespace Octree
+// Box around every collision object of `world`, and a hash of its shapes and poses
+void getSceneObjects(const collision_detection::World &world, std::vector<workspace::MapObject> &objects)
 {
-    inline unsigned char makeEightIKs(
-        const std::bitset<27> &checkpoints,
-        const std::size_t ba_index,
-        const std::size_t bb_index,
-        const std::size_t bc_index,
-        const std::size_t bd_index,
-        const std::size_t ta_index,
-        const std::size_t tb_index,
-        const std::size_t tc_index,
-        const std::size_t td_index)
+    objects.clear();
+    for (const std::string &id : world.getObjectIds())
     {
-        /**
-         * { ba, bb, bc, bd, ta, tb, tc, td } eight_iks
-         *    7,  6,  5,  4,  3,  2,  1,  0   => Required shift
-         */
-        return (checkpoints[ba_index] << 7) |
-               (checkpoints[bb_index] << 6) |
-               (checkpoints[bc_index] << 5) |
-               (checkpoints[bd_index] << 4) |
-               (checkpoints[ta_index] << 3) |
-               (checkpoints[tb_index] << 2) |
-               (checkpoints[tc_index] << 1) |
-               checkpoints[td_index];
+        const collision_detection::World::ObjectConstPtr object = world.getObject(id);
+        const double inf = std::numeric_limits<double>::infinity();
+        double min[3] = {inf, inf, inf};
+        double max[3] = {-inf, -inf, -inf};
+        uint64_t hash = workspace::hashString(id);
+        for (std::size_t s = 0; s < object->shapes_.size(); s++)
+        {
+            // Bounding sphere: cheap, and the same for every shape type
+            std::unique_ptr<bodies::Body> body(bodies::createBodyFromShape(object->shapes_[s].get()));
+            if (!body) { continue; }
+            const Eigen::Isometry3d &pose = object->shape_poses_[s];
+            body->setPose(pose);
+            bodies::BoundingSphere sphere;
+            body->computeBoundingSphere(sphere);
+            for (int a = 0; a < 3; a++)
+            {
+                min[a] = std::min(min[a], sphere.center[a] - sphere.radius);
+                max[a] = std::max(max[a], sphere.center[a] + sphere.radius);
+            }
+            const int type = object->shapes_[s]->type;
+            hash = workspace::hashString(std::string(reinterpret_cast<const char *>(&type), sizeof(type)), hash);
+            hash = workspace::hashString(std::string(reinterpret_cast<const char *>(&sphere.radius), sizeof(double)), hash);
+            hash = workspace::hashString(std::string(reinterpret_cast<const char *>(pose.matrix().data()), 16 * sizeof(double)), hash);
+        }
+        if (min[0] > max[0]) { continue; }  // No shape
+        objects.push_back(workspace::makeMapObject(id, min, max, hash));
     }
+}
 
-    inline unsigned char makeEightIKs(
-        const bool ba, const bool bb, const bool bc, const bool bd,
-        const bool ta, const bool tb, const bool tc, const bool td)
+// Planning scene on `model` with the world and allowed collisions of `scene_msg`
+planning_scene::PlanningScenePtr makeScene(
+    const robot_model::RobotModelConstPtr &model,
+    const moveit_msgs::PlanningScene &scene_msg)
+{
+    planning_scene::PlanningScenePtr scene(new planning_scene::PlanningScene(model));
+    scene->setPlanningSceneMsg(scene_msg);
+    return scene;
+}
+
+namespace Octree
+{
+    void printDebugInfo(const Cube* c, const int depth)
     {
-        return (ba << 7) | (bb << 6) | (bc << 5) | (bd << 4) | (ta << 3) | (tb << 2) | (tc << 1) | td;
+        const Index anchor = c->getAnchor();
+        ROS_INFO_STREAM("Anchor: (" << anchor.i << ", " << anchor.j << ", " << anchor.k << ")"
+                        << "\nLevel: " << (int)c->getLevel() << ", width: " << c->getWidth(depth)
+                        << "\nEight IKs: " << std::bitset<8>(c->getEightIks())
+                        << "\nIs useful: " << (c->isUseful() ? "true" : "false"));
     }
 
-    class Cube
+    /**
+     * Refine the octree grown from a single ROI seed cube (a DFS lattice index).
+     * Every boundary leaf cube (level == depth) is handed to `on_leaf`.
+     * `openlist` is a caller-owned LIFO stack of openlistSize(depth) cubes, so each thread can keep its own.
+     */
+    template <typename LeafCallback>
+    void refine(
+        const Index &seed,
+        const int depth,
+        std::vector<Cube> &openlist,
+        const robot_state::RobotStatePtr &kinematic_state,
+        const robot_model::JointModelGroup *joint_model_group,
+        const planning_scene::PlanningScene *scene,
+        workspace::ReachabilityCache &cache,
+        workspace::stats::Recorder &recorder,
+        LeafCallback on_leaf)
     {
-    public:
-        Cube() {}
-        ~Cube() {}
-
-        void init(
-            const geometry_msgs::Point &anchor,
-            const double &width,
-            const unsigned char &eight_iks)
-        {
-            anchor_ = anchor;
-            width_ = width;
-            eight_iks_ = eight_iks;
-        }
-
-        void init(
-            const geometry_msgs::Point &anchor,
-            const double &width,
-            const robot_state::RobotStatePtr &kinematic_state,
-            const robot_model::JointModelGroup *joint_model_group)
-        {
-            anchor_ = anchor;
-            width_ = width;
-            // eight_iks_
-            geometry_msgs::Pose eef;
-            eef.position = anchor_;
-            const bool ba = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += width_;
-            const bool bb = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += width_;
-            const bool bc = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x -= width_;
-            const bool bd = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.z += width_;
-            const bool td = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += width_;
-            const bool tc = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y -= width_;
-            const bool tb = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x -= width_;
-            const bool ta = checkIK(eef, kinematic_state, joint_model_group);
-            eight_iks_ = makeEightIKs(ba, bb, bc, bd, ta, tb, tc, td);
-        }
-
-        geometry_msgs::Point getAnchor() const { return anchor_; }
-        double getWidth() const { return width_; }
-        unsigned char getEightIks() const { return eight_iks_; }
-
-        bool operator<(const Cube &other) const
+        const workspace::Lattice &probes = cache.getLattice();
+        const int scale = 1 << depth;
+        int top = 0;  // Last-in first-out (top can be negative)
+        auto check = [&](const Index &probe)
         {
-            return (width_ < other.getWidth()) &
-                   (anchor_.x < other.getAnchor().x) &
-                   (anchor_.y < other.getAnchor().y) &
-                   (anchor_.z < other.getAnchor().z);
-        }
-
-        bool isUseful() const
+            return checkIK(probe, kinematic_state, joint_model_group, scene, cache, recorder);
+        };
+        openlist[top].init(Index{seed.i * scale, seed.j * scale, seed.k * scale}, 0, depth, check);
+        while (top >= 0)
         {
-            // 0xFF: Every corner has a solution.
-            // 0x00: Every corner has no solution.
-            return (eight_iks_) && (eight_iks_ != 0xFF);
-        }
+            // Pop the last cube
+            Cube *cube = &openlist[top];
+            top--;
 
-        // Split without if statements (for optimization)
-        void split(
-            std::vector<Cube> &openlist,
-            int &top,
-            const robot_state::RobotStatePtr &kinematic_state,
-            const robot_model::JointModelGroup *joint_model_group)
-        {
-            // Backup this cube to prevent data conflict.
-            geometry_msgs::Point this_anchor(anchor_);
-            double this_width(width_);
-            unsigned char this_eight_iks(eight_iks_);
-
-            /**
-             * 27 IK checkpoints (0: middle point)
-             * { ba(---), (0--), bb(+--),  (-0-), (00-), (+0-),  bd(-+-), (0+-), bc(++-),  // 012 345 678
-             *     (--0), (0-0),   (+-0),  (-00), (000), (+00),    (-+0), (0+0),   (++0),  // 9*1 234 567
-             *   ta(--+), (0-+), tb(+-+),  (-0+), (00+), (+0+),  td(-++), (0++), tc(+++) } // 89* 123 456
-             * ___________________________________________________
-             * { ba, bb, bc, bd, ta, tb, tc, td } => Already known
-             */
-            std::bitset<27> checkpoints(0);
-            // 8 Knowns
-            checkpoints[0] = this_eight_iks & 0x80;  // ba, 0x80, BOTTOM_RIGHT_BACK
-            checkpoints[2] = this_eight_iks & 0x40;  // bb, 0x40, BOTTOM_RIGHT_FRONT
-            checkpoints[6] = this_eight_iks & 0x20;  // bc, 0x20, BOTTOM_LEFT_FRONT
-            checkpoints[8] = this_eight_iks & 0x10;  // bd, 0x10, BOTTOM_LEFT_BACK
-            checkpoints[18] = this_eight_iks & 0x08; // ta, 0x08, TOP_RIGHT_BACK
-            checkpoints[20] = this_eight_iks & 0x04; // tb, 0x04, TOP_RIGHT_FRONT
-            checkpoints[24] = this_eight_iks & 0x02; // tc, 0x02, TOP_LEFT_FRONT
-            checkpoints[26] = this_eight_iks & 0x01; // td, 0x01, TOP_LEFT_BACK
-            // 19 Unkowns
-            const double half_width = this_width / 2.0;
-            geometry_msgs::Pose eef;
-            eef.position.z = this_anchor.z; // bottom
-            eef.position.y = this_anchor.y;
-            eef.position.x = this_anchor.x + half_width;
-            checkpoints[1] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y = this_anchor.y + half_width;
-            eef.position.x = this_anchor.x;
-            checkpoints[3] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[4] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[5] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += half_width;
-            eef.position.x -= half_width;
-            checkpoints[7] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.z += half_width; // middle
-            eef.position.y = this_anchor.y;
-            eef.position.x = this_anchor.x;
-            checkpoints[9] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[10] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[11] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += half_width;
-            eef.position.x = this_anchor.x;
-            checkpoints[12] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[13] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[14] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += half_width;
-            eef.position.x = this_anchor.x;
-            checkpoints[15] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[16] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[17] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.z += half_width; // top
-            eef.position.y = this_anchor.y;
-            eef.position.x = this_anchor.x + half_width;
-            checkpoints[19] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += half_width;
-            eef.position.x = this_anchor.x;
-            checkpoints[21] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[22] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.x += half_width;
-            checkpoints[23] = checkIK(eef, kinematic_state, joint_model_group);
-            eef.position.y += half_width;
-            eef.position.x -= half_width;
-            checkpoints[25] = checkIK(eef, kinematic_state, joint_model_group);
-
-            // Push 8 cubes into the openlist
-            top++; // ba-side
-            geometry_msgs::Point new_anchor = this_anchor;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 0, 1, 4, 3, 9, 10, 13, 12));
-            top++; // bb-side
-            new_anchor.x += half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 1, 2, 5, 4, 10, 11, 14, 13));
-            top++; // bc-side
-            new_anchor.y += half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 4, 5, 8, 7, 13, 14, 17, 16));
-            top++; // bd-side
-            new_anchor.x -= half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 3, 4, 7, 6, 12, 13, 16, 15));
-            top++; // td-side
-            new_anchor.z += half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 12, 13, 16, 15, 21, 22, 25, 24));
-            top++; // tc-side
-            new_anchor.x += half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 13, 14, 17, 16, 22, 23, 26, 25));
-            top++; // tb-side
-            new_anchor.y -= half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 10, 11, 14, 13, 19, 20, 23, 22));
-            top++; // ta-side
-            new_anchor.x -= half_width;
-            openlist[top].init(new_anchor, half_width, makeEightIKs(checkpoints, 9, 10, 13, 12, 18, 19, 22, 21));
-        }
+            // Check y-axis roi
+            double cube_min_y = probes.getOrigin().y + cube->getAnchor().j * probes.getResolution();
+            double cube_max_y = cube_min_y + cube->getWidth(depth) * probes.getResolution();
+            bool cube_in_roi = !((cube_max_y < roi_y_min) || (cube_min_y > roi_y_max));
+            if (!cube_in_roi || !cube->isUseful()) { continue; }
 
-    private:
-        geometry_msgs::Point anchor_; // The position of ba corner
-        double width_;
-        /**
-         * IK results for each corner. true == solution found.
-         * Cube 8 division order:
-         *     [+x: foward, +y: left, +z: up] => (+++)
-         *     Bottom CCW : ba(---) -> bb(+--) -> bc(++-) -> bd(-+-)
-         *     Top CCW    : ta(--+) -> tb(+-+) -> tc(+++) -> td(-++)
-         * eight_iks_ == 0b {ba bb bc bd} {ta tb tc td}
-         */
-        unsigned char eight_iks_;
-    };
-
-    void printDebugInfo(const Cube* c)
-    {
-        ROS_INFO_STREAM("Anchor: \n"
-                        << c->getAnchor()
-                        << "\nWidth: " << c->getWidth()
-                        << "\nEight IKs: " << std::bitset<8>(c->getEightIks())
-                        << "\nIs useful: " << (c->isUseful() ? "true" : "false"));
+            if (cube->getLevel() < depth)
+            {
+                // Split cube into 8 cubes
+                recorder.count(SPLITS);
+                workspace::stats::ScopedTimer timer(recorder, SPLIT_TIME);
+                cube->split(openlist, top, depth, check);
+            }
+            else
+            {
+                recorder.count(LEAVES);
+                on_leaf(*cube);
+            }
+        }
     }
 }
 
 namespace DFS
 {
-    using AnchorPtr = std::shared_ptr<geometry_msgs::Point>;
-
-    struct AnchorPtrCompare
-    {
-        bool operator() (const AnchorPtr& lhs, const AnchorPtr& rhs) const
-        {
-            int lx = int(lhs->x * 1000);
-            int ly = int(lhs->y * 1000);
-            int lz = int(lhs->z * 1000);
-            int rx = int(rhs->x * 1000);
-            int ry = int(rhs->y * 1000);
-            int rz = int(rhs->z * 1000);
-            return (lx < rx) ||
-                   (lx == rx && ly < ry) ||
-                   (lx == rx && ly == ry && lz < rz);
-        }
-    };
+    using Index = workspace::Lattice::Index;
 
-    std::array<AnchorPtr, 26> expand(const AnchorPtr& center, const double width)
+    // Visit the 26 neighbours of `center` in place (no allocation)
+    template <typename Visitor>
+    inline void expand(const Index &center, Visitor visit)
     {
-        std::array<AnchorPtr, 26> outer;
-        for (auto& p : outer) { p = AnchorPtr(new geometry_msgs::Point(*center)); }
-        for (int i = 0; i < 9; i++)
+        for (int dk = -1; dk <= 1; dk++)
         {
-            outer[i]->z -= width;       // Bottom
-            outer[17 + i]->z += width;  // Top
-        }
-        for (int i = 0; i < 3; i++)
-        {
-            // Front (ba-bb-tb-ta)
-            outer[i]->y -= width;
-            outer[9 + i]->y -= width;
-            outer[17 + i]->y -= width;  // indexing w/o center{
-            // Back (bc-bd-td-tc)
-            outer[6 + i]->y += width;
-            outer[14 + i]->y += width;
-            outer[23 + i]->y += width;  // indexing w/o center
-        }
-        for (int i = 0; i < 10; i += 3) // 0, 3, 6, 9
-        {
-            outer[i]->x -= width;
-            outer[2 + i]->x += width;
-            outer[14 + i]->x -= width;
-            outer[16 + i]->x += width;
+            for (int dj = -1; dj <= 1; dj++)
+            {
+                for (int di = -1; di <= 1; di++)
+                {
+                    if (di == 0 && dj == 0 && dk == 0) { continue; }
+                    visit(Index{center.i + di, center.j + dj, center.k + dk});
+                }
+            }
         }
-        outer[12]->x -= width;
-        outer[13]->x += width;
-        return outer;
     }
 }
 
@@ -379,6 +347,41 @@ int main(int argc, char **argv)
     nh.param<std::string>("planning_group", planning_group, "scara");
     nh.param<double>("roi_y_min", roi_y_min, -2.0);
     nh.param<double>("roi_y_max", roi_y_max, 2.0);
+    // Number of octree refinement threads (1: serial with live drawing)
+    int num_threads;
+    nh.param<int>("num_threads", num_threads, 1);
+    // Persistent reachability map (empty: always recompute, never save)
+    std::string map_file;
+    nh.param<std::string>("map_file", map_file, "");
+    // Binary STL of the boundary mesh (empty: do not save)
+    std::string mesh_file;
+    nh.param<std::string>("mesh_file", mesh_file, "");
+    // IK backend: "kdl" or "analytic"
+    std::string ik_backend;
+    nh.param<std::string>("ik_backend", ik_backend, "analytic");
+    // [sec] between two /diagnostics messages of the IK statistics
+    double stats_period;
+    nh.param<double>("stats_period", stats_period, 1.0);
+    // Markers per MarkerArray, MarkerArrays per second, and queued markers before decimating
+    int marker_batch_size, marker_queue_size;
+    workspace::MarkerPublisher::Options marker_options;
+    nh.param<int>("marker_batch_size", marker_batch_size, 512);
+    nh.param<double>("marker_rate", marker_options.rate, 20.0);
+    nh.param<int>("marker_queue_size", marker_queue_size, 16384);
+    marker_options.batch_size = std::max(marker_batch_size, 1);
+    marker_options.capacity = std::max(marker_queue_size, 2);
+    // Only collision-free IK solutions count (move_group's planning scene), and the map follows
+    // the collision objects: after a change, only the DFS cells around it are re-refined
+    bool collision_aware;
+    nh.param<bool>("collision_aware", collision_aware, false);
+    // [m] around a changed collision object (its box) that is re-refined
+    double update_margin;
+    nh.param<double>("update_margin", update_margin, 0.1);
+    // [sec] without scene changes before an update, so moving a fixture costs one update
+    double update_delay;
+    nh.param<double>("update_delay", update_delay, 0.5);
+    workspace::stats::DiagnosticsPublisher diagnostics(nh, ik_stats, "reachable_ws_ik", stats_period);
+    workspace::stats::Recorder &main_recorder = ik_stats.makeRecorder();
 
     // Set a rosParam for the KDL Kinematics Plugin
     const std::string position_only_ik_param_name =
@@ -395,10 +398,11 @@ int main(int argc, char **argv)
 
     // Moveit setup
     moveit::planning_interface::MoveGroupInterface move_group(planning_group);
-    moveit::planning_interface::PlanningSceneInterface planning_scene_interface;
     robot_state::RobotStatePtr kinematic_state(move_group.getCurrentState());
     const robot_state::JointModelGroup *joint_model_group = kinematic_state->getJointModelGroup(planning_group);
-    move_group.setWorkspace(-2.0, -2.0, -2.0, 2.0, 2.0, 2.0); // Search space
+    const double ws_min[3] = {-2.0, -2.0, -2.0}; // Search space
+    const double ws_max[3] = {2.0, 2.0, 2.0};
+    move_group.setWorkspace(ws_min[0], ws_min[1], ws_min[2], ws_max[0], ws_max[1], ws_max[2]);
 
 
     // Print some info
@@ -416,16 +420,81 @@ int main(int argc, char **argv)
     ROS_INFO_STREAM("Initial eef pose (zero_pose):\n"
                     << zero_pose);
 
+    // IK backend
+    // "kdl"     : the kinematics plugin of the group (position_only_ik), up to 10 attempts per probe
+    // "analytic": closed-form position-only IK on the DH chain of the group (workspace/analytic_ik.hpp),
+    //             "kdl" if the group has none
+    if (ik_backend == "analytic")
+    {
+        std::string error;
+        workspace::DHChain dh_chain;
+        std::vector<workspace::JointLimit> limits;
+        workspace::extractJointLimits(joint_model_group, limits);
+        if (!workspace::extractDHChain(*kinematic_state, joint_model_group, eef_link, dh_chain, error) ||
+            !analytic_ik.init(dh_chain, limits, error))
+        {
+            ROS_WARN_STREAM("No analytic IK for [ " << planning_group << " ]: " << error);
+        }
+        else if (!analytic_ik.supportsPositionOnly())
+        {
+            ROS_WARN_STREAM("Analytic IK of [ " << planning_group << " ] has no position-only mode (tool off the wrist center)");
+        }
+        else if (!(use_analytic_ik = workspace::verifyAnalyticIK(
+            analytic_ik, limits, *kinematic_state, joint_model_group, eef_link, error)))
+        {
+            ROS_WARN_STREAM("Analytic IK of [ " << planning_group << " ] rejected: " << error);
+        }
+        // calcFK above moved the state
+        calcFK(joint_values, kinematic_state, joint_model_group, eef_link, zero_pose);
+    }
+    ROS_WARN_STREAM("IK backend: " << (use_analytic_ik ? "analytic" : "kdl"));
+
     // Visualization
     const std::string base_frame = move_group.getPlanningFrame();
     ROS_INFO_STREAM("Base frame: " << base_frame);
     moveit_visual_tools::MoveItVisualTools visual_tools(base_frame);
-    visual_tools.deleteAllMarkers();
     visual_tools.loadRemoteControl();
     visual_tools.setAlpha(color_alpha); // 0 is invisible
-    visual_tools.enableBatchPublishing();
+    // Markers go out from a background thread (on the topic of the visual tools), so the
+    // search never waits for RViz
+    workspace::MarkerPublisher markers(nh, "/rviz_visual_tools", marker_options);
+    markers.deleteAll();
     std::size_t marker_count = 0;
 
+    /**
+     * Collision-aware mode
+     * The IK probes of a pass are checked against a snapshot of the monitored planning scene
+     * (scene_msg), every thread on its own PlanningScene. `scene` stays null otherwise.
+     */
+    planning_scene_monitor::PlanningSceneMonitorPtr scene_monitor;
+    std::atomic<bool> scene_changed(false);
+    moveit_msgs::PlanningScene scene_msg;
+    planning_scene::PlanningScenePtr scene;
+    std::vector<workspace::MapObject> map_objects;  // Collision objects of the current map
+    auto snapshotScene = [&](std::vector<workspace::MapObject> &objects)
+    {
+        planning_scene_monitor::LockedPlanningSceneRO locked(scene_monitor);
+        locked->getPlanningSceneMsg(scene_msg);
+        getSceneObjects(*locked->getWorld(), objects);
+        scene = makeScene(kinematic_state->getRobotModel(), scene_msg);
+    };
+    if (collision_aware)
+    {
+        scene_monitor.reset(new planning_scene_monitor::PlanningSceneMonitor("robot_description"));
+        scene_monitor->startSceneMonitor("/move_group/monitored_planning_scene");
+        if (!scene_monitor->requestPlanningSceneState("/get_planning_scene"))
+        {
+            ROS_WARN_STREAM("No planning scene from move_group, starting with an empty one");
+        }
+        scene_monitor->addUpdateCallback([&](planning_scene_monitor::PlanningSceneMonitor::SceneUpdateType type)
+        {
+            if (type & planning_scene_monitor::PlanningSceneMonitor::UPDATE_GEOMETRY) { scene_changed = true; }
+        });
+        snapshotScene(map_objects);
+        scene_changed = false;
+        ROS_WARN_STREAM("Collision-aware: " << map_objects.size() << " collision objects");
+    }
+
     /**********************************
      * MAIN ALGORITHM
      **********************************/
@@ -433,163 +502,574 @@ int main(int argc, char **argv)
     // const double dfs_resolution = 0.06;  // DFS
     // const double marching_resolution = 0.03;  // Octree
 
-    ros::Duration(1.0).sleep();
-    ros::Time step1_start_time = ros::Time::now();
+    // DFS lattice around the zero pose
+    workspace::Lattice dfs_lattice(zero_pose.position, dfs_resolution, ws_min, ws_max);
+    if (!dfs_lattice.contains(DFS::Index{0, 0, 0}))
+    {
+        ROS_ERROR_STREAM("Initial eef pose is outside of the search space");
+        return 1;
+    }
+    // Octree probes are dyadic subdivisions of dfs_resolution, so they all lie on the lattice
+    // with spacing dfs_resolution / 2^octree_depth.
+    int octree_depth = 0;
+    double probe_resolution = dfs_resolution;
+    while (probe_resolution > marching_resolution)
+    {
+        probe_resolution /= 2.0;
+        octree_depth++;
+    }
+    const int scale = 1 << octree_depth;
+
+    /**
+     * Boundary mesh
+     * The marching cubes triangles of every leaf stream into a TRIANGLE_LIST marker,
+     * which is republished every 512 leaves. A full marker is closed and the next id starts.
+     */
+    const std::size_t max_marker_triangles = 16384;
+    std::vector<geometry_msgs::Point> mesh_vertices;  // Whole mesh, 3 points per triangle
+    visualization_msgs::Marker mesh_marker;
+    mesh_marker.header.frame_id = base_frame;
+    mesh_marker.ns = "workspace_mesh";
+    mesh_marker.id = 0;
+    mesh_marker.type = visualization_msgs::Marker::TRIANGLE_LIST;
+    mesh_marker.action = visualization_msgs::Marker::ADD;
+    mesh_marker.pose.orientation.w = 1.0;
+    mesh_marker.scale.x = mesh_marker.scale.y = mesh_marker.scale.z = 1.0;
+    auto publishMesh = [&]()
+    {
+        if (mesh_marker.points.empty()) { return; }
+        mesh_marker.header.stamp = ros::Time::now();
+        markers.publish(mesh_marker);
+    };
 
-    // [ STEP 1 ] DFS
-    // ^^^^^^^^^^^^^^
-    std::vector<DFS::AnchorPtr> roi;
+    auto drawBoundaryCube = [&](const geometry_msgs::Point &anchor, const double width, const uint8_t eight_iks)
     {
-        std::vector<DFS::AnchorPtr> dfs_openlist;
-        std::set<DFS::AnchorPtr, DFS::AnchorPtrCompare> dfs_closedlist;
+        // Check close to y-roi boundary
+        double cube_min_y = anchor.y;
+        double cube_max_y = cube_min_y + width;
+        bool close_to_boundary = (cube_min_y < (roi_y_min + marching_resolution)) ||
+            (cube_max_y > roi_y_max - marching_resolution);
+        std_msgs::ColorRGBA color = visual_tools.getColor(close_to_boundary ? rvt::YELLOW : rvt::BLUE);
+        color.a = color_alpha;
+        workspace::marchCube(eight_iks, anchor, width, [&](
+            const geometry_msgs::Point &a, const geometry_msgs::Point &b, const geometry_msgs::Point &c)
+        {
+            for (const geometry_msgs::Point *p : {&a, &b, &c})
+            {
+                mesh_marker.points.push_back(*p);
+                mesh_marker.colors.push_back(color);
+                mesh_vertices.push_back(*p);
+            }
+        });
+        marker_count++;
+        if (mesh_marker.points.size() >= 3 * max_marker_triangles)
+        {
+            publishMesh();
+            mesh_marker.id++;
+            mesh_marker.points.clear();
+            mesh_marker.colors.clear();
+        }
+        else if (marker_count % 512 == 0) { publishMesh(); }
+    };
 
-        DFS::AnchorPtr root(new geometry_msgs::Point(zero_pose.position));
-        dfs_openlist.push_back(root);
-        dfs_closedlist.insert(root);
+    // Reuse a precomputed map of the same robot model, planning group and resolutions
+    std::string urdf, srdf;
+    nh.getParam("/robot_description", urdf);
+    nh.getParam("/robot_description_semantic", srdf);
+    const workspace::MapHeader map_key = workspace::makeMapHeader(
+        workspace::hashRobotModel(urdf, srdf), planning_group, dfs_resolution, marching_resolution,
+        roi_y_min, roi_y_max, dfs_lattice, octree_depth, collision_aware);
 
-        while (dfs_openlist.size())
+    // Closed set: one bit per lattice point inside the search space
+    std::vector<DFS::Index> roi;  // Closed list in insertion order
+    workspace::DenseBitset dfs_closedlist(dfs_lattice.size());
+    workspace::DenseBitset dfs_reachable(dfs_lattice.size());
+    std::vector<Octree::Cube> boundary_cubes;
+    bool loaded_map = false;
+    if (!map_file.empty())
+    {
+        workspace::ReachabilityMap map;
+        if (map.open(map_file) && workspace::sameMapKey(map.getHeader(), map_key))
         {
-            DFS::AnchorPtr current = dfs_openlist.back();
-            dfs_openlist.pop_back();
+            ROS_WARN_STREAM("Loaded reachability map " << map_file << " (" << map.getNumCubes() << " boundary cubes)");
+            if (!collision_aware)
+            {
+                for (std::size_t c = 0; c < map.getNumCubes(); c++)
+                {
+                    const workspace::MapCube &cube = map.getCubes()[c];
+                    drawBoundaryCube(map.getCubeAnchor(cube), map.getCubeWidth(cube), cube.eight_iks);
+                }
+                publishMesh();
+                ros::waitForShutdown();
+                return 0;
+            }
+            // Collision-aware: restore the DFS and the octree leaves, then update them to the current scene
+            for (std::size_t key = 0; key < dfs_lattice.size(); key++)
+            {
+                if (map.isGridPointReachable(dfs_lattice.index(key))) { dfs_reachable.set(key); }
+            }
+            // The closed list of the DFS was the root and the neighbours of every reachable point
+            const DFS::Index root{0, 0, 0};
+            dfs_reachable.set(dfs_lattice.key(root));
+            for (std::size_t key = 0; key < dfs_lattice.size(); key++)
+            {
+                if (!dfs_reachable.test(key)) { continue; }
+                const DFS::Index center = dfs_lattice.index(key);
+                dfs_closedlist.set(key);
+                DFS::expand(center, [&](const DFS::Index &child)
+                {
+                    if (dfs_lattice.contains(child)) { dfs_closedlist.set(dfs_lattice.key(child)); }
+                });
+            }
+            for (std::size_t key = 0; key < dfs_lattice.size(); key++)
+            {
+                if (dfs_closedlist.test(key)) { roi.push_back(dfs_lattice.index(key)); }
+            }
+            for (std::size_t c = 0; c < map.getNumCubes(); c++)
+            {
+                const workspace::MapCube &cube = map.getCubes()[c];
+                Octree::Cube leaf;
+                leaf.init(Octree::Index{cube.anchor[0], cube.anchor[1], cube.anchor[2]}, cube.level, cube.eight_iks);
+                boundary_cubes.push_back(leaf);
+            }
+            map_objects.assign(map.getObjects(), map.getObjects() + map.getNumObjects());
+            loaded_map = true;
+        }
+        else
+        {
+            ROS_INFO_STREAM("No matching reachability map in " << map_file << ", computing a new one");
+        }
+    }
 
-            drawCuboidFromAnchor(*current, dfs_resolution, visual_tools, rvt::RED);
-            visual_tools.trigger();
+    /**
+     * Depth-first flood from `openlist` over the reachable lattice points.
+     * Every newly closed point joins the ROI and is handed to `on_closed`.
+     */
+    auto floodDFS = [&](std::vector<DFS::Index> &openlist, const std::function<void(const DFS::Index &)> &on_closed)
+    {
+        while (openlist.size())
+        {
+            DFS::Index current = openlist.back();
+            openlist.pop_back();
+
+            drawCuboidFromAnchor(dfs_lattice.point(current), dfs_resolution, base_frame, visual_tools.getColor(rvt::RED), markers);
 
             // Expand the current node
-            for (const DFS::AnchorPtr& child : DFS::expand(current, dfs_resolution))
+            DFS::expand(current, [&](const DFS::Index &child)
             {
                 // If the child is NOT in the closed list
-                if (dfs_closedlist.find(child) == dfs_closedlist.end())
+                if (!dfs_lattice.contains(child) || dfs_closedlist.testAndSet(dfs_lattice.key(child)))
                 {
-                    dfs_closedlist.insert(child);
+                    return;
+                }
+                roi.push_back(child);
+                on_closed(child);
 
-                    // If IK has a solution
-                    geometry_msgs::Pose eef;
-                    eef.position = *child;
-                    if (checkIK(eef, kinematic_state, joint_model_group))
-                    {
-                        dfs_openlist.push_back(child);
-                    }
-                    ROS_INFO_STREAM("DFS closedlist.size: " << dfs_closedlist.size());
+                // If IK has a solution
+                geometry_msgs::Pose eef;
+                eef.position = dfs_lattice.point(child);
+                if (checkIK(eef, kinematic_state, joint_model_group, scene.get(), main_recorder))
+                {
+                    dfs_reachable.set(dfs_lattice.key(child));
+                    openlist.push_back(child);
                 }
-                // else
-                // {
-                //     ROS_WARN("The child is already in the closed list");
-                // }
-                // ROS_INFO_STREAM("DFS openlist.size: " << dfs_openlist.size() << " / closedlist.size: " << dfs_closedlist.size());
-            }
+                ROS_INFO_STREAM("DFS closedlist.size: " << roi.size());
+            });
         }
-        std::copy(dfs_closedlist.begin(), dfs_closedlist.end(), std::back_inserter(roi));
-    }
-    ROS_WARN_STREAM("Step 1 complete! Delete all markers");
-    // debugPause();
+    };
 
-    visual_tools.deleteAllMarkers();
-    visual_tools.trigger();
-    ros::Duration(0.5).sleep();
-    for (const auto& anchor : roi)
+    /**
+     * IK cache for STEP 2
+     * The cache covers the bounding box of the ROI cubes and is seeded with the DFS results,
+     * which are exactly the corners of the ROI cubes. A grown ROI gets a larger cache that keeps
+     * the known probes.
+     */
+    std::unique_ptr<workspace::ReachabilityCache> ik_cache;
+    auto fitCache = [&]()
     {
-        drawCuboidFromAnchor(*anchor, dfs_resolution, visual_tools, rvt::GREEN);
-    }
-    visual_tools.trigger();
-    ros::Duration(2.5).sleep();
-    // debugPause();
-
-    visual_tools.deleteAllMarkers();
-    visual_tools.trigger();
-    ros::Duration(0.5).sleep();
-
-    ros::Time step2_start_time = ros::Time::now();
-
-    // [ STEP 2 ] Octree
-    // ^^^^^^^^^^^^^^^^^
-    std::vector<Octree::Cube> octree_openlist(128, Octree::Cube());
-    int top = -1;  // Last-in first-out (top can be negative)
-    int max_top_record = -1;
-
-    /***************
-     * Pseudo Code
-     * ^^^^^^^^^^^
-     * openlist = { initial 8 cubes }  // Last-in first-out
-     * while (openlist is not empty)
-     * {
-     *     cube = openlist.pop_back()
-     *     if (all 8 cube.vertices have the same checkIK result)
-     *     {
-     *         Ignore it and continue
-     *     }
-     *     else if (cube.width > resolution)
-     *     {
-     *         Split cube into 8 cubes
-     *         openlist.push_back(8 cubes)
-     *     }
-     *     else
-     *     {
-     *         Marching cubes
-     *     }
-     * }
-     ***************/
-    int total_roi_size = roi.size();
-    int remain = total_roi_size;
-    while ((top >= 0) || (remain > 0))
+        DFS::Index roi_min = roi.front();
+        DFS::Index roi_max = roi.front();
+        for (const DFS::Index &anchor : roi)
+        {
+            roi_min = {std::min(roi_min.i, anchor.i), std::min(roi_min.j, anchor.j), std::min(roi_min.k, anchor.k)};
+            roi_max = {std::max(roi_max.i, anchor.i), std::max(roi_max.j, anchor.j), std::max(roi_max.k, anchor.k)};
+        }
+        const DFS::Index probe_min{roi_min.i * scale, roi_min.j * scale, roi_min.k * scale};
+        const DFS::Index probe_max{(roi_max.i + 1) * scale, (roi_max.j + 1) * scale, (roi_max.k + 1) * scale};
+        if (ik_cache && ik_cache->getLattice().contains(probe_min) && ik_cache->getLattice().contains(probe_max))
+        {
+            return;
+        }
+        std::unique_ptr<workspace::ReachabilityCache> cache(new workspace::ReachabilityCache(
+            workspace::Lattice(zero_pose.position, probe_resolution, probe_min, probe_max)));
+        if (ik_cache) { cache->copyFrom(*ik_cache); }
+        ik_cache = std::move(cache);
+        ROS_INFO_STREAM("IK cache: depth " << octree_depth << ", resolution " << probe_resolution
+                        << ", " << ik_cache->getMemoryBytes() / 1024 << " KiB");
+    };
+    auto seedCache = [&](const std::vector<DFS::Index> &points)
+    {
+        for (const DFS::Index &p : points)
+        {
+            if (!dfs_closedlist.test(dfs_lattice.key(p))) { continue; }
+            ik_cache->store(DFS::Index{p.i * scale, p.j * scale, p.k * scale}, dfs_reachable.test(dfs_lattice.key(p)));
+        }
+    };
+
+    /**
+     * Octree refinement of the ROI cubes `seeds`, every boundary leaf is handed to `on_leaf`
+     * (on this thread).
+     */
+    std::vector<robot_model_loader::RobotModelLoaderPtr> loaders;
+    auto refineSeeds = [&](const std::vector<DFS::Index> &seeds, const std::function<void(const Octree::Cube &)> &on_leaf)
     {
-        // max_top_record = (top > max_top_record) ? top : max_top_record;
-        // ROS_INFO_STREAM("Current top: " << top << " (maxTop: " << max_top_record << ") / roi.size: " << roi.size());
-        if (top < 0)
-        {
-            top++;
-            octree_openlist[top].init(*roi.back(), dfs_resolution, kinematic_state, joint_model_group);
-            roi.pop_back();
-            remain--;
-            if (remain % 128 == 0)
+        const int total_roi_size = seeds.size();
+        if (num_threads <= 1)
+        {
+            std::vector<Octree::Cube> octree_openlist(Octree::openlistSize(octree_depth));
+            for (int remain = total_roi_size - 1; remain >= 0; remain--)
             {
-                ROS_INFO_STREAM("Remaining roi size: " << remain << " / " << total_roi_size << " ...(( " << (float)(total_roi_size - remain) / total_roi_size * 100 << " % ))");
+                Octree::refine(seeds[remain], octree_depth,
+                    octree_openlist, kinematic_state, joint_model_group, scene.get(), *ik_cache, main_recorder, on_leaf);
+                if (remain % 128 == 0)
+                {
+                    ROS_INFO_STREAM("Remaining roi size: " << remain << " / " << total_roi_size << " ...(( " << (float)(total_roi_size - remain) / total_roi_size * 100 << " % ))");
+                }
             }
+            return;
         }
 
-        // Pop the last cube
-        Octree::Cube *cube = &octree_openlist[top];
-        top--;
+        /**
+         * Each worker owns a RobotModel (and thus its own IK solver instance), a RobotState,
+         * a PlanningScene in the collision-aware mode and an openlist. ROI seeds are claimed
+         * one by one from a shared cursor, so a thread that finishes its subtrees early simply
+         * picks up the next seed.
+         * Leaf cubes are collected per thread and handed over after all workers are joined.
+         */
+        ROS_INFO_STREAM("Octree refinement with " << num_threads << " threads");
+        for (int t = loaders.size(); t < num_threads; t++)
+        {
+            // Sequential on purpose: plugin loading is not thread-safe.
+            loaders.emplace_back(new robot_model_loader::RobotModelLoader("robot_description"));
+        }
+
+        std::atomic<std::size_t> next_seed(0);
+        // The last worker to finish a seed wakes the main thread up
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        std::size_t done_seeds = 0;
+        std::vector<std::vector<Octree::Cube>> leaves(num_threads);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < num_threads; t++)
+        {
+            workers.emplace_back([&, t]()
+            {
+                const robot_model::RobotModelPtr &model = loaders[t]->getModel();
+                robot_state::RobotStatePtr state(new robot_state::RobotState(model));
+                state->setToDefaultValues();
+                const robot_model::JointModelGroup *jmg = model->getJointModelGroup(planning_group);
+                const planning_scene::PlanningScenePtr worker_scene = collision_aware ?
+                    makeScene(model, scene_msg) : planning_scene::PlanningScenePtr();
+                std::vector<Octree::Cube> openlist(Octree::openlistSize(octree_depth));
+                auto collect = [&](const Octree::Cube &cube) { leaves[t].push_back(cube); };
+                workspace::stats::Recorder &recorder = ik_stats.makeRecorder();
+                for (std::size_t s = next_seed++; s < seeds.size(); s = next_seed++)
+                {
+                    Octree::refine(seeds[s], octree_depth, openlist, state, jmg, worker_scene.get(), *ik_cache, recorder, collect);
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    if (++done_seeds == seeds.size()) { done_cv.notify_one(); }
+                }
+            });
+        }
+        {
+            // Progress every second until the last seed is done
+            std::unique_lock<std::mutex> lock(done_mutex);
+            while (!done_cv.wait_for(lock, std::chrono::seconds(1), [&]() { return done_seeds == seeds.size(); }))
+            {
+                const std::size_t done = done_seeds;
+                ROS_INFO_STREAM("Remaining roi size: " << total_roi_size - done << " / " << total_roi_size << " ...(( " << (float)done / total_roi_size * 100 << " % ))");
+            }
+        }
+        for (std::thread &worker : workers) { worker.join(); }
 
-        // Octree::printDebugInfo(cube);
+        // Merge
+        for (const std::vector<Octree::Cube> &thread_leaves : leaves)
+        {
+            for (const Octree::Cube &cube : thread_leaves) { on_leaf(cube); }
+        }
+    };
 
-        // Check y-axis roi
-        double cube_min_y = cube->getAnchor().y;
-        double cube_width = cube->getWidth();
-        double cube_max_y = cube_min_y + cube_width;
-        bool cube_not_in_roi = (cube_max_y < roi_y_min) || (cube_min_y > roi_y_max);
-        bool cube_in_roi = !cube_not_in_roi;
+    // Marching cubes
+    auto drawLeaf = [&](const Octree::Cube &cube)
+    {
+        boundary_cubes.push_back(cube);
+        drawBoundaryCube(ik_cache->getLattice().point(cube.getAnchor()), cube.getWidth(octree_depth) * probe_resolution,
+            cube.getEightIks());
+    };
+    auto redrawMesh = [&]()
+    {
+        markers.deleteAll();
+        mesh_vertices.clear();
+        mesh_marker.id = 0;
+        mesh_marker.points.clear();
+        mesh_marker.colors.clear();
+        marker_count = 0;
+        for (const Octree::Cube &cube : boundary_cubes)
+        {
+            drawBoundaryCube(ik_cache->getLattice().point(cube.getAnchor()), cube.getWidth(octree_depth) * probe_resolution,
+                cube.getEightIks());
+        }
+        publishMesh();
+    };
 
-        if (cube_in_roi && cube->isUseful())
+    auto saveResults = [&]()
+    {
+        if (!mesh_file.empty())
         {
-            if (cube_width > marching_resolution)
+            if (workspace::saveMeshSTL(mesh_file, mesh_vertices))
             {
-                // Split cube into 8 cubes
-                // ROS_INFO_STREAM("Will_split Popped idx: " << top + 1 << ", Popped Cube width: " << cube->getWidth());
-                cube->split(octree_openlist, top, kinematic_state, joint_model_group);
-                // ROS_INFO_STREAM("After split top: " << top);
+                ROS_WARN_STREAM("Boundary mesh saved to " << mesh_file);
+            }
+            else
+            {
+                ROS_ERROR_STREAM("Failed to save the boundary mesh to " << mesh_file);
+            }
+        }
+
+        if (!map_file.empty())
+        {
+            std::vector<workspace::MapCube> map_cubes;
+            map_cubes.reserve(boundary_cubes.size());
+            for (const Octree::Cube &cube : boundary_cubes)
+            {
+                const DFS::Index anchor = cube.getAnchor();
+                workspace::MapCube c;
+                c.anchor[0] = anchor.i;
+                c.anchor[1] = anchor.j;
+                c.anchor[2] = anchor.k;
+                c.level = cube.getLevel();
+                c.eight_iks = cube.getEightIks();
+                c.reserved[0] = c.reserved[1] = 0;
+                map_cubes.push_back(c);
+            }
+            if (workspace::saveReachabilityMap(map_file, map_key, dfs_reachable, map_cubes, map_objects))
+            {
+                ROS_WARN_STREAM("Reachability map saved to " << map_file);
             }
             else
             {
-                // Pseudo marching cubes
-                // Check close to y-roi boundary
-                bool close_to_boundary = (cube_min_y < (roi_y_min + marching_resolution)) ||
-                    (cube_max_y > roi_y_max - marching_resolution);
-                rvt::colors color = close_to_boundary ? rvt::YELLOW : rvt::BLUE;
-                drawCuboidFromAnchor(cube->getAnchor(), cube->getWidth(), visual_tools, color);
-                marker_count++;
-                if (marker_count % 512 == 0) { visual_tools.trigger(); }
+                ROS_ERROR_STREAM("Failed to save the reachability map to " << map_file);
             }
         }
+    };
+
+    if (loaded_map)
+    {
+        fitCache();
+        seedCache(roi);
+        redrawMesh();
+    }
+    else
+    {
+        ros::Duration(1.0).sleep();
+        ros::Time step1_start_time = ros::Time::now();
+
+        // [ STEP 1 ] DFS
+        // ^^^^^^^^^^^^^^
+        {
+            std::vector<DFS::Index> dfs_openlist;
+
+            const DFS::Index root{0, 0, 0};  // zero_pose
+            dfs_openlist.push_back(root);
+            dfs_closedlist.set(dfs_lattice.key(root));
+            dfs_reachable.set(dfs_lattice.key(root));
+            roi.push_back(root);
+            floodDFS(dfs_openlist, [](const DFS::Index &) {});
+        }
+        ROS_WARN_STREAM("Step 1 complete! Delete all markers");
+        // debugPause();
+
+        markers.deleteAll();
+        ros::Duration(0.5).sleep();
+        for (const DFS::Index &anchor : roi)
+        {
+            drawCuboidFromAnchor(dfs_lattice.point(anchor), dfs_resolution, base_frame, visual_tools.getColor(rvt::GREEN), markers);
+        }
+        ros::Duration(2.5).sleep();
+        // debugPause();
+
+        markers.deleteAll();
+        ros::Duration(0.5).sleep();
+
+        ros::Time step2_start_time = ros::Time::now();
+        fitCache();
+        seedCache(roi);
+
+        // [ STEP 2 ] Octree
+        // ^^^^^^^^^^^^^^^^^
+
+        /***************
+         * Pseudo Code
+         * ^^^^^^^^^^^
+         * openlist = { initial 8 cubes }  // Last-in first-out
+         * while (openlist is not empty)
+         * {
+         *     cube = openlist.pop_back()
+         *     if (all 8 cube.vertices have the same checkIK result)
+         *     {
+         *         Ignore it and continue
+         *     }
+         *     else if (cube.width > resolution)
+         *     {
+         *         Split cube into 8 cubes
+         *         openlist.push_back(8 cubes)
+         *     }
+         *     else
+         *     {
+         *         Marching cubes
+         *     }
+         * }
+         ***************/
+        refineSeeds(roi, drawLeaf);
+        publishMesh();
+        ROS_INFO_STREAM("Boundary mesh: " << mesh_vertices.size() / 3 << " triangles");
+
+        ros::Time finish_time = ros::Time::now();
+        ROS_WARN_STREAM("========== DONE! ==========");
+        ROS_WARN_STREAM("Total execution time: " << (finish_time - step1_start_time).toSec() << " sec");
+        ROS_WARN_STREAM("    > Step1 : " << (step2_start_time - step1_start_time).toSec() << " sec");
+        ROS_WARN_STREAM("    > Step2 : " << (finish_time - step2_start_time).toSec() << " sec");
+
+        saveResults();
+    }
+
+    if (!collision_aware)
+    {
+        ros::waitForShutdown();
+        return 0;
     }
-    visual_tools.trigger();
 
-    ros::Time finish_time = ros::Time::now();
-    ROS_WARN_STREAM("========== DONE! ==========");
-    ROS_WARN_STREAM("Total execution time: " << (finish_time - step1_start_time).toSec() << " sec");
-    ROS_WARN_STREAM("    > Step1 : " << (step2_start_time - step1_start_time).toSec() << " sec");
-    ROS_WARN_STREAM("    > Step2 : " << (finish_time - step2_start_time).toSec() << " sec");
+    /**
+     * [ UPDATE ] Collision objects changed
+     * ^^^^^^^^^^
+     * 1. Recheck the closed DFS points around a changed object, and resume the DFS from the
+     *    points that became reachable (a removed object can open a new region).
+     * 2. Forget the cached IK probes around it and re-refine the DFS cells it touches (and the
+     *    new ROI cells). Every other leaf, and the persisted map outside of those cells, is kept.
+     * Points that became unreachable stay in the ROI, their cells just stop producing leaves.
+     */
+    auto updateRegions = [&](const std::vector<workspace::Region> &regions)
+    {
+        workspace::DenseBitset dirty(dfs_lattice.size());    // Cells to re-refine
+        workspace::DenseBitset checked(dfs_lattice.size());  // DFS points rechecked
+        std::vector<DFS::Index> dirty_cells;
+        std::vector<DFS::Index> seeded;  // DFS results to store in the cache
+        std::vector<DFS::Index> dfs_openlist;
+        const DFS::Index root{0, 0, 0};
+        for (const workspace::Region &region : regions)
+        {
+            DFS::Index lo, hi;
+            if (workspace::cellRange(dfs_lattice, region, lo, hi))
+            {
+                for (int k = lo.k; k <= hi.k; k++)
+                {
+                    for (int j = lo.j; j <= hi.j; j++)
+                    {
+                        for (int i = lo.i; i <= hi.i; i++)
+                        {
+                            const DFS::Index cell{i, j, k};
+                            const std::size_t key = dfs_lattice.key(cell);
+                            if (dfs_closedlist.test(key) && !dirty.testAndSet(key)) { dirty_cells.push_back(cell); }
+                        }
+                    }
+                }
+            }
+            if (!workspace::pointRange(dfs_lattice, region, lo, hi)) { continue; }
+            for (int k = lo.k; k <= hi.k; k++)
+            {
+                for (int j = lo.j; j <= hi.j; j++)
+                {
+                    for (int i = lo.i; i <= hi.i; i++)
+                    {
+                        const DFS::Index p{i, j, k};
+                        const std::size_t key = dfs_lattice.key(p);
+                        if (!dfs_closedlist.test(key) || checked.testAndSet(key)) { continue; }
+                        if (i == root.i && j == root.j && k == root.k) { continue; }
+
+                        geometry_msgs::Pose eef;
+                        eef.position = dfs_lattice.point(p);
+                        const bool was_reachable = dfs_reachable.test(key);
+                        const bool reachable = checkIK(eef, kinematic_state, joint_model_group, scene.get(), main_recorder);
+                        if (reachable) { dfs_reachable.set(key); } else { dfs_reachable.reset(key); }
+                        if (reachable && !was_reachable) { dfs_openlist.push_back(p); }
+                        seeded.push_back(p);
+                    }
+                }
+            }
+        }
+        const std::size_t old_roi_size = roi.size();
+        floodDFS(dfs_openlist, [&](const DFS::Index &cell)
+        {
+            dirty.set(dfs_lattice.key(cell));
+            dirty_cells.push_back(cell);
+            seeded.push_back(cell);
+        });
+        ROS_INFO_STREAM("Update: " << dirty_cells.size() << " dirty cells, " << roi.size() - old_roi_size << " new ROI cells");
+
+        // Probes outside of the regions keep their result, so the faces shared with clean cells match
+        fitCache();
+        for (const workspace::Region &region : regions)
+        {
+            DFS::Index lo, hi;
+            if (workspace::pointRange(ik_cache->getLattice(), region, lo, hi)) { ik_cache->invalidate(lo, hi); }
+        }
+        seedCache(seeded);
+
+        const std::size_t old_leaves = boundary_cubes.size();
+        boundary_cubes.erase(std::remove_if(boundary_cubes.begin(), boundary_cubes.end(), [&](const Octree::Cube &cube)
+        {
+            const DFS::Index anchor = cube.getAnchor();
+            const DFS::Index cell{
+                workspace::coarsen(anchor.i, octree_depth),
+                workspace::coarsen(anchor.j, octree_depth),
+                workspace::coarsen(anchor.k, octree_depth)};
+            return dfs_lattice.contains(cell) && dirty.test(dfs_lattice.key(cell));
+        }), boundary_cubes.end());
+        const std::size_t kept_leaves = boundary_cubes.size();
+        refineSeeds(dirty_cells, [&](const Octree::Cube &cube) { boundary_cubes.push_back(cube); });
+        ROS_INFO_STREAM("Update: " << old_leaves - kept_leaves << " leaves removed, "
+                        << boundary_cubes.size() - kept_leaves << " leaves refined");
+        redrawMesh();
+    };
 
-    ros::waitForShutdown();
+    // A persisted map may predate the current scene
+    bool pending = loaded_map;
+    ros::WallTime last_change = ros::WallTime::now();
+    ROS_WARN_STREAM("Watching the planning scene for collision object changes");
+    while (ros::ok())
+    {
+        if (scene_changed.exchange(false))
+        {
+            pending = true;
+            last_change = ros::WallTime::now();
+        }
+        if (!pending || (ros::WallTime::now() - last_change).toSec() < update_delay)
+        {
+            ros::WallDuration(0.05).sleep();
+            continue;
+        }
+        pending = false;
+
+        std::vector<workspace::MapObject> objects;
+        snapshotScene(objects);
+        const std::vector<workspace::Region> regions = workspace::diffObjects(map_objects, objects, update_margin);
+        if (regions.empty()) { continue; }
+        ROS_WARN_STREAM("Scene changed: " << regions.size() << " regions to update");
+        const ros::WallTime update_start = ros::WallTime::now();
+        updateRegions(regions);
+        map_objects = objects;
+        ROS_WARN_STREAM("Update done in " << (ros::WallTime::now() - update_start).toSec() << " sec");
+        saveResults();
+    }
     return 0;
 }
@@ -2,6 +2,8 @@
 #include <ros/ros.h>
 #include <rviz_visual_tools/rviz_visual_tools.h>
 #include <geometry_msgs/Pose.h>
+#include <visualization_msgs/Marker.h>
+#include "workspace/marker_publisher.hpp"
 
 int main(int argc, char **argv)
 {
@@ -38,6 +40,23 @@ int main(int argc, char **argv)
     double width = 0.5;
     double height = 0.1;
 
+    // The cuboid could also be drawn with visual_tools->publishCuboid() and trigger(), which
+    // publishes on this thread. A MarkerPublisher publishes from its own thread instead, and a
+    // cuboid still queued with the same (ns, id) is replaced by the newer one.
+    workspace::MarkerPublisher markers(nh, "/rviz_visual_markers");
+    visualization_msgs::Marker cuboid;
+    cuboid.header.frame_id = "map";
+    cuboid.ns = "Cuboid";
+    cuboid.id = 0;
+    cuboid.type = visualization_msgs::Marker::CUBE;
+    cuboid.action = visualization_msgs::Marker::ADD;
+    cuboid.scale.x = depth;
+    cuboid.scale.y = width;
+    cuboid.scale.z = height;
+    cuboid.color = visual_tools->getColor(rvt::BLUE);
+    cuboid.color.a = 0.5;
+    cuboid.lifetime = ros::Duration(1.0);
+
     ros::Time start_time = ros::Time::now();
     double radius = 2.0;
 
@@ -51,8 +70,9 @@ int main(int argc, char **argv)
         center.position.x = radius * cos(t);
         center.position.y = radius * sin(t);
         center.orientation.w = 1.0;
-        visual_tools->publishCuboid(center, depth, width, height, rvt::BLUE);
-        visual_tools->trigger();  // Publish/update RViz.
+        cuboid.header.stamp = ros::Time::now();
+        cuboid.pose = center;
+        markers.publish(cuboid);  // Publish/update RViz.
 
         ROS_INFO_STREAM("Published cuboid at (" << center.position.x << ", " << center.position.y << ")");
 